@@ -0,0 +1,110 @@
+//
+//  bench_algorithm.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+// Scaling of the parallel algorithms from 1 to N worker threads, against
+// the sequential standard algorithms
+//
+// Usage: bench_algorithm [max workers] [elements]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/algorithm.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    double heavy(double x) {
+        return std::sqrt(std::sin(x)*std::sin(x)+std::cos(x)*std::cos(x)+x);
+    }
+
+    template<typename Fn>
+    double time_ms(Fn fn) {
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        fn();
+        boost::chrono::duration<double, boost::milli> elapsed=boost::chrono::steady_clock::now()-start;
+        return elapsed.count();
+    }
+
+    void run(size_t workers, const std::vector<double> &input) {
+        std::vector<double> v(input);
+        std::vector<double> out(v.size());
+        double sink=0;
+        double t_for=time_ms([&](){
+            parallel_for(v.begin(), v.end(), [](double &x){ x=heavy(x); });
+        });
+        double t_transform=time_ms([&](){
+            parallel_transform(v.begin(), v.end(), out.begin(), heavy);
+        });
+        double t_reduce=time_ms([&](){
+            sink+=parallel_transform_reduce(v.begin(), v.end(), 0.0, std::plus<double>(), heavy);
+        });
+        double t_scan=time_ms([&](){
+            parallel_scan(out.begin(), out.end(), out.begin());
+        });
+        v=input;
+        double t_sort=time_ms([&](){
+            parallel_sort(v.begin(), v.end());
+        });
+        std::printf("workers=%-3zu for %8.1fms  transform %8.1fms  transform_reduce %8.1fms  scan %8.1fms  sort %8.1fms  (%g)\n",
+                    workers, t_for, t_transform, t_reduce, t_scan, t_sort, sink);
+    }
+
+    void run_sequential(const std::vector<double> &input) {
+        std::vector<double> v(input);
+        std::vector<double> out(v.size());
+        double sink=0;
+        double t_for=time_ms([&](){
+            for (double &x : v) x=heavy(x);
+        });
+        double t_transform=time_ms([&](){
+            std::transform(v.begin(), v.end(), out.begin(), heavy);
+        });
+        double t_reduce=time_ms([&](){
+            for (double x : v) sink+=heavy(x);
+        });
+        double t_scan=time_ms([&](){
+            std::partial_sum(out.begin(), out.end(), out.begin());
+        });
+        v=input;
+        double t_sort=time_ms([&](){
+            std::sort(v.begin(), v.end());
+        });
+        std::printf("sequential  for %8.1fms  transform %8.1fms  transform_reduce %8.1fms  scan %8.1fms  sort %8.1fms  (%g)\n",
+                    t_for, t_transform, t_reduce, t_scan, t_sort, sink);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_workers=argc>1 ? std::atoi(argv[1]) : 8;
+    size_t n=argc>2 ? std::atoi(argv[2]) : 4000000;
+    std::vector<double> input(n);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(0, 1000);
+    for (double &x : input) x=dist(rng);
+
+    greenify_with_sched(scheduler(), [&](){
+        run_sequential(input);
+        for (size_t workers=1; workers<=max_workers; workers*=2) {
+            if (workers>1) get_scheduler().add_worker_thread(workers/2);
+            run(workers, input);
+        }
+    });
+    return 0;
+}
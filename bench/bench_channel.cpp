@@ -0,0 +1,100 @@
+//
+//  bench_channel.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+// Compares spsc_channel with concurrent_queue on one producer and one consumer
+//
+// Usage: bench_channel [workers] [messages]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/concurrent_queue.hpp>
+#include <boost/green_thread/spsc_channel.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    typedef concurrent_queue<size_t> locked_queue;
+    typedef concurrent_queue<size_t, mpmc_ring<size_t>> ring_queue;
+    typedef spsc_channel<size_t> channel;
+    
+    void report(const char *name, const char *mode, size_t messages, boost::chrono::steady_clock::time_point start) {
+        boost::chrono::duration<double> elapsed=boost::chrono::steady_clock::now()-start;
+        std::printf("%-18s %-10s %12.0f msgs/s\n", name, mode, double(messages)/elapsed.count());
+    }
+    
+    void check(size_t sum, size_t messages) {
+        if (sum!=messages*(messages-1)/2) {
+            std::fprintf(stderr, "sum mismatch: %zu\n", sum);
+            std::exit(1);
+        }
+    }
+    
+    // One producer pushes all messages, one consumer pops them
+    template<typename Queue>
+    void streaming(const char *name, size_t messages) {
+        Queue q(1024);
+        size_t sum=0;
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        thread producer([&](){
+            for (size_t i=0; i<messages; i++) {
+                q.push(i);
+            }
+            q.close();
+        });
+        size_t v;
+        while (q.pop(v)) sum+=v;
+        producer.join();
+        check(sum, messages);
+        report(name, "streaming", messages, start);
+    }
+    
+    // Each message makes a round trip, so every pop waits for the other side
+    template<typename Queue>
+    void ping_pong(const char *name, size_t messages) {
+        Queue ping(1024);
+        Queue pong(1024);
+        size_t sum=0;
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        thread echo([&](){
+            size_t v;
+            while (ping.pop(v)) pong.push(v);
+            pong.close();
+        });
+        for (size_t i=0; i<messages; i++) {
+            size_t v;
+            ping.push(i);
+            pong.pop(v);
+            sum+=v;
+        }
+        ping.close();
+        echo.join();
+        check(sum, messages);
+        report(name, "ping-pong", messages, start);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t workers=argc>1 ? std::atoi(argv[1]) : 2;
+    size_t messages=argc>2 ? std::atoi(argv[2]) : 1000000;
+    greenify_with_sched(scheduler(), [&](){
+        if (workers>1) get_scheduler().add_worker_thread(workers-1);
+        streaming<locked_queue>("concurrent_queue", messages);
+        streaming<ring_queue>("mpmc_ring", messages);
+        streaming<channel>("spsc_channel", messages);
+        ping_pong<locked_queue>("concurrent_queue", messages/10);
+        ping_pong<ring_queue>("mpmc_ring", messages/10);
+        ping_pong<channel>("spsc_channel", messages/10);
+    });
+    return 0;
+}
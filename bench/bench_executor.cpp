@@ -0,0 +1,115 @@
+//
+//  bench_executor.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+// Task throughput of async_executor, sharing one queue, against
+// work_stealing_executor, with tasks submitted from outside and from tasks
+//
+// Usage: bench_executor [workers] [tasks]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/future.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    int work(int x) {
+        // A few hundred nanoseconds of arithmetic
+        for (int i=0; i<100; i++) x=x*31+i;
+        return x;
+    }
+
+    void report(const char *name, const char *mode, size_t nthreads, size_t tasks,
+                boost::chrono::steady_clock::time_point start)
+    {
+        boost::chrono::duration<double> elapsed=boost::chrono::steady_clock::now()-start;
+        std::printf("%-14s %-8s threads=%-4zu %12.0f tasks/s\n",
+                    name,
+                    mode,
+                    nthreads,
+                    double(tasks)/elapsed.count());
+    }
+
+    // Batches submitted from outside of the executor
+    template<typename Executor>
+    void flat(const char *name, Executor &ex, size_t nthreads, size_t tasks) {
+        const size_t batch=1000;
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        std::vector<future<int>> fs;
+        fs.reserve(batch);
+        for (size_t done=0; done<tasks; done+=batch) {
+            for (size_t i=0; i<batch; i++) fs.push_back(ex(work, int(i)));
+            for (auto &f : fs) f.get();
+            fs.clear();
+        }
+        report(name, "flat", nthreads, tasks, start);
+    }
+
+    // Every task submits the next level of a binary tree, the last leaf
+    // completes the run
+    template<typename Executor>
+    struct tree {
+        void operator()(int depth) const {
+            if (depth==0) {
+                work(depth);
+                if (--leaves_==0) done_.set_value();
+                return;
+            }
+            ex_(*this, depth-1);
+            ex_(*this, depth-1);
+        }
+
+        Executor &ex_;
+        boost::atomic<size_t> &leaves_;
+        promise<void> &done_;
+    };
+
+    template<typename Executor>
+    void nested(const char *name, Executor &ex, size_t nthreads, size_t tasks) {
+        int depth=0;
+        while ((size_t(2)<<depth)<tasks) depth++;
+        boost::atomic<size_t> leaves(size_t(1)<<depth);
+        promise<void> done;
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        ex(tree<Executor>{ex, leaves, done}, depth);
+        done.get_future().get();
+        report(name, "nested", nthreads, (size_t(2)<<depth)-1, start);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t workers=argc>1 ? std::atoi(argv[1]) : 4;
+    size_t tasks=argc>2 ? std::atoi(argv[2]) : 200000;
+    greenify_with_sched(scheduler(), [&](){
+        if (workers>1) get_scheduler().add_worker_thread(workers-1);
+        const size_t nthreads[]={1, 2, 4, 8};
+        for (size_t n : nthreads) {
+            {
+                // Typed to one result type
+                async_executor<int> ex(n);
+                flat("async_executor", ex, n, tasks);
+                async_executor<void> ex2(n);
+                nested("async_executor", ex2, n, tasks);
+            }
+            {
+                work_stealing_executor ex(n);
+                flat("work_stealing", ex, n, tasks);
+                nested("work_stealing", ex, n, tasks);
+            }
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+//  bench_future.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+// Promise/future churn with shared states from the global allocator and
+// from the per-worker pools, and async() on new and pooled threads
+//
+// Usage: bench_future [workers] [iterations]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/future.hpp>
+#include <boost/green_thread/pool_allocator.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    template<typename Allocator>
+    size_t churn(size_t iterations) {
+        size_t sum=0;
+        for (size_t i=0; i<iterations; i++) {
+            promise<size_t> p(boost::allocator_arg, Allocator());
+            future<size_t> f=p.get_future();
+            p.set_value(i);
+            sum+=f.get();
+        }
+        return sum;
+    }
+
+    template<typename Allocator>
+    void run(const char *name, size_t nthreads, size_t iterations) {
+        boost::atomic<size_t> total(0);
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        {
+            thread_group threads;
+            for (size_t i=0; i<nthreads; i++) {
+                threads.create_thread([&](){
+                    total+=churn<Allocator>(iterations);
+                });
+            }
+            threads.join_all();
+        }
+        boost::chrono::duration<double> elapsed=boost::chrono::steady_clock::now()-start;
+        if (total!=nthreads*(iterations*(iterations-1)/2)) {
+            std::fprintf(stderr, "sum mismatch: %zu\n", size_t(total));
+            std::exit(1);
+        }
+        std::printf("%-8s threads=%-4zu %12.0f futures/s\n",
+                    name,
+                    nthreads,
+                    double(nthreads*iterations)/elapsed.count());
+    }
+
+    void run_async(const char *name, launch policy, size_t nthreads, size_t iterations) {
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        {
+            thread_group threads;
+            for (size_t i=0; i<nthreads; i++) {
+                threads.create_thread([&](){
+                    for (size_t j=0; j<iterations; j++) {
+                        async(policy, [](){ return 1; }).get();
+                    }
+                });
+            }
+            threads.join_all();
+        }
+        boost::chrono::duration<double> elapsed=boost::chrono::steady_clock::now()-start;
+        std::printf("%-8s threads=%-4zu %12.0f futures/s\n",
+                    name,
+                    nthreads,
+                    double(nthreads*iterations)/elapsed.count());
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t workers=argc>1 ? std::atoi(argv[1]) : 4;
+    size_t iterations=argc>2 ? std::atoi(argv[2]) : 100000;
+    greenify_with_sched(scheduler(), [&](){
+        if (workers>1) get_scheduler().add_worker_thread(workers-1);
+        const size_t nthreads[]={1, 4, 16};
+        for (size_t n : nthreads) {
+            run<std::allocator<void>>("std", n, iterations);
+            run<pool_allocator<void>>("pool", n, iterations);
+            run_async("thread", launch::new_thread, n, iterations/10);
+            run_async("pooled", launch::pool, n, iterations/10);
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,81 @@
+//
+//  bench_mutex.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+// Compares handoff and barging ownership transfer of green mutexes
+//
+// Usage: bench_mutex [workers] [iterations]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    const char *policy_name(lock_policy policy) {
+        return policy==lock_policy::handoff ? "handoff" : "barging";
+    }
+
+    // Some work inside/outside of the critical section, not optimized away
+    inline void spin(size_t n) {
+        static volatile size_t sink=0;
+        for (size_t i=0; i<n; i++) sink=sink+i;
+    }
+
+    void run(lock_policy policy, size_t nthreads, size_t iterations) {
+        mutex m(policy);
+        size_t counter=0;
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        {
+            thread_group threads;
+            for (size_t i=0; i<nthreads; i++) {
+                threads.create_thread([&](){
+                    for (size_t j=0; j<iterations; j++) {
+                        {
+                            boost::unique_lock<mutex> lock(m);
+                            ++counter;
+                            spin(50);
+                        }
+                        spin(200);
+                    }
+                });
+            }
+            threads.join_all();
+        }
+        boost::chrono::duration<double> elapsed=boost::chrono::steady_clock::now()-start;
+        if (counter!=nthreads*iterations) {
+            std::fprintf(stderr, "counter mismatch: %zu\n", counter);
+            std::exit(1);
+        }
+        std::printf("%-8s threads=%-4zu %12.0f locks/s\n",
+                    policy_name(policy),
+                    nthreads,
+                    double(counter)/elapsed.count());
+        // Shows progress when the output is piped
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t workers=argc>1 ? std::atoi(argv[1]) : 4;
+    size_t iterations=argc>2 ? std::atoi(argv[2]) : 2000;
+    greenify_with_sched(scheduler(), [&](){
+        if (workers>1) get_scheduler().add_worker_thread(workers-1);
+        const size_t nthreads[]={4, 16, 64};
+        for (size_t n : nthreads) {
+            run(lock_policy::handoff, n, iterations);
+            run(lock_policy::barging, n, iterations);
+        }
+    });
+    return 0;
+}
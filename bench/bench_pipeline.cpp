@@ -0,0 +1,110 @@
+//
+//  bench_pipeline.cpp
+//  Boost.GreenThread
+//
+// Three stage parse/transform/write pipeline, hand-wired with concurrent
+// queues passing one item at a time against `pipeline` with several batch
+// sizes, ordered and not, and the per stage counters of the last run
+//
+// Usage: bench_pipeline [workers] [items]
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    long parse(const std::string &s) {
+        return std::stol(s);
+    }
+
+    double transform(long x) {
+        double r=0;
+        for (int i=0; i<200; i++) r+=std::sqrt(double(x+i));
+        return r;
+    }
+
+    template<typename Fn>
+    double time_ms(Fn fn) {
+        boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+        fn();
+        boost::chrono::duration<double, boost::milli> elapsed=boost::chrono::steady_clock::now()-start;
+        return elapsed.count();
+    }
+
+    double hand_wired(const std::vector<std::string> &input) {
+        concurrent_queue<long> parsed(256);
+        concurrent_queue<double> transformed(256);
+        double sum=0;
+        thread_group threads;
+        threads.create_thread([&](){
+            for (const std::string &s : input) parsed.push(parse(s));
+            parsed.close();
+        });
+        boost::atomic<int> live(4);
+        for (int i=0; i<4; i++) {
+            threads.create_thread([&](){
+                long v;
+                while (parsed.pop(v)) transformed.push(transform(v));
+                if (--live==0) transformed.close();
+            });
+        }
+        double v;
+        while (transformed.pop(v)) sum+=v;
+        threads.join_all();
+        return sum;
+    }
+
+    template<typename Pipeline>
+    void feed(Pipeline &p, const std::vector<std::string> &input) {
+        p.start();
+        for (const std::string &s : input) p.push(s);
+        p.close();
+        p.wait();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t workers=argc>1 ? std::atoi(argv[1]) : 4;
+    size_t n=argc>2 ? std::atoi(argv[2]) : 200000;
+    std::vector<std::string> input(n);
+    for (size_t i=0; i<n; i++) input[i]=std::to_string(i);
+
+    greenify_with_sched(scheduler(), [&](){
+        if (workers>1) get_scheduler().add_worker_thread(workers-1);
+        double sink=0;
+        double t=time_ms([&](){ sink+=hand_wired(input); });
+        std::printf("hand-wired queues          %8.1fms\n", t);
+        std::vector<pipeline_stage_stats> stats;
+        for (size_t batch : {1, 16, 64}) {
+            for (bool ordered : {false, true}) {
+                auto p=pipeline<std::string>(8, batch)
+                    .stage("parse", [](std::string s){ return parse(s); })
+                    .stage("transform", transform, 4, ordered)
+                    .stage("write", [&](double v){ sink+=v; });
+                t=time_ms([&](){ feed(p, input); });
+                std::printf("pipeline batch=%-3zu %-7s %8.1fms\n", batch, ordered ? "ordered" : "", t);
+                stats=p.stats();
+            }
+        }
+        for (const pipeline_stage_stats &s : stats) {
+            std::printf("  %-10s x%zu  %8.0f items/s  latency %6.2fus  busy %5.1f%%  starved %8.1fms  blocked %8.1fms\n",
+                        s.name.c_str(), s.parallelism, s.throughput(),
+                        boost::chrono::duration<double, boost::micro>(s.latency()).count(),
+                        100*s.utilization(),
+                        boost::chrono::duration<double, boost::milli>(s.starved).count(),
+                        boost::chrono::duration<double, boost::milli>(s.blocked).count());
+        }
+        std::printf("(%g)\n", sink);
+    });
+    return 0;
+}
@@ -0,0 +1,80 @@
+//
+//  bench_task_graph.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+// Runs a layered graph of busy nodes, each depending on a few nodes of the
+// layer before, on 1 to N worker threads, and prints the critical path of
+// the last run
+//
+// Usage: bench_task_graph [max workers] [layers] [nodes per layer]
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/task_graph.hpp>
+
+using namespace boost::green_thread;
+
+namespace {
+    double spin(size_t n) {
+        double x=0;
+        for (size_t i=0; i<n; i++) x+=std::sqrt(double(i));
+        return x;
+    }
+
+    void build(task_graph &g, size_t layers, size_t width, std::vector<double> &out) {
+        std::mt19937 rng(42);
+        out.assign(layers*width, 0);
+        for (size_t l=0; l<layers; l++) {
+            for (size_t i=0; i<width; i++) {
+                // Uneven work, so there is a critical path to find
+                const size_t work=10000+rng()%90000;
+                double *slot=&out[l*width+i];
+                task_graph::node_id id=g.add([slot, work](){ *slot=spin(work); },
+                                             "L"+std::to_string(l)+"/"+std::to_string(i));
+                if (l==0) continue;
+                for (int k=0; k<3; k++) {
+                    g.precede((l-1)*width+rng()%width, id);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_workers=argc>1 ? std::atoi(argv[1]) : 8;
+    size_t layers=argc>2 ? std::atoi(argv[2]) : 20;
+    size_t width=argc>3 ? std::atoi(argv[3]) : 50;
+
+    greenify_with_sched(scheduler(), [&](){
+        std::vector<double> out;
+        task_graph g;
+        build(g, layers, width, out);
+        g.run();    // Warm up the pool
+        for (size_t workers=1; workers<=max_workers; workers*=2) {
+            if (workers>1) get_scheduler().add_worker_thread(workers/2);
+            boost::chrono::steady_clock::time_point start=boost::chrono::steady_clock::now();
+            const int runs=5;
+            for (int i=0; i<runs; i++) g.run();
+            boost::chrono::duration<double, boost::milli> elapsed=boost::chrono::steady_clock::now()-start;
+            boost::chrono::duration<double, boost::milli> critical=g.report().critical_path_time;
+            std::printf("workers=%-3zu nodes=%zu  %8.2fms/run  critical path %8.2fms\n",
+                        workers, g.size(), elapsed.count()/runs, critical.count());
+        }
+        std::cout << g.report();
+    });
+    return 0;
+}
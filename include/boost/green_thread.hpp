@@ -2,10 +2,23 @@
 #include <boost/green_thread/tss.hpp>
 #include <boost/green_thread/mutex.hpp>
 #include <boost/green_thread/shared_mutex.hpp>
+#include <boost/green_thread/semaphore.hpp>
+#include <boost/green_thread/atomic_wait.hpp>
 #include <boost/green_thread/condition_variable.hpp>
 #include <boost/green_thread/barrier.hpp>
+#include <boost/green_thread/latch.hpp>
+#include <boost/green_thread/lock_profile.hpp>
 #include <boost/green_thread/thread_group.hpp>
+#include <boost/green_thread/pool_allocator.hpp>
 #include <boost/green_thread/future.hpp>
+#include <boost/green_thread/algorithm.hpp>
+#include <boost/green_thread/task_graph.hpp>
 #include <boost/green_thread/asio.hpp>
 #include <boost/green_thread/concurrent_queue.hpp>
+#include <boost/green_thread/spill_buffer.hpp>
+#include <boost/green_thread/spsc_channel.hpp>
+#include <boost/green_thread/mailbox.hpp>
+#include <boost/green_thread/broadcast_channel.hpp>
+#include <boost/green_thread/pipeline.hpp>
+#include <boost/green_thread/select.hpp>
 #include <boost/green_thread/iostream.hpp>
@@ -0,0 +1,417 @@
+//
+//  algorithm.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_ALGORITHM_HPP
+#define BOOST_GREEN_THREAD_ALGORITHM_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/optional.hpp>
+#include <boost/green_thread/future/future.hpp>
+#include <boost/green_thread/future/async.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        /**
+         * Smallest piece for `n` elements, 16 per worker thread by default,
+         * `grain` if given
+         */
+        inline size_t grain_size(size_t n, size_t grain) {
+            if (grain>0) return grain;
+            const size_t pieces=16*std::max(pool_concurrency(), size_t(1));
+            return std::max((n+pieces-1)/pieces, size_t(1));
+        }
+
+        /**
+         * Pieces computing for one call of an algorithm, a piece splits only
+         * while there are fewer of them than worker threads
+         */
+        class split_state {
+        public:
+            split_state()
+            : target_(std::max(pool_concurrency(), size_t(1)))
+            , running_(1)
+            {}
+
+            /// Takes a slot for a new piece if a worker may be idle
+            bool want_split() {
+                size_t r=running_.load(boost::memory_order_relaxed);
+                while (r<target_) {
+                    if (running_.compare_exchange_weak(r, r+1, boost::memory_order_relaxed)) return true;
+                }
+                return false;
+            }
+
+            /// The calling piece is done computing
+            void piece_done() {
+                running_.fetch_sub(1, boost::memory_order_relaxed);
+            }
+
+        private:
+            const size_t target_;
+            boost::atomic<size_t> running_;
+        };
+
+        /// Waits for all pieces so none of them outlives what it refers to
+        template<typename Futures>
+        void wait_all(Futures &pieces) {
+            for (auto &f : pieces) f.wait();
+        }
+
+        /**
+         * Calls `body(first, last)` on consecutive chunks of `grain`
+         * elements, before each chunk the second half of what's left is
+         * handed to a pool thread if there is an idle worker
+         *
+         * A piece which finishes early makes room for the running ones to
+         * split again, so the work is only divided as much as the load
+         * balance requires.
+         */
+        template<typename Index, typename Body>
+        void split_range(Index first, Index last, size_t grain, const Body &body, split_state &state) {
+            std::vector<future<void>> right;
+            // The pieces still use `body`, they must be done before this
+            // returns, but not waited for in the handler, blocking there would
+            // lose the exception when the thread switches
+            std::exception_ptr error;
+            try {
+                while (first!=last) {
+                    if (size_t(last-first)>=2*grain && state.want_split()) {
+                        const Index mid=first+(last-first)/2;
+                        right.push_back(async(launch::pool, [mid, last, grain, &body, &state](){
+                            split_range(mid, last, grain, body, state);
+                        }));
+                        last=mid;
+                        continue;
+                    }
+                    const Index end=size_t(last-first)<=grain ? last : first+grain;
+                    body(first, end);
+                    first=end;
+                }
+            } catch(...) {
+                error=std::current_exception();
+            }
+            state.piece_done();
+            wait_all(right);
+            if (error) std::rethrow_exception(error);
+            for (auto &f : right) f.get();
+        }
+
+        template<typename Index, typename Body>
+        void split_range(Index first, Index last, size_t grain, const Body &body) {
+            split_state state;
+            split_range(first, last, grain, body, state);
+        }
+
+        /// Same as `split_range`, combining the results of the chunks in order
+        template<typename T, typename Index, typename Body, typename Combine>
+        T split_reduce(Index first, Index last, size_t grain, const Body &body, const Combine &combine, split_state &state) {
+            std::vector<future<T>> right;
+            boost::optional<T> acc;
+            std::exception_ptr error;
+            try {
+                while (first!=last) {
+                    if (size_t(last-first)>=2*grain && state.want_split()) {
+                        const Index mid=first+(last-first)/2;
+                        right.push_back(async(launch::pool, [mid, last, grain, &body, &combine, &state](){
+                            return split_reduce<T>(mid, last, grain, body, combine, state);
+                        }));
+                        last=mid;
+                        continue;
+                    }
+                    const Index end=size_t(last-first)<=grain ? last : first+grain;
+                    if (acc) {
+                        acc=combine(std::move(*acc), body(first, end));
+                    } else {
+                        acc=body(first, end);
+                    }
+                    first=end;
+                }
+            } catch(...) {
+                error=std::current_exception();
+            }
+            state.piece_done();
+            wait_all(right);
+            if (error) std::rethrow_exception(error);
+            // The last piece split off is the nearest one
+            for (auto i=right.rbegin(); i!=right.rend(); ++i) {
+                acc=combine(std::move(*acc), i->get());
+            }
+            return std::move(*acc);
+        }
+
+        template<typename T, typename Index, typename Body, typename Combine>
+        T split_reduce(Index first, Index last, size_t grain, const Body &body, const Combine &combine) {
+            split_state state;
+            return split_reduce<T>(first, last, grain, body, combine, state);
+        }
+
+        /**
+         * Moves the merge of the sorted ranges `[a1, a2)` and `[b1, b2)` to
+         * `out`, the middle element of the longer range splits both of them
+         * in two merges running concurrently
+         */
+        template<typename It, typename Out, typename Compare>
+        void merge_move(It a1, It a2, It b1, It b2, Out out, const Compare &comp, size_t grain) {
+            if (a2-a1<b2-b1) {
+                std::swap(a1, b1);
+                std::swap(a2, b2);
+            }
+            if (size_t((a2-a1)+(b2-b1))<=grain) {
+                std::merge(std::make_move_iterator(a1), std::make_move_iterator(a2),
+                           std::make_move_iterator(b1), std::make_move_iterator(b2),
+                           out, comp);
+                return;
+            }
+            const It m1=a1+(a2-a1)/2;
+            const It m2=std::lower_bound(b1, b2, *m1, comp);
+            const Out om=out+(m1-a1)+(m2-b1);
+            *om=std::move(*m1);
+            future<void> right=async(launch::pool, [=, &comp](){
+                merge_move(m1+1, a2, m2, b2, om+1, comp, grain);
+            });
+            std::exception_ptr error;
+            try {
+                merge_move(a1, m1, b1, m2, out, comp, grain);
+            } catch(...) {
+                error=std::current_exception();
+            }
+            right.wait();
+            if (error) std::rethrow_exception(error);
+            right.get();
+        }
+
+        /**
+         * Sorts pieces of at most `grain_` elements with `std::sort`, merging
+         * them pairwise through `buf_` with `merge_move`, or in place with
+         * `std::inplace_merge` if there is a single worker thread or the
+         * elements can't be default constructed, the buffer and moving the
+         * elements back only pay off when the merges run concurrently
+         */
+        template<typename Iterator, typename Compare>
+        class sorter {
+        public:
+            typedef typename std::iterator_traits<Iterator>::value_type value_type;
+
+            sorter(Iterator first, Iterator last, Compare &comp, size_t grain)
+            : first_(first)
+            , comp_(comp)
+            , grain_(grain)
+            , buf_(pool_concurrency()>1 ? make_buffer(last-first, std::is_default_constructible<value_type>())
+                                        : std::unique_ptr<value_type[]>())
+            {}
+
+            void operator()(Iterator b, Iterator e) const {
+                if (size_t(e-b)<=grain_) {
+                    std::sort(b, e, comp_);
+                    return;
+                }
+                const Iterator mid=b+(e-b)/2;
+                future<void> right=async(launch::pool, [this, mid, e](){ (*this)(mid, e); });
+                std::exception_ptr error;
+                try {
+                    (*this)(b, mid);
+                } catch(...) {
+                    error=std::current_exception();
+                }
+                if (error) {
+                    right.wait();
+                    std::rethrow_exception(error);
+                }
+                right.get();
+                merge(b, mid, e);
+            }
+
+        private:
+            static std::unique_ptr<value_type[]> make_buffer(size_t n, std::true_type) {
+                return std::unique_ptr<value_type[]>(new value_type[n]);
+            }
+
+            static std::unique_ptr<value_type[]> make_buffer(size_t, std::false_type) {
+                return std::unique_ptr<value_type[]>();
+            }
+
+            void merge(Iterator b, Iterator mid, Iterator e) const {
+                if (!buf_) {
+                    std::inplace_merge(b, mid, e, comp_);
+                    return;
+                }
+                value_type *out=buf_.get()+(b-first_);
+                merge_move(b, mid, mid, e, out, comp_, grain_);
+                split_range(size_t(0), size_t(e-b), grain_, [b, out](size_t i, size_t j){
+                    std::move(out+i, out+j, b+i);
+                });
+            }
+
+            Iterator first_;
+            Compare &comp_;
+            size_t grain_;
+            std::unique_ptr<value_type[]> buf_;
+        };
+
+        template<typename Index, typename F>
+        void apply_at(Index i, F &f, std::true_type) { f(i); }
+
+        template<typename Iterator, typename F>
+        void apply_at(Iterator i, F &f, std::false_type) { f(*i); }
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Calls `f` on every element of `[first, last)`, or on every index if
+     * `first` and `last` are integers
+     *
+     * The range is worked through in chunks of `grain` elements, picked
+     * from the number of worker threads of the current scheduler if 0.
+     * While fewer pieces are running than the scheduler has worker threads,
+     * a piece hands the second half of what it has left to a pool thread
+     * of the scheduler before its next chunk, so the range is only split as
+     * far as keeping the workers busy needs. `f` is called concurrently.
+     * The first exception thrown by `f` is rethrown once every piece is
+     * done.
+     */
+    template<typename Iterator, typename F>
+    void parallel_for(Iterator first, Iterator last, F f, size_t grain=0) {
+        if (!(first<last)) return;
+        const size_t n=last-first;
+        detail::split_range(first, last, detail::grain_size(n, grain), [&f](Iterator b, Iterator e){
+            for (; b!=e; ++b) detail::apply_at(b, f, std::is_integral<Iterator>());
+        });
+    }
+
+    /**
+     * Stores `op(x)` for every element `x` of `[first, last)` into the
+     * range starting at `d_first`, returns the end of the output
+     *
+     * @see parallel_for
+     */
+    template<typename InputIt, typename OutputIt, typename UnaryOp>
+    OutputIt parallel_transform(InputIt first, InputIt last, OutputIt d_first, UnaryOp op, size_t grain=0) {
+        if (first==last) return d_first;
+        const size_t n=last-first;
+        detail::split_range(first, last, detail::grain_size(n, grain), [&](InputIt b, InputIt e){
+            std::transform(b, e, d_first+(b-first), op);
+        });
+        return d_first+n;
+    }
+
+    /**
+     * Combines `transform(x)` for every element `x` of `[first, last)`
+     * and `init` with `reduce`, which must be associative, the order of
+     * the operands is kept
+     *
+     * @see parallel_for
+     */
+    template<typename Iterator, typename T, typename BinaryOp, typename UnaryOp>
+    T parallel_transform_reduce(Iterator first, Iterator last, T init, BinaryOp reduce, UnaryOp transform, size_t grain=0) {
+        if (first==last) return init;
+        const size_t n=last-first;
+        T result=detail::split_reduce<T>(first, last, detail::grain_size(n, grain),
+            [&](Iterator b, Iterator e) -> T {
+                T acc=transform(*b);
+                for (++b; b!=e; ++b) acc=reduce(std::move(acc), transform(*b));
+                return acc;
+            },
+            [&](T l, T r) -> T { return reduce(std::move(l), std::move(r)); });
+        return reduce(std::move(init), std::move(result));
+    }
+
+    /**
+     * Combines the elements of `[first, last)` and `init` with `op`, which
+     * must be associative
+     *
+     * @see parallel_transform_reduce
+     */
+    template<typename Iterator, typename T, typename BinaryOp=std::plus<T>>
+    T parallel_reduce(Iterator first, Iterator last, T init, BinaryOp op=BinaryOp(), size_t grain=0) {
+        typedef typename std::iterator_traits<Iterator>::reference reference;
+        return parallel_transform_reduce(first, last, std::move(init), op,
+                                         [](reference x) -> reference { return x; },
+                                         grain);
+    }
+
+    /**
+     * Sorts `[first, last)` with `comp`, not stable
+     *
+     * Pieces are sorted with `std::sort` and merged pairwise, the halves of
+     * every merge being sorted concurrently. A merge is split around the
+     * middle element of the longer half into merges running concurrently,
+     * which needs a buffer as large as the range. With a single worker
+     * thread, or elements which can't be default constructed, the halves
+     * are merged in place, one merge at a time.
+     *
+     * @see parallel_for
+     */
+    template<typename Iterator, typename Compare>
+    void parallel_sort(Iterator first, Iterator last, Compare comp, size_t grain=0) {
+        if (first==last) return;
+        detail::sorter<Iterator, Compare>(first, last, comp, detail::grain_size(last-first, grain))(first, last);
+    }
+
+    template<typename Iterator>
+    void parallel_sort(Iterator first, Iterator last) {
+        parallel_sort(first, last, std::less<typename std::iterator_traits<Iterator>::value_type>());
+    }
+
+    /**
+     * Stores the inclusive prefix sums of `[first, last)` by `op`, which
+     * must be associative, into the range starting at `d_first`, returns
+     * the end of the output, the output may be the input
+     *
+     * Every piece is scanned on its own, then the totals of the preceding
+     * pieces are added to it, so `op` is called about twice per element.
+     *
+     * @see parallel_for
+     */
+    template<typename InputIt, typename OutputIt, typename BinaryOp>
+    OutputIt parallel_scan(InputIt first, InputIt last, OutputIt d_first, BinaryOp op, size_t grain=0) {
+        typedef typename std::iterator_traits<InputIt>::value_type value_type;
+        if (first==last) return d_first;
+        const size_t n=last-first;
+        const size_t g=detail::grain_size(n, grain);
+        const size_t pieces=(n+g-1)/g;
+        if (pieces==1) return std::partial_sum(first, last, d_first, op);
+        std::vector<boost::optional<value_type>> carry(pieces);
+        parallel_for(size_t(0), pieces, [&](size_t i){
+            const size_t b=i*g;
+            const size_t e=std::min(b+g, n);
+            std::partial_sum(first+b, first+e, d_first+b, op);
+            carry[i]=*(d_first+(e-1));
+        }, 1);
+        // Totals of the pieces before each one
+        for (size_t i=1; i<pieces; i++) {
+            carry[i]=op(*carry[i-1], *carry[i]);
+        }
+        parallel_for(size_t(1), pieces, [&](size_t i){
+            const size_t b=i*g;
+            const size_t e=std::min(b+g, n);
+            const value_type &c=*carry[i-1];
+            for (size_t k=b; k<e; k++) {
+                *(d_first+k)=op(c, *(d_first+k));
+            }
+        }, 1);
+        return d_first+n;
+    }
+
+    template<typename InputIt, typename OutputIt>
+    OutputIt parallel_scan(InputIt first, InputIt last, OutputIt d_first) {
+        return parallel_scan(first, last, d_first, std::plus<typename std::iterator_traits<InputIt>::value_type>());
+    }
+}}  // End of namespace boost::green_thread
+
+#endif
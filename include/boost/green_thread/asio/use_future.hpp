@@ -15,6 +15,7 @@
 
 #include <boost/config.hpp>
 #include <boost/asio/detail/config.hpp>
+#include <boost/green_thread/pool_allocator.hpp>
 
 namespace boost { namespace green_thread { namespace asio {
     /**
@@ -25,7 +26,7 @@ namespace boost { namespace green_thread { namespace asio {
      *
      * @see boost::green_thread::future
      */
-    template<typename Allocator = std::allocator<void>>
+    template<typename Allocator = pool_allocator<void>>
     class use_future_t
     {
     public:
@@ -15,6 +15,7 @@
 #include <functional>
 #include <boost/system/error_code.hpp>
 #include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/interrupt_hook.hpp>
 
 namespace boost { namespace green_thread { namespace asio {
     /**
@@ -47,6 +48,37 @@ namespace boost { namespace green_thread { namespace asio {
     
     /// predefined instance of yield_t can be used directly
     constexpr yield_t yield;
+    
+    /**
+     * class cancel_on_interrupt
+     *
+     * Cancels the pending operations of an asio I/O object, like a socket or
+     * a timer, if the current thread is interrupted while the instance
+     * exists. An operation waited with `yield` then completes with
+     * `operation_aborted` and the thread gets `thread_interrupted`.
+     */
+    template<typename IoObject>
+    class cancel_on_interrupt : private green_thread::detail::interrupt_hook {
+    public:
+        explicit cancel_on_interrupt(IoObject &obj)
+        : obj_(obj)
+        { green_thread::detail::attach_interrupt_hook(this); }
+        
+        ~cancel_on_interrupt()
+        { green_thread::detail::detach_interrupt_hook(this); }
+        
+    private:
+        /// non-copyable
+        cancel_on_interrupt(const cancel_on_interrupt &)=delete;
+        void operator=(const cancel_on_interrupt &)=delete;
+        
+        void on_interrupt() noexcept override {
+            boost::system::error_code ec;
+            obj_.cancel(ec);
+        }
+        
+        IoObject &obj_;
+    };
 }}} // End of namespace boost::green_thread::asio
 
 #include <boost/green_thread/asio/detail/yield.hpp>
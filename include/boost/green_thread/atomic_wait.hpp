@@ -0,0 +1,108 @@
+//
+//  atomic_wait.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_ATOMIC_WAIT_HPP
+#define BOOST_GREEN_THREAD_ATOMIC_WAIT_HPP
+
+#include <type_traits>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        template<typename T>
+        struct atomic_wait_handler : park_handler {
+            atomic_wait_handler(const boost::atomic<T> &a, T old)
+            : a_(a)
+            , old_(old)
+            {}
+            
+            virtual bool validate() override {
+                return a_.load(boost::memory_order_relaxed)==old_;
+            }
+            
+            const boost::atomic<T> &a_;
+            T old_;
+        };
+    }   // End of namespace boost::green_thread::detail
+    
+    /**
+     * Blocks until `a` is notified and its value differs from `old`
+     *
+     * Works like `std::atomic<T>::wait`, green threads are parked and foreign
+     * threads are blocked, the notifier can be any thread.
+     */
+    template<typename T>
+    void atomic_wait(const boost::atomic<T> &a,
+                     typename std::common_type<T>::type old,
+                     boost::memory_order order=boost::memory_order_seq_cst)
+    {
+        detail::atomic_wait_handler<T> handler(a, old);
+        while (a.load(order)==old) {
+            detail::park(&a, handler);
+        }
+    }
+    
+    /**
+     * Blocks until `a` is notified and its value differs from `old`, or the
+     * specified time point has been reached
+     *
+     * @return false if the value still equals to `old` after timeout
+     */
+    template<typename T, class Clock, class Duration>
+    bool atomic_wait_until(const boost::atomic<T> &a,
+                           typename std::common_type<T>::type old,
+                           const boost::chrono::time_point<Clock,Duration>& timeout_time,
+                           boost::memory_order order=boost::memory_order_seq_cst)
+    {
+        const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+            +boost::chrono::duration_cast<detail::duration_t>(timeout_time-Clock::now());
+        detail::atomic_wait_handler<T> handler(a, old);
+        while (a.load(order)==old) {
+            if (boost::chrono::steady_clock::now()>=deadline) return false;
+            detail::park(&a, handler, &deadline);
+        }
+        return true;
+    }
+    
+    /**
+     * Blocks until `a` is notified and its value differs from `old`, or the
+     * specified timeout duration has elapsed
+     *
+     * @return false if the value still equals to `old` after timeout
+     */
+    template<typename T, class Rep, class Period>
+    bool atomic_wait_for(const boost::atomic<T> &a,
+                         typename std::common_type<T>::type old,
+                         const boost::chrono::duration<Rep,Period>& timeout_duration,
+                         boost::memory_order order=boost::memory_order_seq_cst)
+    {
+        return atomic_wait_until(a, old, boost::chrono::steady_clock::now()+timeout_duration, order);
+    }
+    
+    /**
+     * Wakes at least one thread blocked in `atomic_wait` on `a`, if any
+     */
+    template<typename T>
+    void atomic_notify_one(const boost::atomic<T> &a) {
+        detail::unpark_one(&a);
+    }
+    
+    /**
+     * Wakes all threads blocked in `atomic_wait` on `a`
+     */
+    template<typename T>
+    void atomic_notify_all(const boost::atomic<T> &a) {
+        detail::unpark_all(&a);
+    }
+}}  // End of namespace boost::green_thread
+
+#endif
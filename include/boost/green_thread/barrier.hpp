@@ -14,10 +14,15 @@
 #ifndef BOOST_GREEN_THREAD_BARRIER_H
 #define BOOST_GREEN_THREAD_BARRIER_H
 
+#include <cassert>
+#include <memory>
+#include <vector>
+#include <functional>
 #include <type_traits>
+#include <boost/atomic.hpp>
 #include <boost/green_thread/exceptions.hpp>
-#include <boost/green_thread/mutex.hpp>
-#include <boost/green_thread/condition_variable.hpp>
+#include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/detail/waiter.hpp>
 
 namespace boost { namespace green_thread {
     namespace detail {
@@ -38,7 +43,7 @@ namespace boost { namespace green_thread {
             template <typename F>
             void_functor_barrier_reseter(unsigned int size, F &&funct)
             : size_(size)
-            , fct_(std::move(funct))
+            , fct_(std::forward<F>(funct))
             {}
 
             unsigned int operator()() {
@@ -59,13 +64,151 @@ namespace boost { namespace green_thread {
                 return size_;
             }
         };
+        
+        /**
+         * Combining tree of arrival counters, arrivals are spread over leaves
+         * with `fan_in` slots each, the thread filling up a node arrives at its
+         * parent, and the thread filling up the root is the last arriver
+         */
+        class barrier_tree {
+        public:
+            barrier_tree(unsigned int count, unsigned int fan_in)
+            : fan_in_(fan_in<2 ? 2 : fan_in)
+            {
+                layout(count);
+            }
+            
+            /**
+             * Lays out nodes for `count` participants, must not be called
+             * while any thread is arriving
+             */
+            void layout(unsigned int count) {
+                leaves_=(count+fan_in_-1)/fan_in_;
+                std::vector<unsigned int> expected;
+                std::vector<size_t> parent;
+                for (size_t i=0; i<leaves_; i++) {
+                    expected.push_back(i+1<leaves_ ? fan_in_ : count-fan_in_*(leaves_-1));
+                }
+                size_t level_begin=0, level_size=leaves_;
+                while (level_size>1) {
+                    const size_t next_begin=level_begin+level_size;
+                    const size_t next_size=(level_size+fan_in_-1)/fan_in_;
+                    for (size_t i=0; i<level_size; i++) {
+                        parent.push_back(next_begin+i/fan_in_);
+                    }
+                    for (size_t i=0; i<next_size; i++) {
+                        expected.push_back(i+1<next_size ? fan_in_ : level_size-fan_in_*(next_size-1));
+                    }
+                    level_begin=next_begin;
+                    level_size=next_size;
+                }
+                // Root
+                const size_t root_parent=npos;
+                parent.push_back(root_parent);
+                size_=expected.size();
+                nodes_.reset(new node[size_]);
+                for (size_t i=0; i<size_; i++) {
+                    nodes_[i].arrived_.store(0, boost::memory_order_relaxed);
+                    nodes_[i].expected_=expected[i];
+                    nodes_[i].parent_=parent[i];
+                }
+            }
+            
+            /**
+             * Returns the leaf where the calling thread starts probing
+             */
+            size_t start_leaf() const {
+                uintptr_t h=this_thread::get_id()>>4;
+                h^=(h>>7)^(h>>13);
+                return h % leaves_;
+            }
+            
+            /**
+             * Waiters that arrived through a leaf
+             */
+            waiter_stack &waiters(size_t leaf) {
+                return nodes_[leaf].waiters_;
+            }
+            
+            size_t leaves() const {
+                return leaves_;
+            }
+            
+            /**
+             * Takes an arrival slot starting from `leaf`, returns true if the
+             * calling thread is the last arriver of the phase
+             */
+            bool arrive(size_t leaf) {
+                for (size_t k=0; k<leaves_; k++) {
+                    const size_t i=(leaf+k) % leaves_;
+                    node &n=nodes_[i];
+                    unsigned int v=n.arrived_.load(boost::memory_order_relaxed);
+                    while (v<n.expected_) {
+                        if (n.arrived_.compare_exchange_weak(v, v+1, boost::memory_order_acq_rel, boost::memory_order_relaxed)) {
+                            return (v+1==n.expected_) && climb(i);
+                        }
+                    }
+                }
+                // More arrivals than participants
+                assert(false);
+                return false;
+            }
+            
+            /**
+             * Resets all counters for the next phase
+             */
+            void reset() {
+                for (size_t i=0; i<size_; i++) {
+                    nodes_[i].arrived_.store(0, boost::memory_order_relaxed);
+                }
+            }
+            
+        private:
+            static constexpr size_t npos=size_t(-1);
+            
+            struct node {
+                boost::atomic<unsigned int> arrived_;
+                unsigned int expected_;
+                size_t parent_;
+                waiter_stack waiters_;
+                char padding_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+            };
+            
+            bool climb(size_t i) {
+                for (size_t p=nodes_[i].parent_; p!=npos; p=nodes_[p].parent_) {
+                    if (nodes_[p].arrived_.fetch_add(1, boost::memory_order_acq_rel)+1<nodes_[p].expected_) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            
+            unsigned int fan_in_;
+            size_t leaves_;
+            size_t size_;
+            std::unique_ptr<node[]> nodes_;
+        };
     }   // End of namespace boost::green_thread::detail
+    
+    /**
+     * Selects the combining tree mode of a barrier, arrivals are spread over
+     * counters shared by at most `fan_in` threads instead of one counter
+     */
+    struct combining_tree {
+        explicit combining_tree(unsigned int fan_in=8)
+        : fan_in_(fan_in)
+        {}
+        unsigned int fan_in_;
+    };
 
     /**
      * A barrier, also known as a rendezvous, is a synchronization point between multiple threads.
      * The barrier is configured for a particular number of threads (`n`), and as threads reach the
      * barrier they must wait until all `n` threads have arrived. Once the n-th thread has reached
      * the barrier, all the waiting threads can proceed, and the barrier is reset.
+     *
+     * Arrivals decrement an atomic counter, or take a slot in a combining tree of counters, and
+     * park on a lock-free waiter list, the last arriver wakes all waiters in one batch.
      */
     class barrier {
         struct dummy {};
@@ -75,7 +218,6 @@ namespace boost { namespace green_thread {
          */
         explicit barrier(unsigned int count)
         : m_count(check_counter(count))
-        , m_generation(0)
         , fct_(detail::default_barrier_reseter(count))
         {}
         
@@ -85,10 +227,9 @@ namespace boost { namespace green_thread {
         template <typename F>
         barrier(unsigned int count,
                 F&& completion,
-                typename std::enable_if<std::is_void<typename std::result_of<F>::type>::value, dummy*>::type=0)
+                typename std::enable_if<std::is_void<typename std::result_of<F()>::type>::value, dummy*>::type=0)
         : m_count(check_counter(count))
-        , m_generation(0)
-        , fct_(detail::void_functor_barrier_reseter(count, std::move(completion)))
+        , fct_(detail::void_functor_barrier_reseter(count, std::forward<F>(completion)))
         {}
         
         /**
@@ -97,17 +238,16 @@ namespace boost { namespace green_thread {
         template <typename F>
         barrier(unsigned int count,
                 F&& completion,
-                typename std::enable_if<std::is_same<typename std::result_of<F>::type, unsigned int>::value, dummy*>::type=0)
+                typename std::enable_if<std::is_same<typename std::result_of<F()>::type, unsigned int>::value, dummy*>::type=0)
         : m_count(check_counter(count))
-        , m_generation(0)
-        , fct_(std::move(completion))
+        , fct_(std::forward<F>(completion))
         {}
         
         /**
          * Construct a barrier for `count` threads and a completion function `completion`.
          */
         barrier(unsigned int count, void(*completion)()) :
-        m_count(check_counter(count)), m_generation(0),
+        m_count(check_counter(count)),
         fct_(completion
              ? detail::size_completion_function(detail::void_fct_ptr_barrier_reseter(count, completion))
              : detail::size_completion_function(detail::default_barrier_reseter(count)))
@@ -117,12 +257,47 @@ namespace boost { namespace green_thread {
          * Construct a barrier for `count` threads and a completion function `completion`.
          */
         barrier(unsigned int count, unsigned int(*completion)()) :
-        m_count(check_counter(count)), m_generation(0),
+        m_count(check_counter(count)),
         fct_(completion
              ? detail::size_completion_function(completion)
              : detail::size_completion_function(detail::default_barrier_reseter(count)))
         {}
         
+        /**
+         * Construct a barrier for `count` threads in combining tree mode
+         */
+        barrier(unsigned int count, combining_tree tree)
+        : m_count(check_counter(count))
+        , fct_(detail::default_barrier_reseter(count))
+        , tree_(new detail::barrier_tree(count, tree.fan_in_))
+        {}
+        
+        /**
+         * Construct a barrier for `count` threads in combining tree mode and a completion function `completion`.
+         */
+        template <typename F>
+        barrier(unsigned int count,
+                combining_tree tree,
+                F&& completion,
+                typename std::enable_if<std::is_void<typename std::result_of<F()>::type>::value, dummy*>::type=0)
+        : m_count(check_counter(count))
+        , fct_(detail::void_functor_barrier_reseter(count, std::forward<F>(completion)))
+        , tree_(new detail::barrier_tree(count, tree.fan_in_))
+        {}
+        
+        /**
+         * Construct a barrier for `count` threads in combining tree mode and a completion function `completion`.
+         */
+        template <typename F>
+        barrier(unsigned int count,
+                combining_tree tree,
+                F&& completion,
+                typename std::enable_if<std::is_same<typename std::result_of<F()>::type, unsigned int>::value, dummy*>::type=0)
+        : m_count(check_counter(count))
+        , fct_(std::forward<F>(completion))
+        , tree_(new detail::barrier_tree(count, tree.fan_in_))
+        {}
+        
         /**
          * Block until count threads have called `wait` or `count_down_and_wait` on `*this`.
          * When the count-th thread calls `wait`, the barrier is reset and all waiting threads
@@ -133,19 +308,25 @@ namespace boost { namespace green_thread {
          * (which must not be 0).
          */
         bool wait() {
-            boost::unique_lock < mutex > lock(m_mutex);
-            unsigned int gen = m_generation;
-            
-            if (--m_count == 0) {
-                m_generation++;
-                m_count = static_cast<unsigned int>(fct_());
-                assert(m_count != 0);
-                m_cond.notify_all();
+            detail::waiter w;
+            bool last;
+            // Publish the waiter before arriving, the last arriver takes
+            // all waiters of this phase
+            if (tree_) {
+                const size_t leaf=tree_->start_leaf();
+                tree_->waiters(leaf).push(&w);
+                last=tree_->arrive(leaf);
+            } else {
+                waiters_.push(&w);
+                last=(m_count.fetch_sub(1, boost::memory_order_acq_rel)==1);
+            }
+            if (last) {
+                complete_phase(&w);
                 return true;
             }
-            
-            while (gen == m_generation)
-                m_cond.wait(lock);
+            // The arrival is counted and the waiter stays on the stack until
+            // the phase completes, so an interruption is only reported then
+            w.wait(false);
             return false;
         }
         
@@ -173,11 +354,37 @@ namespace boost { namespace green_thread {
             return count;
         }
         
-        mutex m_mutex;
-        condition_variable m_cond;
-        unsigned int m_count;
-        unsigned int m_generation;
+        void complete_phase(detail::waiter *self) {
+            // Nobody else can arrive until waiters of this phase are woken
+            const unsigned int count=static_cast<unsigned int>(fct_());
+            assert(count != 0);
+            if (tree_) {
+                std::vector<detail::waiter *> lists;
+                lists.reserve(tree_->leaves());
+                for (size_t i=0; i<tree_->leaves(); i++) {
+                    lists.push_back(tree_->waiters(i).take_all());
+                }
+                if (count==m_count.load(boost::memory_order_relaxed)) {
+                    tree_->reset();
+                } else {
+                    m_count.store(count, boost::memory_order_relaxed);
+                    tree_->layout(count);
+                }
+                for (detail::waiter *l : lists) {
+                    detail::waiter_stack::notify_all(l, self);
+                }
+            } else {
+                detail::waiter *l=waiters_.take_all();
+                m_count.store(count, boost::memory_order_relaxed);
+                detail::waiter_stack::notify_all(l, self);
+            }
+        }
+        
+        // Remaining arrivals in flat mode, number of participants in tree mode
+        boost::atomic<unsigned int> m_count;
+        detail::waiter_stack waiters_;
         detail::size_completion_function fct_;
+        std::unique_ptr<detail::barrier_tree> tree_;
     };
 }}  // End of namespace boost::green_thread
 
@@ -0,0 +1,402 @@
+//
+//  broadcast_channel.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_BROADCAST_CHANNEL_HPP
+#define BOOST_GREEN_THREAD_BROADCAST_CHANNEL_HPP
+
+#include <memory>
+#include <cstdint>
+#include <boost/atomic.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+#include <boost/green_thread/mutex.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * What a broadcast channel does when a subscriber falls a whole ring
+     * behind the publisher
+     */
+    enum class overflow_policy {
+        /// The publisher waits for the slowest subscriber
+        block,
+        /// The slow subscriber skips the messages overwritten, see `dropped()`
+        drop,
+        /// The slow subscriber is disconnected, see `is_connected()`
+        disconnect,
+    };
+
+    /**
+     * Channel delivering every published message to every subscriber
+     *
+     * A message is written once into a ring buffer, each subscriber reads it
+     * through its own cursor. Subscribers only park when they have read
+     * everything, and a publish wakes all of them at once. `T` must be
+     * default constructible and copy assignable.
+     */
+    template<typename T>
+    class broadcast_channel {
+    public:
+        typedef T value_type;
+        typedef size_t size_type;
+
+        class subscriber;
+
+        /**
+         * constructor, the capacity is rounded up to a power of 2
+         */
+        explicit broadcast_channel(size_type capacity=1024, overflow_policy policy=overflow_policy::block)
+        : mask_(round_up(capacity)-1)
+        , slots_(new slot[mask_+1])
+        , policy_(policy)
+        , tail_(0)
+        , closed_(false)
+        , waiting_(0)
+        , publisher_parked_(false)
+        , subscribers_(nullptr)
+        , cached_min_(0)
+        {}
+
+        /**
+         * Publishes a message, returns false if the channel is closed
+         */
+        bool publish(const T &v) {
+            return publish_bulk(&v, &v+1)==1;
+        }
+
+        /**
+         * Publishes a range of messages with one wakeup, returns the number
+         * of messages published, which is less than the size of the range
+         * only if the channel has been closed
+         */
+        template<typename InIterator>
+        size_type publish_bulk(InIterator first, InIterator last) {
+            boost::lock_guard<hybrid_mutex> lock(publish_mtx_);
+            size_type n=0;
+            uint64_t t=tail_.load(boost::memory_order_relaxed);
+            for ( ; first!=last; ++first, ++n, ++t) {
+                if (closed_.load()) break;
+                if (policy_==overflow_policy::block && t-cached_min_>mask_) {
+                    // Let subscribers see what is published so far before waiting for them
+                    tail_.store(t, boost::memory_order_release);
+                    wake_subscribers();
+                    if (!wait_for_room(t)) break;
+                }
+                slot &s=slots_[t & mask_];
+                boost::lock_guard<detail::spinlock> slot_lock(s.mtx_);
+                s.value_=*first;
+                s.seq_=t+1;
+            }
+            tail_.store(t, boost::memory_order_release);
+            wake_subscribers();
+            return n;
+        }
+
+        /**
+         * Stops publishing, subscribers still receive what has been published
+         */
+        void close() {
+            closed_.store(true);
+            detail::unpark_all(&tail_);
+            detail::unpark_all(&publisher_parked_);
+        }
+
+        bool is_open() const {
+            return !closed_.load();
+        }
+
+        size_type capacity() const {
+            return mask_+1;
+        }
+
+        overflow_policy policy() const {
+            return policy_;
+        }
+
+        /**
+         * Read cursor on a channel, receives the messages published after
+         * its construction
+         *
+         * A subscriber must only be used by one thread at a time.
+         */
+        class subscriber {
+        public:
+            explicit subscriber(broadcast_channel &c)
+            : c_(c)
+            , cursor_(0)
+            , dropped_(0)
+            , connected_(true)
+            , next_(nullptr)
+            , prev_(nullptr)
+            {
+                c_.attach(this);
+            }
+
+            ~subscriber() {
+                c_.detach(this);
+            }
+
+            /**
+             * Receives the next message, blocks until there is one
+             *
+             * @return false if the channel is closed and everything has been
+             * received, or this subscriber has been disconnected
+             */
+            bool receive(T &v) {
+                return receive_until(v, nullptr);
+            }
+
+            /**
+             * Receives the next message without blocking
+             */
+            bool try_receive(T &v) {
+                return take(v);
+            }
+
+            /**
+             * Receives the next message, returns false if there is none for
+             * the specified timeout duration
+             */
+            template<class Rep, class Period>
+            bool try_receive_for(T &v, const boost::chrono::duration<Rep,Period>& timeout_duration) {
+                const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                    +boost::chrono::duration_cast<detail::duration_t>(timeout_duration);
+                return receive_until(v, &deadline);
+            }
+
+            /**
+             * Number of messages skipped because this subscriber was too slow
+             */
+            uint64_t dropped() const {
+                return dropped_;
+            }
+
+            bool is_connected() const {
+                return connected_;
+            }
+
+        private:
+            /// non-copyable
+            subscriber(const subscriber &)=delete;
+            void operator=(const subscriber &)=delete;
+
+            friend class broadcast_channel;
+
+            bool take(T &v) {
+                const uint64_t capacity=c_.mask_+1;
+                for (;;) {
+                    if (!connected_) return false;
+                    const uint64_t c=cursor_.load(boost::memory_order_relaxed);
+                    const uint64_t t=c_.tail_.load(boost::memory_order_acquire);
+                    if (c==t) return false;
+                    // Oldest position which may still be in the ring
+                    uint64_t oldest=t>capacity ? t-capacity : 0;
+                    if (c>=oldest) {
+                        slot &s=c_.slots_[c & c_.mask_];
+                        boost::lock_guard<detail::spinlock> slot_lock(s.mtx_);
+                        if (s.seq_==c+1) {
+                            v=s.value_;
+                            cursor_.store(c+1);
+                        } else {
+                            // The publisher has lapped us since tail_ was read
+                            oldest=s.seq_-capacity;
+                        }
+                    }
+                    if (c<oldest) {
+                        // Overwritten, only possible if the publisher doesn't wait
+                        if (c_.policy_==overflow_policy::disconnect) {
+                            connected_=false;
+                            c_.detach(this);
+                            return false;
+                        }
+                        dropped_+=oldest-c;
+                        cursor_.store(oldest);
+                        continue;
+                    }
+                    c_.wake_publisher();
+                    return true;
+                }
+            }
+
+            // Parks while nothing new is published and the channel is open
+            struct parker : detail::park_handler {
+                parker(const broadcast_channel &c, uint64_t seen)
+                : c_(c)
+                , seen_(seen)
+                {}
+
+                virtual bool validate() override {
+                    return c_.tail_.load()==seen_ && c_.is_open();
+                }
+
+                const broadcast_channel &c_;
+                uint64_t seen_;
+            };
+
+            bool receive_until(T &v, const detail::time_point_t *deadline) {
+                for (;;) {
+                    if (take(v)) return true;
+                    if (!connected_) return false;
+                    const uint64_t c=cursor_.load(boost::memory_order_relaxed);
+                    c_.waiting_.fetch_add(1);
+                    // Pairs with the fence in wake_subscribers, either the
+                    // publisher sees us waiting or we see the new tail
+                    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+                    detail::park_result r={true, 0};
+                    const bool idle=c_.tail_.load()==c;
+                    if (idle && c_.is_open()) {
+                        parker p(c_, c);
+                        r=detail::park(&c_.tail_, p, deadline);
+                    }
+                    c_.waiting_.fetch_sub(1);
+                    if (idle && !c_.is_open() && c_.tail_.load()==c) {
+                        // Closed and everything received
+                        return false;
+                    }
+                    if (!r.unparked && deadline && boost::chrono::steady_clock::now()>=*deadline) {
+                        return take(v);
+                    }
+                }
+            }
+
+            broadcast_channel &c_;
+            boost::atomic<uint64_t> cursor_;
+            uint64_t dropped_;
+            bool connected_;
+            subscriber *next_;
+            subscriber *prev_;
+        };
+
+    private:
+        /// non-copyable, non-movable, subscribers refer to the channel
+        broadcast_channel(const broadcast_channel &)=delete;
+        void operator=(const broadcast_channel &)=delete;
+
+        struct slot {
+            detail::spinlock mtx_;
+            uint64_t seq_=0;
+            T value_;
+        };
+
+        static size_type round_up(size_type n) {
+            size_type r=2;
+            while (r<n) r<<=1;
+            return r;
+        }
+
+        void attach(subscriber *s) {
+            boost::lock_guard<detail::spinlock> lock(subs_mtx_);
+            // Starts after everything published so far
+            s->cursor_.store(tail_.load());
+            s->next_=subscribers_;
+            s->prev_=nullptr;
+            if (subscribers_) subscribers_->prev_=s;
+            subscribers_=s;
+        }
+
+        void detach(subscriber *s) {
+            {
+                boost::lock_guard<detail::spinlock> lock(subs_mtx_);
+                if (!s->next_ && !s->prev_ && subscribers_!=s) return;
+                if (s->prev_) {
+                    s->prev_->next_=s->next_;
+                } else {
+                    subscribers_=s->next_;
+                }
+                if (s->next_) s->next_->prev_=s->prev_;
+                s->next_=s->prev_=nullptr;
+            }
+            // The slowest subscriber may be gone
+            wake_publisher();
+        }
+
+        /// Cursor of the slowest subscriber, `t` if there is none
+        uint64_t min_cursor(uint64_t t) {
+            boost::lock_guard<detail::spinlock> lock(subs_mtx_);
+            uint64_t m=t;
+            for (subscriber *s=subscribers_; s; s=s->next_) {
+                const uint64_t c=s->cursor_.load();
+                if (c<m) m=c;
+            }
+            return m;
+        }
+
+        // Parks while the slowest subscriber is a whole ring behind `t`
+        struct publisher_parker : detail::park_handler {
+            publisher_parker(broadcast_channel &c, uint64_t t)
+            : c_(c)
+            , t_(t)
+            {}
+
+            virtual bool validate() override {
+                return c_.publisher_parked_.load()
+                    && c_.is_open()
+                    && t_-c_.min_cursor(t_)>c_.mask_;
+            }
+
+            broadcast_channel &c_;
+            uint64_t t_;
+        };
+
+        /**
+         * Waits until the slot for position `t` has been read by everybody,
+         * returns false if the channel has been closed
+         */
+        bool wait_for_room(uint64_t t) {
+            for (;;) {
+                cached_min_=min_cursor(t);
+                if (t-cached_min_<=mask_) return true;
+                if (closed_.load()) return false;
+                publisher_parked_.store(true);
+                // Subscribers store their cursor before checking the flag
+                cached_min_=min_cursor(t);
+                if (t-cached_min_<=mask_) {
+                    publisher_parked_.store(false);
+                    return true;
+                }
+                publisher_parker p(*this, t);
+                detail::park(&publisher_parked_, p);
+                publisher_parked_.store(false);
+            }
+        }
+
+        void wake_subscribers() {
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            if (waiting_.load(boost::memory_order_relaxed)) {
+                detail::unpark_all(&tail_);
+            }
+        }
+
+        void wake_publisher() {
+            if (publisher_parked_.load() && publisher_parked_.exchange(false)) {
+                detail::unpark_all(&publisher_parked_);
+            }
+        }
+
+        const size_type mask_;
+        std::unique_ptr<slot[]> slots_;
+        const overflow_policy policy_;
+        char padding0_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        boost::atomic<uint64_t> tail_;
+        boost::atomic<bool> closed_;
+        boost::atomic<size_t> waiting_;
+        char padding1_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        hybrid_mutex publish_mtx_;
+        boost::atomic<bool> publisher_parked_;
+        detail::spinlock subs_mtx_;
+        subscriber *subscribers_;
+        uint64_t cached_min_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -13,15 +13,235 @@
 
 #include <deque>
 #include <queue>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <boost/atomic.hpp>
 #include <boost/green_thread/mutex.hpp>
 #include <boost/green_thread/condition_variable.hpp>
+#include <boost/green_thread/atomic_wait.hpp>
+#include <boost/green_thread/detail/select_state.hpp>
 
 namespace boost { namespace green_thread {
+    namespace detail {
+        // Minimal range-based for loop support, pops until the queue is closed and empty
+        template<typename Queue>
+        struct concurrent_queue_iterator : std::iterator<std::input_iterator_tag, typename Queue::value_type> {
+            typedef typename Queue::value_type value_type;
+            
+            concurrent_queue_iterator()
+            : queue_(0)
+            , popped_(false)
+            {}
+            
+            concurrent_queue_iterator(Queue *queue)
+            : queue_(queue)
+            , popped_(false)
+            {
+                operator++();
+            }
+            
+            concurrent_queue_iterator(concurrent_queue_iterator &&other)
+            : queue_(other.queue_)
+            , value_(std::move(other.value_))
+            , popped_(other.popped_)
+            {}
+
+            concurrent_queue_iterator(const concurrent_queue_iterator &other)=delete;
+            concurrent_queue_iterator &operator=(const concurrent_queue_iterator &other)=delete;
+            
+            bool operator!=(const concurrent_queue_iterator &other) const {
+                // Only ended iterators are equal
+                return !(ended() && other.ended());
+            }
+            
+            concurrent_queue_iterator &operator++() {
+                popped_=queue_->pop(value_);
+                if(!popped_)
+                    queue_=0;
+                return *this;
+            }
+            
+            value_type &operator*() {
+                return value_;
+            }
+            
+            value_type *operator->() {
+                return &value_;
+            }
+            
+            bool ended() const {
+                return !queue_;
+            }
+            
+            Queue *queue_;
+            value_type value_;
+            bool popped_;
+        };
+        
+        // Wakes at most n threads waiting on cv, with a single notification
+        // if the condition variable supports it
+        template<typename CVType>
+        inline auto notify_n(CVType &cv, size_t n, int) -> decltype(cv.notify_n(n), void()) {
+            cv.notify_n(n);
+        }
+        
+        template<typename CVType>
+        inline void notify_n(CVType &cv, size_t n, long) {
+            for (; n>0; n--) cv.notify_one();
+        }
+        
+        template<typename CVType>
+        inline void notify_n(CVType &cv, size_t n) {
+            notify_n(cv, n, 0);
+        }
+    }   // End of namespace boost::green_thread::detail
+    
+    /**
+     * Binary heap ordered by `Compare`, elements of equal priority keep their
+     * FIFO order
+     *
+     * Used as the container of `basic_concurrent_queue`, the element for
+     * which `Compare` is false against all others is popped first, i.e.
+     * the largest one with `std::less`.
+     */
+    template<typename T, typename Compare=std::less<T>>
+    class priority_buffer {
+        struct entry {
+            T value_;
+            uint64_t seq_;
+        };
+        
+    public:
+        typedef std::vector<entry> container_type;
+        typedef T value_type;
+        typedef typename container_type::size_type size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+        
+        explicit priority_buffer(const Compare &comp=Compare())
+        : comp_(comp)
+        {}
+        
+        bool empty() const {
+            return c_.empty();
+        }
+        
+        size_type size() const {
+            return c_.size();
+        }
+        
+        /// the element with the highest priority
+        reference front() {
+            return c_.front().value_;
+        }
+        
+        const_reference front() const {
+            return c_.front().value_;
+        }
+        
+        void push(const T &v) {
+            c_.push_back(entry{v, seq_++});
+            sift_up(c_.size()-1);
+        }
+        
+        void push(T &&v) {
+            c_.push_back(entry{std::move(v), seq_++});
+            sift_up(c_.size()-1);
+        }
+        
+        /// removes the front element, which may have been moved from
+        void pop() {
+            if (c_.size()>1) {
+                // The moved-from front is overwritten before any comparison
+                c_.front()=std::move(c_.back());
+                c_.pop_back();
+                sift_down(0);
+            } else {
+                c_.pop_back();
+            }
+        }
+        
+    private:
+        // True if `a` should be popped after `b`
+        bool after(const entry &a, const entry &b) const {
+            if (comp_(a.value_, b.value_)) return true;
+            if (comp_(b.value_, a.value_)) return false;
+            return a.seq_>b.seq_;
+        }
+        
+        void sift_up(size_type i) {
+            while (i>0) {
+                const size_type parent=(i-1)/2;
+                if (!after(c_[parent], c_[i])) break;
+                std::swap(c_[parent], c_[i]);
+                i=parent;
+            }
+        }
+        
+        void sift_down(size_type i) {
+            const size_type n=c_.size();
+            for (;;) {
+                size_type first=i;
+                const size_type l=2*i+1;
+                const size_type r=l+1;
+                if (l<n && after(c_[first], c_[l])) first=l;
+                if (r<n && after(c_[first], c_[r])) first=r;
+                if (first==i) break;
+                std::swap(c_[first], c_[i]);
+                i=first;
+            }
+        }
+        
+        container_type c_;
+        uint64_t seq_=0;
+        Compare comp_;
+    };
+    
+    namespace detail {
+        // The queue interface over a container, heaps are used directly
+        template<typename T, typename Container>
+        struct queue_adapter {
+            typedef std::queue<T, Container> type;
+        };
+        
+        template<typename T, typename Compare>
+        struct queue_adapter<T, priority_buffer<T, Compare>> {
+            typedef priority_buffer<T, Compare> type;
+        };
+    }   // End of namespace boost::green_thread::detail
+    
+    namespace detail {
+        // Whether the front element can be taken without waiting, a
+        // container may hold elements which aren't ready yet
+        template<typename Q>
+        auto queue_ready(const Q &q, int) -> decltype(q.ready()) {
+            return q.ready();
+        }
+        
+        template<typename Q>
+        bool queue_ready(const Q &q, long) {
+            return !q.empty();
+        }
+        
+        // Lets such a container call `f` once more elements are ready
+        template<typename Q, typename F>
+        auto watch_ready(Q &q, F &&f, int) -> decltype(q.on_ready(std::forward<F>(f))) {
+            return q.on_ready(std::forward<F>(f));
+        }
+        
+        template<typename Q, typename F>
+        void watch_ready(Q &, F &&, long) {}
+    }   // End of namespace boost::green_thread::detail
+    
     template<typename T, typename LockType, typename CVType, typename Container = std::deque<T>>
     struct basic_concurrent_queue {
         typedef basic_concurrent_queue<T, LockType, CVType, Container> this_type;
-        typedef std::queue<T, Container> queue_type;
+        typedef typename detail::queue_adapter<T, Container>::type queue_type;
         typedef typename LockType::mutex_type mutex_type;
         
         typedef typename queue_type::container_type container_type;
@@ -33,7 +253,19 @@ namespace boost { namespace green_thread {
         inline explicit basic_concurrent_queue(size_type capacity=size_type(-1), bool auto_open=true)
         : opened_(auto_open)
         , capacity_(capacity)
-        {}
+        {
+            watch_container();
+        }
+        
+        /// constructs the container with `args`, e.g. a comparator or spill options
+        template<typename... Args>
+        inline basic_concurrent_queue(size_type capacity, bool auto_open, Args&&... args)
+        : opened_(auto_open)
+        , capacity_(capacity)
+        , the_queue_(std::forward<Args>(args)...)
+        {
+            watch_container();
+        }
         
         inline bool open() {
             LockType lock(the_mutex_);
@@ -46,6 +278,7 @@ namespace boost { namespace green_thread {
             opened_=false;
             full_cv_.notify_all();
             empty_cv_.notify_all();
+            observers_.signal(detail::select_observer::READABLE|detail::select_observer::WRITABLE);
         }
         
         inline bool is_open() const {
@@ -69,7 +302,7 @@ namespace boost { namespace green_thread {
                 return false;
             }
             the_queue_.push(data);
-            empty_cv_.notify_one();
+            items_pushed(1);
             return true;
         }
         
@@ -89,7 +322,7 @@ namespace boost { namespace green_thread {
                 return false;
             }
             the_queue_.push(std::move(data));
-            empty_cv_.notify_one();
+            items_pushed(1);
             return true;
         }
         
@@ -108,10 +341,11 @@ namespace boost { namespace green_thread {
                 // Cannot push into a closed queue
                 return first;
             }
-            for( ; first!=last && the_queue_.size()<capacity_; ++first) {
+            size_type n=0;
+            for( ; first!=last && the_queue_.size()<capacity_; ++first, ++n) {
                 the_queue_.push(*first);
-                empty_cv_.notify_one();
             }
+            items_pushed(n);
             return first;
         }
         
@@ -122,14 +356,50 @@ namespace boost { namespace green_thread {
                 // Cannot push into a closed queue
                 return false;
             }
-            while(first!=last) {
+            size_type n=0;
+            for( ; first!=last; ++first, ++n) {
                 the_queue_.push(*first);
-                empty_cv_.notify_one();
-                ++first;
             }
+            items_pushed(n);
             return true;
         }
         
+        /**
+         * Pushes all items of `range`, blocks while the queue is full
+         *
+         * Items are pushed in as few lock acquisitions as the capacity
+         * allows, and each batch wakes at most as many consumers as it has
+         * items. Returns the number of items pushed, which is less than the
+         * size of the range only if the queue has been closed.
+         */
+        template<typename Range>
+        inline size_type push_bulk(const Range &range) {
+            using std::begin;
+            using std::end;
+            auto first=begin(range);
+            auto last=end(range);
+            size_type pushed=0;
+            LockType lock(the_mutex_);
+            while (first!=last) {
+                // Wait until queue is closed or not full
+                while((the_queue_.size()>=capacity_) && opened_)
+                {
+                    full_cv_.wait(lock);
+                }
+                if (!opened_) {
+                    // Queue closed
+                    break;
+                }
+                size_type n=0;
+                for( ; first!=last && the_queue_.size()<capacity_; ++first, ++n) {
+                    the_queue_.push(*first);
+                }
+                pushed+=n;
+                items_pushed(n);
+            }
+            return pushed;
+        }
+        
         inline bool try_push(const T &data) {
             LockType lock(the_mutex_);
             if (!opened_) {
@@ -142,7 +412,7 @@ namespace boost { namespace green_thread {
                 return false;
             }
             the_queue_.push(std::move(data));
-            empty_cv_.notify_one();
+            items_pushed(1);
             return true;
         }
         
@@ -158,7 +428,7 @@ namespace boost { namespace green_thread {
                 return false;
             }
             the_queue_.push(std::move(data));
-            empty_cv_.notify_one();
+            items_pushed(1);
             return true;
         }
 
@@ -170,21 +440,21 @@ namespace boost { namespace green_thread {
                 return false;
             }
             // Wait until queue is closed or not full
-            boost::cv_status ret=cv_status::no_timeout;
             while((the_queue_.size()>=capacity_) && opened_)
             {
-                ret=full_cv_.wait_for(lock, timeout_duration);
+                if (full_cv_.wait_for(lock, timeout_duration)==cv_status::timeout) break;
             }
             if (!opened_) {
                 // Queue closed
                 return false;
             }
-            if (ret==cv_status::no_timeout) {
-                the_queue_.push(std::move(data));
-                empty_cv_.notify_one();
-                return true;
+            if (the_queue_.size()>=capacity_) {
+                // Timed out
+                return false;
             }
-            return false;
+            the_queue_.push(std::move(data));
+            items_pushed(1);
+            return true;
         }
 
         template<class Rep, class Period>
@@ -195,21 +465,21 @@ namespace boost { namespace green_thread {
                 return false;
             }
             // Wait until queue is closed or not full
-            boost::cv_status ret=cv_status::no_timeout;
             while((the_queue_.size()>=capacity_) && opened_)
             {
-                ret=full_cv_.wait_for(lock, timeout_duration);
+                if (full_cv_.wait_for(lock, timeout_duration)==cv_status::timeout) break;
             }
             if (!opened_) {
                 // Queue closed
                 return false;
             }
-            if (ret==cv_status::no_timeout) {
-                the_queue_.push(std::move(data));
-                empty_cv_.notify_one();
-                return true;
+            if (the_queue_.size()>=capacity_) {
+                // Timed out
+                return false;
             }
-            return false;
+            the_queue_.push(std::move(data));
+            items_pushed(1);
+            return true;
         }
         
         template< class Clock, class Duration >
@@ -220,21 +490,21 @@ namespace boost { namespace green_thread {
                 return false;
             }
             // Wait until queue is closed or not full
-            boost::cv_status ret=cv_status::no_timeout;
             while((the_queue_.size()>=capacity_) && opened_)
             {
-                ret=full_cv_.wait_until(lock, timeout_time);
+                if (full_cv_.wait_until(lock, timeout_time)==cv_status::timeout) break;
             }
             if (!opened_) {
                 // Queue closed
                 return false;
             }
-            if (ret==cv_status::no_timeout) {
-                the_queue_.push(std::move(data));
-                empty_cv_.notify_one();
-                return true;
+            if (the_queue_.size()>=capacity_) {
+                // Timed out
+                return false;
             }
-            return false;
+            the_queue_.push(std::move(data));
+            items_pushed(1);
+            return true;
         }
         
         template< class Clock, class Duration >
@@ -245,51 +515,51 @@ namespace boost { namespace green_thread {
                 return false;
             }
             // Wait until queue is closed or not full
-            boost::cv_status ret=cv_status::no_timeout;
             while((the_queue_.size()>=capacity_) && opened_)
             {
-                ret=full_cv_.wait_for(lock, timeout_time);
+                if (full_cv_.wait_until(lock, timeout_time)==cv_status::timeout) break;
             }
             if (!opened_) {
                 // Queue closed
                 return false;
             }
-            if (ret==cv_status::no_timeout) {
-                the_queue_.push(std::move(data));
-                empty_cv_.notify_one();
-                return true;
+            if (the_queue_.size()>=capacity_) {
+                // Timed out
+                return false;
             }
-            return false;
+            the_queue_.push(std::move(data));
+            items_pushed(1);
+            return true;
         }
         
         inline bool pop(T &popped_value) {
             LockType lock(the_mutex_);
             // Wait only if the queue is open and empty
-            while(the_queue_.empty() && opened_)
+            while(must_wait())
             {
                 empty_cv_.wait(lock);
             }
-            if (the_queue_.empty()) {
+            if (!ready()) {
                 // Last loop ensure queue will not empty only if queue is closed
                 // So here we have an empty and closed queue
                 return false;
             }
             std::swap(popped_value, the_queue_.front());
             the_queue_.pop();
-            full_cv_.notify_one();
+            items_popped(1);
             return true;
         }
         
         inline bool try_pop(T& popped_value)
         {
             LockType lock(the_mutex_);
-            if(the_queue_.empty())
+            if(!ready())
             {
                 return false;
             }
             std::swap(popped_value, the_queue_.front());
             the_queue_.pop();
-            full_cv_.notify_one();
+            items_popped(1);
             return true;
         }
         
@@ -297,66 +567,83 @@ namespace boost { namespace green_thread {
         inline bool try_pop_for(T &popped_value, const boost::chrono::duration<Rep,Period>& timeout_duration) {
             LockType lock(the_mutex_);
             // Wait only if the queue is open and empty
-            boost::cv_status ret=cv_status::no_timeout;
-            while(the_queue_.empty() && opened_)
+            while(must_wait())
             {
-                ret=empty_cv_.wait_for(lock, timeout_duration);
+                if (empty_cv_.wait_for(lock, timeout_duration)==cv_status::timeout) break;
             }
-            if (the_queue_.empty()) {
-                // Last loop ensure queue will not empty only if queue is closed
-                // So here we have an empty and closed queue
+            if (!ready()) {
+                // Timed out, or the queue is empty and closed
                 return false;
             }
-            if (ret==cv_status::no_timeout) {
-                std::swap(popped_value, the_queue_.front());
-                the_queue_.pop();
-                full_cv_.notify_one();
-                return true;
-            }
-            return false;
+            std::swap(popped_value, the_queue_.front());
+            the_queue_.pop();
+            items_popped(1);
+            return true;
         }
         
         template< class Clock, class Duration >
         bool try_pop_until(T &popped_value, const boost::chrono::time_point<Clock,Duration>& timeout_time ) {
             LockType lock(the_mutex_);
             // Wait only if the queue is open and empty
-            boost::cv_status ret=cv_status::no_timeout;
-            while(the_queue_.empty() && opened_)
+            while(must_wait())
             {
-                ret=empty_cv_.wait_until(lock, timeout_time);
+                if (empty_cv_.wait_until(lock, timeout_time)==cv_status::timeout) break;
             }
-            if (the_queue_.empty()) {
-                // Last loop ensure queue will not empty only if queue is closed
-                // So here we have an empty and closed queue
+            if (!ready()) {
+                // Timed out, or the queue is empty and closed
                 return false;
             }
-            if (ret==cv_status::no_timeout) {
-                std::swap(popped_value, the_queue_.front());
-                the_queue_.pop();
-                full_cv_.notify_one();
-                return true;
-            }
-            return false;
+            std::swap(popped_value, the_queue_.front());
+            the_queue_.pop();
+            items_popped(1);
+            return true;
         }
 
-        // Pop at most nelem items
+        // Pop at most nelem items without blocking
         template<typename OutIterator>
         inline OutIterator pop_some(OutIterator oi, size_type nelem=size_type(-1))
         {
             LockType lock(the_mutex_);
-            if(the_queue_.empty())
+            return drain(oi, nelem);
+        }
+        
+        /**
+         * Blocks until at least one item is available, then pops up to
+         * `nelem` items in one lock acquisition
+         *
+         * Returns the advanced output iterator, `oi` is returned untouched
+         * only if the queue has been closed and is empty.
+         */
+        template<typename OutIterator>
+        inline OutIterator pop_bulk(OutIterator oi, size_type nelem) {
+            LockType lock(the_mutex_);
+            // Wait only if the queue is open and empty
+            while(must_wait())
             {
-                return false;
+                empty_cv_.wait(lock);
             }
-            nelem=std::min(the_queue_.size(), nelem);
-            size_type i=0;
-            for(; i<nelem; i++) {
-                std::swap(*oi, the_queue_.top());
-                the_queue_.pop();
-                oi++;
-                full_cv_.notify_one();
+            return drain(oi, nelem);
+        }
+        
+        /**
+         * Same as above, but gives up if no item becomes available within
+         * the specified timeout duration
+         */
+        template<typename OutIterator, class Rep, class Period>
+        inline OutIterator pop_bulk(OutIterator oi,
+                                    size_type nelem,
+                                    const boost::chrono::duration<Rep,Period>& timeout_duration)
+        {
+            const auto timeout_time=boost::chrono::steady_clock::now()+timeout_duration;
+            LockType lock(the_mutex_);
+            // Wait only if the queue is open and empty
+            while(must_wait())
+            {
+                if (empty_cv_.wait_until(lock, timeout_time)==cv_status::timeout) {
+                    break;
+                }
             }
-            return oi;
+            return drain(oi, nelem);
         }
         
         inline bool empty() const {
@@ -379,57 +666,460 @@ namespace boost { namespace green_thread {
         }
         
         // Minimal range-based for loop support
-        struct iterator : std::iterator<std::input_iterator_tag, T> {
-            iterator()
-            : queue_(0)
-            , popped_(false)
-            {}
-            
-            iterator(this_type *queue)
-            : queue_(queue)
-            , popped_(false)
+        typedef detail::concurrent_queue_iterator<this_type> iterator;
+        
+        iterator begin() {
+            return iterator(this);
+        }
+        
+        iterator end() const {
+            return iterator();
+        }
+        
+        // Used by selector, the observer is signaled at once if the queue is ready already
+        void add_observer(detail::select_observer *o) {
+            LockType lock(the_mutex_);
+            observers_.push_back(o);
+            const bool readable=ready() || (!opened_ && the_queue_.empty());
+            const bool writable=the_queue_.size()<capacity_ || !opened_;
+            if (((o->events_ & detail::select_observer::READABLE) && readable)
+                || ((o->events_ & detail::select_observer::WRITABLE) && writable))
             {
-                operator++();
+                o->state_->signal();
             }
-            
-            iterator(iterator &&other)
-            : queue_(other.queue_)
-            , value_(std::move(other.value_))
-            , popped_(other.popped_)
-            {}
+        }
+        
+        void remove_observer(detail::select_observer *o) {
+            LockType lock(the_mutex_);
+            observers_.erase(o);
+        }
+        
+    private:
+        // Non-copyable, non-movable
+        basic_concurrent_queue(const basic_concurrent_queue &)=delete;
+        basic_concurrent_queue(basic_concurrent_queue &&)=delete;
+        void operator=(const basic_concurrent_queue &)=delete;
+        
+        // Wakes consumers and selectors after n items are pushed, lock must be held
+        void items_pushed(size_type n) {
+            if (n==0) return;
+            detail::notify_n(empty_cv_, n);
+            if (!observers_.empty()) observers_.signal(detail::select_observer::READABLE);
+        }
+        
+        // Wakes producers and selectors after n items are popped, lock must be held
+        void items_popped(size_type n) {
+            if (n==0) return;
+            detail::notify_n(full_cv_, n);
+            if (!observers_.empty()) observers_.signal(detail::select_observer::WRITABLE);
+        }
+        
+        // Pops at most nelem items and wakes producers once, lock must be held
+        template<typename OutIterator>
+        OutIterator drain(OutIterator oi, size_type nelem) {
+            size_type n=0;
+            for( ; n<nelem && ready(); n++) {
+                *oi=std::move(the_queue_.front());
+                the_queue_.pop();
+                ++oi;
+            }
+            items_popped(n);
+            return oi;
+        }
+        
+        // The front element can be taken, lock must be held
+        bool ready() const {
+            return detail::queue_ready(the_queue_, 0);
+        }
+        
+        // Consumers wait for an element, or once closed, for the elements
+        // which aren't ready yet, lock must be held
+        bool must_wait() const {
+            return !ready() && (opened_ || !the_queue_.empty());
+        }
+        
+        // Wakes consumers when the container makes elements ready on its own
+        void watch_container() {
+            detail::watch_ready(the_queue_, [this](){
+                LockType lock(the_mutex_);
+                empty_cv_.notify_all();
+                if (!observers_.empty()) observers_.signal(detail::select_observer::READABLE);
+            }, 0);
+        }
+        
+        bool opened_;
+        const size_t capacity_;
+        mutable mutex_type the_mutex_;
+        CVType full_cv_;
+        CVType empty_cv_;
+        queue_type the_queue_;
+        detail::select_observer_list observers_;
+    };
 
-            iterator(const iterator &other)=delete;
-            iterator &operator=(const iterator &other)=delete;
-            
-            bool operator!=(const iterator &other) const {
-                // Only ended iterators are equal
-                return !(ended() && other.ended());
+    /**
+     * Bounded lock-free MPMC ring buffer
+     *
+     * Each cell carries a sequence number telling whether it is ready for
+     * the producer or the consumer of a lap, a push or a pop takes one CAS on
+     * the shared index. The top bit of the enqueue index marks the ring as
+     * closed, so a push either claims a cell before `close()` or fails. The
+     * capacity is rounded up to a power of 2. Used as
+     * the container of `basic_concurrent_queue`, e.g. `concurrent_queue<T,
+     * mpmc_ring<T>>`, copying or moving `T` must not throw.
+     */
+    template<typename T>
+    class mpmc_ring {
+    public:
+        typedef T value_type;
+        typedef size_t size_type;
+        
+        explicit mpmc_ring(size_type capacity)
+        : mask_(round_up(capacity)-1)
+        , buffer_(new cell[mask_+1])
+        , enqueue_pos_(0)
+        , dequeue_pos_(0)
+        {
+            for (size_type i=0; i<=mask_; i++) {
+                buffer_[i].seq_.store(i, boost::memory_order_relaxed);
             }
-            
-            iterator &operator++() {
-                popped_=queue_->pop(value_);
-                if(!popped_)
-                    queue_=0;
-                return *this;
+        }
+        
+        ~mpmc_ring() {
+            const size_type e=enqueue_pos_.load(boost::memory_order_relaxed) & ~CLOSED;
+            for (size_type pos=dequeue_pos_.load(boost::memory_order_relaxed); pos!=e; pos++) {
+                reinterpret_cast<T *>(&buffer_[pos & mask_].storage_)->~T();
             }
-            
-            value_type &operator*() {
-                return value_;
+        }
+        
+        /**
+         * Pushes an element, returns false if the ring is full or closed
+         */
+        template<typename U>
+        bool try_push(U &&v) {
+            cell *c;
+            size_type pos=enqueue_pos_.load(boost::memory_order_relaxed);
+            for (;;) {
+                // A failed CAS reloads the closed bit too
+                if (pos & CLOSED) return false;
+                c=&buffer_[pos & mask_];
+                const size_type seq=c->seq_.load(boost::memory_order_acquire);
+                const std::ptrdiff_t dif=std::ptrdiff_t(seq)-std::ptrdiff_t(pos);
+                if (dif==0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos+1, boost::memory_order_relaxed)) break;
+                } else if (dif<0) {
+                    // Full
+                    return false;
+                } else {
+                    pos=enqueue_pos_.load(boost::memory_order_relaxed);
+                }
             }
-            
-            value_type *operator->() {
-                return &value_;
+            new (&c->storage_) T(std::forward<U>(v));
+            c->seq_.store(pos+1, boost::memory_order_release);
+            return true;
+        }
+        
+        /**
+         * Pops an element, returns false if the ring is empty
+         */
+        bool try_pop(T &v) {
+            cell *c;
+            size_type pos=dequeue_pos_.load(boost::memory_order_relaxed);
+            for (;;) {
+                c=&buffer_[pos & mask_];
+                const size_type seq=c->seq_.load(boost::memory_order_acquire);
+                const std::ptrdiff_t dif=std::ptrdiff_t(seq)-std::ptrdiff_t(pos+1);
+                if (dif==0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos+1, boost::memory_order_relaxed)) break;
+                } else if (dif<0) {
+                    // Empty
+                    return false;
+                } else {
+                    pos=dequeue_pos_.load(boost::memory_order_relaxed);
+                }
             }
-            
-            bool ended() const {
-                return !queue_;
+            T *p=reinterpret_cast<T *>(&c->storage_);
+            v=std::move(*p);
+            p->~T();
+            c->seq_.store(pos+mask_+1, boost::memory_order_release);
+            return true;
+        }
+        
+        /**
+         * Pops an element, once closed waits for the elements of pushes
+         * which claimed a cell before closing, returns false when there are
+         * no more
+         *
+         * The waits are short, a claimed cell is filled right away.
+         */
+        bool drain(T &v) {
+            for (;;) {
+                if (try_pop(v)) return true;
+                const size_type e=enqueue_pos_.load(boost::memory_order_acquire) & ~CLOSED;
+                if (dequeue_pos_.load(boost::memory_order_acquire)==e) return false;
             }
-            
-            this_type *queue_;
-            value_type value_;
-            bool popped_;
+        }
+
+        /// Makes every following push fail
+        void close() {
+            enqueue_pos_.fetch_or(CLOSED);
+        }
+
+        void open() {
+            enqueue_pos_.fetch_and(~CLOSED);
+        }
+
+        bool closed() const {
+            return (enqueue_pos_.load() & CLOSED)!=0;
+        }
+
+        /**
+         * Number of elements, only approximate while others push or pop
+         */
+        size_type size() const {
+            const size_type d=dequeue_pos_.load(boost::memory_order_relaxed);
+            const size_type e=enqueue_pos_.load(boost::memory_order_relaxed) & ~CLOSED;
+            return e>d ? e-d : 0;
+        }
+        
+        size_type capacity() const {
+            return mask_+1;
+        }
+        
+    private:
+        mpmc_ring(const mpmc_ring &)=delete;
+        void operator=(const mpmc_ring &)=delete;
+        
+        static constexpr size_type CLOSED=~(size_type(-1)>>1);
+
+        static size_type round_up(size_type n) {
+            size_type r=2;
+            while (r<n) r<<=1;
+            return r;
+        }
+        
+        struct cell {
+            boost::atomic<size_type> seq_;
+            typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage_;
         };
         
+        const size_type mask_;
+        std::unique_ptr<cell[]> buffer_;
+        char padding0_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        boost::atomic<size_type> enqueue_pos_;
+        char padding1_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        boost::atomic<size_type> dequeue_pos_;
+        char padding2_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+    };
+    
+    /**
+     * Concurrent queue on a lock-free ring buffer
+     *
+     * Pushing and popping don't take any lock, producers and consumers only
+     * park when the ring is full or empty, and are woken through epoch
+     * counters which are only bumped when somebody is parked.
+     */
+    template<typename T, typename LockType, typename CVType>
+    struct basic_concurrent_queue<T, LockType, CVType, mpmc_ring<T>> {
+        typedef basic_concurrent_queue<T, LockType, CVType, mpmc_ring<T>> this_type;
+        typedef mpmc_ring<T> container_type;
+        typedef T value_type;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+        
+        /// Capacity used if none is given, the ring must be bounded
+        static constexpr size_type default_capacity=1024;
+        
+        inline explicit basic_concurrent_queue(size_type capacity=size_type(-1), bool auto_open=true)
+        : the_queue_(capacity==size_type(-1) ? size_type(default_capacity) : capacity)
+        , not_empty_(0)
+        , not_full_(0)
+        , empty_waiters_(0)
+        , full_waiters_(0)
+        {
+            if (!auto_open) the_queue_.close();
+        }
+        
+        inline bool open() {
+            the_queue_.open();
+            return true;
+        }
+        
+        /**
+         * Closes the queue, a push either fails or its item is popped by a
+         * consumer before it sees the queue closed and empty
+         */
+        inline void close() {
+            the_queue_.close();
+            wake_all(not_full_);
+            wake_all(not_empty_);
+        }
+        
+        inline bool is_open() const {
+            return !the_queue_.closed();
+        }
+        
+        inline bool push(const T &data) {
+            return push_until(data, nullptr);
+        }
+        
+        inline bool push(T &&data) {
+            return push_until(std::move(data), nullptr);
+        }
+        
+        // std::back_inserter support
+        inline void push_back(const T &data)
+        { push(data); }
+        
+        inline void push_back(T &&data)
+        { push(std::move(data)); }
+        
+        // Push items without blocking
+        template<typename InIterator>
+        inline InIterator push_some(InIterator first, InIterator last) {
+            size_type n=0;
+            for ( ; first!=last && the_queue_.try_push(*first); ++first, ++n) {}
+            wake_n(not_empty_, empty_waiters_, n);
+            return first;
+        }
+        
+        // Push all items, blocks while the ring is full
+        template<typename InIterator>
+        inline bool push_all(InIterator first, InIterator last) {
+            while (first!=last) {
+                first=push_some(first, last);
+                if (first==last) break;
+                // Full, park until there is room for the next item
+                if (!push(*first)) return false;
+                ++first;
+            }
+            return true;
+        }
+        
+        /**
+         * Pushes all items of `range`, blocks while the ring is full, returns
+         * the number of items pushed
+         */
+        template<typename Range>
+        inline size_type push_bulk(const Range &range) {
+            using std::begin;
+            using std::end;
+            auto first=begin(range);
+            auto last=end(range);
+            size_type pushed=0;
+            while (first!=last) {
+                auto next=push_some(first, last);
+                pushed+=std::distance(first, next);
+                first=next;
+                if (first==last) break;
+                if (!push(*first)) break;
+                ++first;
+                ++pushed;
+            }
+            return pushed;
+        }
+        
+        inline bool try_push(const T &data) {
+            return push_item(data);
+        }
+        
+        inline bool try_push(T &&data) {
+            return push_item(std::move(data));
+        }
+        
+        template<class Rep, class Period>
+        inline bool try_push_for(const T &data, const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            return try_push_until(data, boost::chrono::steady_clock::now()+timeout_duration);
+        }
+        
+        template<class Rep, class Period>
+        inline bool try_push_for(T &&data, const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            return try_push_until(std::move(data), boost::chrono::steady_clock::now()+timeout_duration);
+        }
+        
+        template< class Clock, class Duration >
+        bool try_push_until(const T &data, const boost::chrono::time_point<Clock,Duration>& timeout_time ) {
+            const detail::time_point_t deadline=to_deadline(timeout_time);
+            return push_until(data, &deadline);
+        }
+        
+        template< class Clock, class Duration >
+        bool try_push_until(T &&data, const boost::chrono::time_point<Clock,Duration>& timeout_time ) {
+            const detail::time_point_t deadline=to_deadline(timeout_time);
+            return push_until(std::move(data), &deadline);
+        }
+        
+        inline bool pop(T &popped_value) {
+            return pop_until(popped_value, nullptr);
+        }
+        
+        inline bool try_pop(T& popped_value) {
+            return pop_item(popped_value);
+        }
+        
+        template<class Rep, class Period>
+        inline bool try_pop_for(T &popped_value, const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            return try_pop_until(popped_value, boost::chrono::steady_clock::now()+timeout_duration);
+        }
+        
+        template< class Clock, class Duration >
+        bool try_pop_until(T &popped_value, const boost::chrono::time_point<Clock,Duration>& timeout_time ) {
+            const detail::time_point_t deadline=to_deadline(timeout_time);
+            return pop_until(popped_value, &deadline);
+        }
+        
+        // Pop at most nelem items without blocking
+        template<typename OutIterator>
+        inline OutIterator pop_some(OutIterator oi, size_type nelem=size_type(-1)) {
+            T v;
+            size_type n=0;
+            for ( ; n<nelem && the_queue_.try_pop(v); n++) {
+                *oi=std::move(v);
+                ++oi;
+            }
+            wake_n(not_full_, full_waiters_, n);
+            return oi;
+        }
+        
+        /**
+         * Blocks until at least one item is available, then pops up to
+         * `nelem` items, `oi` is returned untouched only if the queue has
+         * been closed and is empty
+         */
+        template<typename OutIterator>
+        inline OutIterator pop_bulk(OutIterator oi, size_type nelem) {
+            return pop_bulk_until(oi, nelem, nullptr);
+        }
+        
+        template<typename OutIterator, class Rep, class Period>
+        inline OutIterator pop_bulk(OutIterator oi,
+                                    size_type nelem,
+                                    const boost::chrono::duration<Rep,Period>& timeout_duration)
+        {
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_duration);
+            return pop_bulk_until(oi, nelem, &deadline);
+        }
+        
+        inline bool empty() const {
+            return the_queue_.size()==0;
+        }
+        
+        inline bool full() const {
+            return the_queue_.size()>=the_queue_.capacity();
+        }
+        
+        inline size_type size() const {
+            return the_queue_.size();
+        }
+        
+        inline size_type capacity() const {
+            return the_queue_.capacity();
+        }
+        
+        // Minimal range-based for loop support
+        typedef detail::concurrent_queue_iterator<this_type> iterator;
+        
         iterator begin() {
             return iterator(this);
         }
@@ -444,15 +1134,145 @@ namespace boost { namespace green_thread {
         basic_concurrent_queue(basic_concurrent_queue &&)=delete;
         void operator=(const basic_concurrent_queue &)=delete;
         
-        bool opened_;
-        const size_t capacity_;
-        mutable mutex_type the_mutex_;
-        CVType full_cv_;
-        CVType empty_cv_;
-        queue_type the_queue_;
+        template< class Clock, class Duration >
+        static detail::time_point_t to_deadline(const boost::chrono::time_point<Clock,Duration>& timeout_time) {
+            return boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_time-Clock::now());
+        }
+        
+        // Wakes one thread parked on `epoch` if there is any
+        static void wake_one(boost::atomic<unsigned> &epoch, boost::atomic<size_t> &waiters) {
+            // Pairs with the waiter count increment in park, either the
+            // parking thread sees the ring change or we see the thread
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            if (waiters.load(boost::memory_order_relaxed)==0) return;
+            epoch.fetch_add(1);
+            atomic_notify_one(epoch);
+        }
+        
+        // Wakes at most n threads parked on `epoch`
+        static void wake_n(boost::atomic<unsigned> &epoch, boost::atomic<size_t> &waiters, size_type n) {
+            if (n==0) return;
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            const size_t w=waiters.load(boost::memory_order_relaxed);
+            if (w==0) return;
+            epoch.fetch_add(1);
+            if (n>=w) {
+                atomic_notify_all(epoch);
+                return;
+            }
+            for ( ; n>0; n--) atomic_notify_one(epoch);
+        }
+        
+        static void wake_all(boost::atomic<unsigned> &epoch) {
+            epoch.fetch_add(1);
+            atomic_notify_all(epoch);
+        }
+        
+        template<typename U>
+        bool push_item(U &&data) {
+            if (!the_queue_.try_push(std::forward<U>(data))) return false;
+            wake_one(not_empty_, empty_waiters_);
+            return true;
+        }
+        
+        bool pop_item(T &popped_value) {
+            if (!the_queue_.try_pop(popped_value)) return false;
+            wake_one(not_full_, full_waiters_);
+            return true;
+        }
+        
+        /**
+         * Parks until `epoch` moves on, `retry` is called once more after the
+         * thread is registered as a waiter, returns false on timeout
+         */
+        template<typename Retry>
+        bool park(boost::atomic<unsigned> &epoch,
+                  boost::atomic<size_t> &waiters,
+                  const detail::time_point_t *deadline,
+                  Retry retry,
+                  bool &done)
+        {
+            const unsigned e=epoch.load();
+            waiters.fetch_add(1);
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            struct guard {
+                boost::atomic<size_t> &w_;
+                ~guard() { w_.fetch_sub(1); }
+            } g={waiters};
+            if ((done=retry()) || !is_open()) return true;
+            if (!deadline) {
+                atomic_wait(epoch, e);
+                return true;
+            }
+            return atomic_wait_until(epoch, e, *deadline);
+        }
+        
+        template<typename U>
+        bool push_until(U &&data, const detail::time_point_t *deadline) {
+            for (;;) {
+                if (push_item(std::forward<U>(data))) return true;
+                if (!is_open()) {
+                    // Cannot push into a closed queue
+                    return false;
+                }
+                bool done=false;
+                const bool woken=park(not_full_, full_waiters_, deadline, [&](){
+                    return push_item(std::forward<U>(data));
+                }, done);
+                if (done) return true;
+                if (!woken) return false;
+            }
+        }
+        
+        bool pop_until(T &popped_value, const detail::time_point_t *deadline) {
+            for (;;) {
+                if (pop_item(popped_value)) return true;
+                if (!is_open()) {
+                    // Closed, drain items pushed before closing
+                    if (!the_queue_.drain(popped_value)) return false;
+                    wake_one(not_full_, full_waiters_);
+                    return true;
+                }
+                bool done=false;
+                const bool woken=park(not_empty_, empty_waiters_, deadline, [&](){
+                    return pop_item(popped_value);
+                }, done);
+                if (done) return true;
+                if (!woken) return false;
+            }
+        }
+        
+        template<typename OutIterator>
+        OutIterator pop_bulk_until(OutIterator oi, size_type nelem, const detail::time_point_t *deadline) {
+            if (nelem==0) return oi;
+            T v;
+            if (!pop_until(v, deadline)) return oi;
+            *oi=std::move(v);
+            ++oi;
+            return pop_some(oi, nelem-1);
+        }
+        
+        container_type the_queue_;
+        boost::atomic<unsigned> not_empty_;
+        boost::atomic<unsigned> not_full_;
+        boost::atomic<size_t> empty_waiters_;
+        boost::atomic<size_t> full_waiters_;
     };
+    
+    template<typename T>
+    constexpr typename mpmc_ring<T>::size_type mpmc_ring<T>::CLOSED;
+
+    template<typename T, typename LockType, typename CVType>
+    constexpr typename basic_concurrent_queue<T, LockType, CVType, mpmc_ring<T>>::size_type
+    basic_concurrent_queue<T, LockType, CVType, mpmc_ring<T>>::default_capacity;
 
     template<typename T, typename Container=std::deque<T> > using concurrent_queue = basic_concurrent_queue<T, boost::unique_lock<mutex>, condition_variable, Container>;
+
+    /**
+     * Concurrent queue popping elements by priority, FIFO among equals
+     */
+    template<typename T, typename Compare=std::less<T> > using concurrent_priority_queue = concurrent_queue<T, priority_buffer<T, Compare>>;
 }}  // End of namespace boost::green_thread
 
 #endif
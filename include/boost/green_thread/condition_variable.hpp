@@ -33,6 +33,11 @@ namespace boost { namespace green_thread {
          * notifies all waiting threads
          */
         void notify_all();
+
+        /**
+         * notifies at most `n` waiting threads, the notifier yields only once
+         */
+        void notify_n(size_t n);
         
         /**
          * blocks the current thread until the condition variable is woken up
@@ -167,6 +172,13 @@ namespace boost { namespace green_thread {
         void notify_all() noexcept {
             cond_.notify_all();
         }
+
+        /**
+         * notifies at most `n` waiting threads
+         */
+        void notify_n(size_t n) noexcept {
+            cond_.notify_n(n);
+        }
         
         /**
          * blocks the current thread until the condition variable is woken up
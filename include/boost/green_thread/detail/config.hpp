@@ -28,6 +28,15 @@
 #  define BOOST_GREEN_THREAD_DECL
 #endif
 
+// Size of the cache line, used to separate data written by different workers
+#if ! defined(BOOST_GREEN_THREAD_CACHELINE_SIZE)
+#  define BOOST_GREEN_THREAD_CACHELINE_SIZE 64
+#endif
+
+// Define BOOST_GREEN_THREAD_LOCK_PROFILING to record contention statistics of
+// mutexes and condition variables, see `scheduler::lock_profile`, it changes
+// the layout of lock objects so the library and its users must agree on it
+
 //  enable automatic library variant selection  ------------------------------//
 #if !defined(BOOST_GREEN_THREAD_SOURCE) && !defined(BOOST_ALL_NO_LIB)
 #	define BOOST_LIB_NAME boost_green_thread
@@ -0,0 +1,60 @@
+//
+//  interrupt_hook.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_DETAIL_INTERRUPT_HOOK_HPP
+#define BOOST_GREEN_THREAD_DETAIL_INTERRUPT_HOOK_HPP
+
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+
+namespace boost { namespace green_thread { namespace detail {
+    /**
+     * Callback run when the thread it is attached to gets interrupted
+     *
+     * Interruption is only checked when a paused thread is resumed, hooks
+     * let a blocked thread be resumed early, e.g. by cancelling the timer or
+     * the asio operation it is waiting for.
+     */
+    class interrupt_hook {
+    public:
+        /**
+         * Called with the lock of the interrupted thread held, from any
+         * thread, so it must not block
+         */
+        virtual void on_interrupt() noexcept=0;
+
+        /// Link used by the thread
+        interrupt_hook *next_=nullptr;
+
+    protected:
+        ~interrupt_hook() {}
+    };
+
+    /**
+     * Attaches a hook to the current thread, the hook is called right away
+     * if an interruption is already pending, does nothing outside of a thread
+     */
+    BOOST_GREEN_THREAD_DECL void attach_interrupt_hook(interrupt_hook *h);
+
+    /**
+     * Detaches a hook attached by the current thread, the hook isn't running
+     * anymore once this returns
+     */
+    BOOST_GREEN_THREAD_DECL void detach_interrupt_hook(interrupt_hook *h);
+
+    /// Keeps a hook attached while in scope
+    struct scoped_interrupt_hook {
+        explicit scoped_interrupt_hook(interrupt_hook &h) : h_(h) { attach_interrupt_hook(&h_); }
+        ~scoped_interrupt_hook() { detach_interrupt_hook(&h_); }
+        interrupt_hook &h_;
+    };
+}}} // End of namespace boost::green_thread::detail
+
+#endif
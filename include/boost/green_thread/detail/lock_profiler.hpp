@@ -0,0 +1,72 @@
+//
+//  lock_profiler.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_DETAIL_LOCK_PROFILER_HPP
+#define BOOST_GREEN_THREAD_DETAIL_LOCK_PROFILER_HPP
+
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+
+namespace boost { namespace green_thread { namespace detail {
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+    /**
+     * Records an acquisition in the buffer of the calling worker thread,
+     * `wait` is the time spent waiting if `contended`
+     */
+    BOOST_GREEN_THREAD_DECL void profile_acquired(const void *lock, bool contended, duration_t wait);
+    
+    /**
+     * Records a release in the buffer of the calling worker thread
+     */
+    BOOST_GREEN_THREAD_DECL void profile_released(const void *lock, duration_t hold);
+    
+    /**
+     * Profiling hooks embedded in lock objects, must be called while the
+     * lock's internal state is protected
+     */
+    struct lock_profile_point {
+        static time_point_t now() {
+            return boost::chrono::steady_clock::now();
+        }
+        
+        void acquired(const void *lock, bool contended, time_point_t since=time_point_t()) {
+            acquired_at_=now();
+            profile_acquired(lock, contended, contended ? acquired_at_-since : duration_t::zero());
+        }
+        
+        void released(const void *lock) {
+            profile_released(lock, now()-acquired_at_);
+        }
+        
+        /// Records a shared acquisition, which doesn't count in the hold time
+        static void acquired_shared(const void *lock, bool contended, time_point_t since) {
+            profile_acquired(lock, contended, contended ? now()-since : duration_t::zero());
+        }
+        
+        /// Records a wait which doesn't take ownership, e.g. condition variables
+        static void waited(const void *lock, time_point_t since) {
+            profile_acquired(lock, true, now()-since);
+        }
+        
+        time_point_t acquired_at_;
+    };
+#else
+    struct lock_profile_point {
+        static time_point_t now() { return time_point_t(); }
+        void acquired(const void *, bool, time_point_t=time_point_t()) {}
+        void released(const void *) {}
+        static void acquired_shared(const void *, bool, time_point_t) {}
+        static void waited(const void *, time_point_t) {}
+    };
+#endif
+}}} // End of namespace boost::green_thread::detail
+
+#endif
@@ -0,0 +1,97 @@
+//
+//  parking_lot.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_DETAIL_PARKING_LOT_HPP
+#define BOOST_GREEN_THREAD_DETAIL_PARKING_LOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+
+namespace boost { namespace green_thread { namespace detail {
+    /**
+     * Callbacks of a parking thread, all of them except `interrupted` are
+     * called with the bucket of the address locked, so they must not block
+     */
+    class park_handler {
+    public:
+        /**
+         * Returns false if the thread shouldn't park, e.g. the watched value
+         * has changed
+         */
+        virtual bool validate()=0;
+        
+        /**
+         * The thread gave up waiting because of timeout or interruption,
+         * `was_last` is true if no other thread is parked on the address
+         */
+        virtual void timed_out(bool /*was_last*/) {}
+        
+        /**
+         * The thread has been unparked with `token`, but got interrupted
+         * before it could consume it
+         */
+        virtual void interrupted(uintptr_t /*token*/) {}
+        
+    protected:
+        ~park_handler() {}
+    };
+    
+    /**
+     * Callback of an unparking thread, called with the bucket of the address
+     * locked, returns the token passed to the unparked thread
+     */
+    class unpark_handler {
+    public:
+        /**
+         * `unparked` is false if no thread was parked on the address,
+         * `has_more` is true if other threads are still parked on it
+         */
+        virtual uintptr_t operator()(bool unparked, bool has_more)=0;
+        
+    protected:
+        ~unpark_handler() {}
+    };
+    
+    struct park_result {
+        /// false if validation failed or timed out
+        bool unparked;
+        /// token given by the unparking thread
+        uintptr_t token;
+    };
+    
+    /**
+     * Parks the calling thread on `addr` if `handler.validate()` returns true,
+     * until another thread unparks it or the deadline is reached
+     *
+     * Threads are kept in a fixed hash table of intrusive wait queues keyed
+     * by address, nothing is allocated per address.
+     */
+    BOOST_GREEN_THREAD_DECL park_result park(const void *addr,
+                                             park_handler &handler,
+                                             const time_point_t *deadline=nullptr);
+    
+    /**
+     * Unparks the thread parked on `addr` for the longest time
+     *
+     * @return true if a thread has been unparked
+     */
+    BOOST_GREEN_THREAD_DECL bool unpark_one(const void *addr, unpark_handler *handler=nullptr);
+    
+    /**
+     * Unparks all threads parked on `addr`
+     *
+     * @return number of threads unparked
+     */
+    BOOST_GREEN_THREAD_DECL size_t unpark_all(const void *addr, uintptr_t token=0);
+}}} // End of namespace boost::green_thread::detail
+
+#endif
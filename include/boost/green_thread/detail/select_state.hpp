@@ -0,0 +1,122 @@
+//
+//  select_state.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_DETAIL_SELECT_STATE_HPP
+#define BOOST_GREEN_THREAD_DETAIL_SELECT_STATE_HPP
+
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/detail/waiter.hpp>
+
+namespace boost { namespace green_thread { namespace detail {
+    /**
+     * Wakeup point shared by all cases of a `selector`
+     *
+     * Sources signal the state when they may have become ready, the
+     * selecting thread parks at most once per round, no matter how many
+     * sources it waits on.
+     */
+    class BOOST_GREEN_THREAD_DECL select_state {
+    public:
+        select_state();
+
+        /**
+         * Starts a new round, signals before this call are forgotten
+         */
+        void reset();
+
+        /**
+         * Marks the state as signaled and wakes the parked thread, can be
+         * called from any thread
+         */
+        void signal();
+
+        /**
+         * Parks until signaled or the deadline is reached, returns
+         * immediately if signaled since the last `reset`
+         *
+         * @return false if timed out
+         */
+        bool park(const time_point_t *deadline);
+
+    private:
+        /// non-copyable
+        select_state(const select_state&) = delete;
+        void operator=(const select_state&) = delete;
+
+        spinlock mtx_;
+        waiter *waiter_;
+        bool signaled_;
+    };
+
+    /**
+     * Interest of a selector in the readiness of a channel, linked into the
+     * channel's observer list
+     */
+    struct select_observer {
+        enum { READABLE=1, WRITABLE=2 };
+
+        select_state *state_=nullptr;
+        int events_=0;
+        select_observer *next_=nullptr;
+        select_observer *prev_=nullptr;
+    };
+
+    /**
+     * Intrusive list of observers, must be protected by the owner's lock
+     */
+    class select_observer_list {
+    public:
+        bool empty() const {
+            return !head_;
+        }
+
+        void push_back(select_observer *o) {
+            o->next_=nullptr;
+            o->prev_=tail_;
+            if (tail_) {
+                tail_->next_=o;
+            } else {
+                head_=o;
+            }
+            tail_=o;
+        }
+
+        void erase(select_observer *o) {
+            if (o->prev_) {
+                o->prev_->next_=o->next_;
+            } else {
+                head_=o->next_;
+            }
+            if (o->next_) {
+                o->next_->prev_=o->prev_;
+            } else {
+                tail_=o->prev_;
+            }
+            o->next_=o->prev_=nullptr;
+        }
+
+        /**
+         * Signals every observer interested in any of `events`
+         */
+        void signal(int events) {
+            for (select_observer *o=head_; o; o=o->next_) {
+                if (o->events_ & events) o->state_->signal();
+            }
+        }
+
+    private:
+        select_observer *head_=nullptr;
+        select_observer *tail_=nullptr;
+    };
+}}} // End of namespace boost::green_thread::detail
+
+#endif
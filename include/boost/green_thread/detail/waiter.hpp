@@ -0,0 +1,209 @@
+//
+//  waiter.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_DETAIL_WAITER_HPP
+#define BOOST_GREEN_THREAD_DETAIL_WAITER_HPP
+
+#include <memory>
+#include <cstdint>
+#include <boost/atomic.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+
+namespace boost { namespace green_thread { namespace detail {
+    /**
+     * Intrusive waiter
+     *
+     * A waiter lives on the stack of the waiting thread, it parks the calling
+     * green thread, or blocks the calling foreign thread, until another thread
+     * notifies it or the deadline is reached. Synchronization primitives link
+     * waiters into their own wait queues, so waiting doesn't allocate.
+     *
+     * Exactly one of `notify()`, the timeout and an interruption of the
+     * waiting green thread wins, the waiting thread is resumed once in any
+     * case. An interrupted wait throws `thread_interrupted`.
+     */
+    class BOOST_GREEN_THREAD_DECL waiter {
+    public:
+        /// constructor, binds the waiter to the calling thread
+        waiter();
+
+        /// destructor
+        ~waiter();
+
+        /**
+         * Sets the deadline, must be called before the waiter is visible to
+         * any notifier, and `wait()` must be called afterwards
+         */
+        void expires_at(time_point_t t);
+
+        /**
+         * Waits until notified or the deadline is reached
+         *
+         * A waiter which can't be unlinked by its owner, e.g. one pushed to a
+         * `waiter_stack`, must wait with `interruptible` false, the waiting
+         * thread then only throws `thread_interrupted` once notified or
+         * timed out.
+         *
+         * @return true if the waiter has been notified, false if timed out
+         */
+        bool wait(bool interruptible=true);
+
+        /**
+         * Wakes the waiting thread, can be called from any thread
+         *
+         * @return false if the waiter has been notified or timed out already
+         */
+        bool notify();
+
+        /**
+         * Returns true if the waiter has been notified
+         */
+        bool notified() const {
+            return state_.load(boost::memory_order_acquire)==NOTIFIED;
+        }
+
+        /// Links used by waiter_queue
+        waiter *next_=nullptr;
+        waiter *prev_=nullptr;
+        bool linked_=false;
+
+    private:
+        /// non-copyable
+        waiter(const waiter&) = delete;
+        void operator=(const waiter&) = delete;
+
+        void timeout_handler(boost::system::error_code ec);
+        void interrupt();
+
+        struct interrupter;
+        enum { WAITING, NOTIFYING, NOTIFIED, TIMEOUT, INTERRUPTING };
+        boost::atomic<int> state_;
+        thread_ptr_t thread_;
+        std::unique_ptr<timer_t> timer_;
+        struct foreign_event;
+        std::unique_ptr<foreign_event> event_;
+        time_point_t deadline_;
+        bool has_deadline_=false;
+    };
+
+    /**
+     * Intrusive FIFO queue of waiters, must be protected by the owner's lock
+     */
+    class waiter_queue {
+    public:
+        bool empty() const {
+            return !head_;
+        }
+
+        waiter *front() const {
+            return head_;
+        }
+
+        void push_back(waiter *w) {
+            w->next_=nullptr;
+            w->prev_=tail_;
+            if (tail_) {
+                tail_->next_=w;
+            } else {
+                head_=w;
+            }
+            tail_=w;
+            w->linked_=true;
+        }
+
+        waiter *pop_front() {
+            waiter *w=head_;
+            if (w) erase(w);
+            return w;
+        }
+
+        void erase(waiter *w) {
+            if (w->prev_) {
+                w->prev_->next_=w->next_;
+            } else {
+                head_=w->next_;
+            }
+            if (w->next_) {
+                w->next_->prev_=w->prev_;
+            } else {
+                tail_=w->prev_;
+            }
+            w->next_=w->prev_=nullptr;
+            w->linked_=false;
+        }
+
+    private:
+        waiter *head_=nullptr;
+        waiter *tail_=nullptr;
+    };
+
+    /**
+     * Lock-free stack of waiters, waiters are only pushed one by one and
+     * taken all at once, so there is no ABA problem
+     */
+    class waiter_stack {
+    public:
+        waiter_stack()
+        : head_(nullptr)
+        {}
+
+        /**
+         * Pushes a waiter, returns false if the stack has been closed
+         */
+        bool push(waiter *w) {
+            // Acquire so a closed stack also publishes what happened before `close`
+            waiter *h=head_.load(boost::memory_order_acquire);
+            do {
+                if (h==closed()) return false;
+                w->next_=h;
+            } while (!head_.compare_exchange_weak(h, w, boost::memory_order_release, boost::memory_order_acquire));
+            return true;
+        }
+
+        /**
+         * Takes all waiters
+         */
+        waiter *take_all() {
+            return head_.exchange(nullptr, boost::memory_order_acquire);
+        }
+
+        /**
+         * Takes all waiters and rejects further pushes
+         */
+        waiter *close() {
+            waiter *h=head_.exchange(closed(), boost::memory_order_acquire);
+            return h==closed() ? nullptr : h;
+        }
+
+        /**
+         * Notifies every waiter in a list returned by `take_all` or `close`,
+         * except `self`
+         */
+        static void notify_all(waiter *w, const waiter *self=nullptr) {
+            while (w) {
+                // The waiter may be gone once notified
+                waiter *next=w->next_;
+                if (w!=self) w->notify();
+                w=next;
+            }
+        }
+
+    private:
+        static waiter *closed() {
+            return reinterpret_cast<waiter *>(uintptr_t(1));
+        }
+
+        boost::atomic<waiter *> head_;
+    };
+}}} // End of namespace boost::green_thread::detail
+
+#endif
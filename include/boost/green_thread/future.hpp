@@ -1,5 +1,9 @@
 #include <boost/green_thread/future/future_status.hpp>
 #include <boost/green_thread/future/future.hpp>
+#include <boost/green_thread/future/executor.hpp>
 #include <boost/green_thread/future/packaged_task.hpp>
 #include <boost/green_thread/future/promise.hpp>
 #include <boost/green_thread/future/async.hpp>
+#include <boost/green_thread/future/work_stealing_executor.hpp>
+#include <boost/green_thread/future/when_all.hpp>
+#include <boost/green_thread/future/race.hpp>
@@ -20,10 +20,32 @@
 #include <boost/green_thread/thread_group.hpp>
 #include <boost/green_thread/future/future.hpp>
 #include <boost/green_thread/future/packaged_task.hpp>
+#include <boost/green_thread/future/executor.hpp>
 #include <boost/green_thread/concurrent_queue.hpp>
+#include <boost/green_thread/mailbox.hpp>
 
 namespace boost { namespace green_thread {
+    /**
+     * How `async` runs the function
+     */
+    enum class launch {
+        /// In a new thread, the default
+        new_thread,
+        /// In the first thread waiting for the result, or registering a continuation on it
+        deferred,
+        /// Right away in the calling thread, or as `pool` past `inline_executor::max_depth` nested calls
+        inline_if_ready,
+        /// In a thread recycled from a pool of the scheduler
+        pool,
+    };
+    
     namespace detail {
+        /// Runs `task` on a pool thread of the current scheduler, takes ownership
+        BOOST_GREEN_THREAD_DECL void post_to_pool(thread_data_base *task);
+        
+        /// Number of worker threads of the scheduler `post_to_pool` uses
+        BOOST_GREEN_THREAD_DECL size_t pool_concurrency();
+        
         template<typename Fn, class... Args>
         struct task_data {
             typedef std::tuple<typename std::decay<Fn>::type, typename std::decay<Args>::type...> data_type;
@@ -49,7 +71,9 @@ namespace boost { namespace green_thread {
     /**
      * Run function asynchronously, returns a future, which will be ready when function completes
      */
-    template<typename Fn, typename ...Args>
+    template<typename Fn, typename ...Args,
+        class = typename std::enable_if<!std::is_same<typename std::decay<Fn>::type, launch>::value>::type
+    >
     typename detail::task_data<Fn, Args...>::future_type
     async(Fn &&fn, Args&&... args) {
         typedef detail::task_data<Fn, Args...> data_type;
@@ -59,6 +83,60 @@ namespace boost { namespace green_thread {
         return std::move(ret);
     }
     
+    /**
+     * Run function according to `policy`, returns a future
+     *
+     * `launch::pool` skips creating a thread for each call, it suits short
+     * functions best. Pool threads are reused as they are, a function
+     * leaving thread specific data or a thread name behind leaves them to
+     * the next one.
+     */
+    template<typename Fn, typename ...Args>
+    typename detail::task_data<Fn, Args...>::future_type
+    async(launch policy, Fn &&fn, Args&&... args) {
+        typedef detail::task_data<Fn, Args...> data_type;
+        typedef typename data_type::result_type result_type;
+        typedef typename data_type::task_type task_type;
+        switch (policy) {
+            case launch::new_thread:
+                break;
+            case launch::deferred: {
+                typedef detail::task_object<data_type, pool_allocator<void>, result_type> object_t;
+                typedef detail::task_base<result_type> base_t;
+                typedef typename object_t::allocator_t allocator_t;
+                allocator_t a;
+                // Gives the block back if constructing the state throws
+                struct guard {
+                    ~guard() { if (p_) a_.deallocate(p_, 1); }
+                    allocator_t &a_;
+                    object_t *p_;
+                } g{a, a.allocate(1)};
+                ::new(g.p_) object_t(data_type(std::forward<Fn>(fn), std::forward<Args>(args)...), a);
+                typename base_t::ptr_t state(g.p_);
+                g.p_=nullptr;
+                state->set_deferred([](detail::shared_state_base *s){
+                    static_cast<base_t *>(s)->run();
+                });
+                return detail::future_access::make<result_type>(state);
+            }
+            case launch::inline_if_ready:
+                if (detail::continuation_depth()<inline_executor::max_depth) {
+                    task_type task(data_type(std::forward<Fn>(fn), std::forward<Args>(args)...));
+                    typename data_type::future_type ret(task.get_future());
+                    inline_executor().post(std::move(task));
+                    return ret;
+                }
+                // Fall through
+            case launch::pool: {
+                task_type task(data_type(std::forward<Fn>(fn), std::forward<Args>(args)...));
+                typename data_type::future_type ret(task.get_future());
+                detail::post_to_pool(detail::make_thread_data(std::move(task)));
+                return ret;
+            }
+        }
+        return async(std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+    
     /**
      * Run function asynchronously in a thread pool, returns a future
      */
@@ -103,11 +181,11 @@ namespace boost { namespace green_thread {
         
         async_function(Fn &&fn)
         : fn_(std::forward<Fn>(fn))
-        , queue_(new concurrent_queue<queue_element>)
+        , mailbox_(new mailbox<async_function_args>)
         , thread_(&async_function::execute, this)
         {}
         async_function(async_function &&)=default;
-        ~async_function() { queue_->close(); thread_.join(); }
+        ~async_function() { mailbox_->close(); thread_.join(); }
         
         template<typename ...Args>
         future<result_type> operator()(Args&&... args)
@@ -117,16 +195,20 @@ namespace boost { namespace green_thread {
         { return async_call(std::forward<arguments_tuple>(args)); }
 
     private:
-        struct async_function_args{
+        // Arguments and the promise travel in one allocation, linked into the mailbox directly
+        struct async_function_args : mailbox_node {
+            async_function_args(arguments_tuple &&a)
+            : args(std::forward<arguments_tuple>(a))
+            {}
             arguments_tuple args;
             promise<result_type> ret;
         };
         typedef std::unique_ptr<async_function_args> queue_element;
         
         future<result_type> async_call(arguments_tuple &&args) {
-            queue_element e(new async_function_args{std::forward<arguments_tuple>(args), promise<result_type>()});
+            queue_element e(new async_function_args(std::forward<arguments_tuple>(args)));
             future<result_type> ret(e->ret.get_future());
-            queue_->push(std::move(e));
+            mailbox_->push(std::move(e));
             return ret;
         }
         
@@ -139,10 +221,10 @@ namespace boost { namespace green_thread {
             args->ret.set_value(call2(std::move(args->args), index_type()));
         }
         
-        void execute() { for(auto &e : *queue_) call(std::move(e)); }
+        void execute() { while(queue_element e=mailbox_->pop()) call(std::move(e)); }
         
         Fn fn_;
-        std::unique_ptr<concurrent_queue<queue_element>> queue_;
+        std::unique_ptr<mailbox<async_function_args>> mailbox_;
         thread thread_;
     };
     
@@ -195,6 +277,15 @@ namespace boost { namespace green_thread {
             return async_call(std::forward<Fn>(fn), std::forward<Args>(args)...).get();
         }
         
+        /**
+         * Runs `fn` in the pool without a future, so the pool can be used
+         * as an executor for `future::then`
+         */
+        template<typename Fn>
+        void post(Fn &&fn) {
+            queue_.push(task_type(std::forward<Fn>(fn)));
+        }
+        
     private:
         typedef std::function<void()> task_type;
         typedef basic_concurrent_queue<task_type, boost::unique_lock<boost::mutex>, boost::condition_variable> queue_type;
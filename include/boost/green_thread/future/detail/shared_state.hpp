@@ -12,6 +12,9 @@
 #ifndef BOOST_GREEN_THREAD_FUTURE_DETAIL_SHARED_STATE_HPP
 #define BOOST_GREEN_THREAD_FUTURE_DETAIL_SHARED_STATE_HPP
 
+#include <cstdint>
+#include <memory>
+#include <type_traits>
 #include <boost/assert.hpp>
 #include <boost/atomic.hpp>
 #include <boost/config.hpp>
@@ -23,660 +26,425 @@
 #include <boost/chrono/system_clocks.hpp>
 
 #include <boost/green_thread/future/future_status.hpp>
-#include <boost/green_thread/condition_variable.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
 #include <boost/green_thread/exceptions.hpp>
-#include <boost/green_thread/mutex.hpp>
+#include <boost/green_thread/pool_allocator.hpp>
 
 namespace boost { namespace green_thread {
     typedef boost::chrono::steady_clock clock_type;
 }}  // End of namespace boost::green_thread
 
 namespace boost { namespace green_thread { namespace detail {
-    template<typename Lockable>
-    struct relock_guard {
-        inline relock_guard(Lockable &mtx)
-        : mtx_(mtx)
-        { mtx_.unlock(); }
-        
-        inline ~relock_guard()
-        { mtx_.lock(); }
-        
-        Lockable &mtx_;
-    };
-
-    template< typename R >
-    class shared_state : public boost::noncopyable
+    /**
+     * The part of the shared state which doesn't depend on the value type
+     *
+     * The whole state machine lives in one atomic word: the low bits tell
+     * whether a result is being stored, is ready and is an exception, and
+     * whether threads are parked on the state, the rest points to a lock-free
+     * stack of callbacks registered before the result was ready. Storing a
+     * result is one CAS to claim the state and one exchange to publish it,
+     * waiting threads are only unparked if one of them has set the parked
+     * bit, callbacks are run by the thread storing the result.
+     *
+     * A deferred state computes its result on the first thread which waits
+     * for it or registers a callback, timed waits don't run it and report
+     * `future_status::deferred` instead.
+     */
+    class shared_state_base : public boost::noncopyable
     {
-    private:
-        boost::atomic< std::size_t >   use_count_;
-        mutable mutex                  mtx_;
-        mutable condition_variable     waiters_;
-        boost::atomic<bool>            ready_;
-        boost::optional< R >           value_;
-        std::exception_ptr           except_;
-        typedef std::function<void()>  external_waiter;
-        std::vector<external_waiter>   ext_waiters_;
-        
-        void mark_ready_and_notify_()
-        {
-            ready_ = true;
-            waiters_.notify_all();
-            for(auto &w: ext_waiters_) {
-                relock_guard<mutex> g(mtx_);
-                w();
+    public:
+        /**
+         * Callback waiting for a state, linked into the state until it is
+         * ready
+         *
+         * Owners of many nodes, like the combinators waiting for a whole
+         * range of futures, allocate them in one block and free it on their
+         * own once every node has been invoked.
+         */
+        struct alignas(8) callback_node {
+            callback_node *next_=nullptr;
+            /// Runs the callback, the node mustn't be touched afterwards
+            virtual void invoke()=0;
+            /// Drops the callback of a state which is destroyed before being ready
+            virtual void discard()=0;
+        protected:
+            ~callback_node() {}
+        };
+
+        /// Computes the result of a deferred state
+        typedef void (*deferred_fn)(shared_state_base *);
+
+    protected:
+        enum : uintptr_t {
+            CLAIMED=1,
+            PARKED=2,
+            READY=4,
+            // Only set together with READY, when there are no callbacks anymore
+            EXCEPTION=8,
+            FLAGS=CLAIMED|PARKED|READY,
+        };
+
+        template<typename Fn>
+        struct callback final : callback_node {
+            template<typename F>
+            explicit callback(F &&fn) : fn_(std::forward<F>(fn)) {}
+
+            void invoke() override {
+                std::unique_ptr<callback> self(this);
+                fn_();
+            }
+
+            void discard() override { delete this; }
+
+            static void *operator new(std::size_t bytes)
+            { return pool_allocate(bytes); }
+
+            static void operator delete(void *p, std::size_t bytes) noexcept
+            { pool_deallocate(p, bytes); }
+
+            Fn fn_;
+        };
+
+        mutable boost::atomic<uintptr_t> state_;
+        std::exception_ptr except_;
+        // Non-null until the deferred result is being computed
+        mutable boost::atomic<deferred_fn> deferred_;
+
+        shared_state_base()
+        : state_(0)
+        , except_()
+        , deferred_(nullptr)
+        {}
+
+        ~shared_state_base()
+        {
+            // Callbacks of a state which has never been made ready
+            callback_node *n=list_of(state_.load(boost::memory_order_acquire));
+            while (n) {
+                callback_node *next=n->next_;
+                n->discard();
+                n=next;
             }
         }
-        
-        void owner_destroyed_()
+
+        static callback_node *list_of(uintptr_t s)
         {
-            //TODO: set broken_exception if future was not already done
-            //      notify all waiters
-            if (!ready_)
-                set_exception_( utility::copy_exception( broken_promise() ) );
+            return (s & READY) ? nullptr : reinterpret_cast<callback_node *>(s & ~uintptr_t(FLAGS));
         }
-        
-        void set_value_( R const& value)
+
+        /// Reserves the right to store the result, false if already done
+        bool claim()
         {
-            //TODO: store the value and make the future ready
-            //      notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied() );
-            value_ = value;
-            mark_ready_and_notify_();
+            uintptr_t s=state_.load(boost::memory_order_relaxed);
+            do {
+                if (s & (CLAIMED|READY)) return false;
+            } while (!state_.compare_exchange_weak(s, s|CLAIMED, boost::memory_order_acquire));
+            return true;
         }
-        
-        void set_value_( R && value)
+
+        void claim_or_throw()
         {
-            //TODO: store the value and make the future ready
-            //      notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied() );
-            value_ = std::move( value);
-            mark_ready_and_notify_();
+            if (!claim())
+                BOOST_THROW_EXCEPTION(promise_already_satisfied());
         }
-        
+
+        /// Gives up a claim, storing the result has failed
+        void unclaim()
+        { state_.fetch_and(~uintptr_t(CLAIMED)); }
+
+        /// Makes the claimed state ready, wakes waiters and runs callbacks
+        void publish(bool exception)
+        {
+            const uintptr_t old=state_.exchange(READY | (exception ? uintptr_t(EXCEPTION) : uintptr_t(0)), boost::memory_order_acq_rel);
+            if (old & PARKED)
+                unpark_all(this);
+            // Callbacks run in registration order
+            callback_node *n=list_of(old);
+            callback_node *rev=nullptr;
+            while (n) {
+                callback_node *next=n->next_;
+                n->next_=rev;
+                rev=n;
+                n=next;
+            }
+            while (rev) {
+                callback_node *c=rev;
+                rev=rev->next_;
+                c->invoke();
+            }
+        }
+
         void set_exception_( std::exception_ptr except)
         {
-            //TODO: store the exception pointer p into the shared state and make the state ready
-            //      done = true, notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied());
+            claim_or_throw();
             except_ = except;
-            mark_ready_and_notify_();
+            publish(true);
         }
-        
-        const R& get_( boost::unique_lock< mutex > & lk)
+
+        bool ready_() const
+        { return (state_.load(boost::memory_order_acquire) & READY) != 0; }
+
+        void rethrow_if_exception_() const
         {
-            //TODO: the get method waits until the future has a valid result and
-            //      (depending on which template is used) retrieves it
-            //      it effectively calls wait_() in order to wait for the result
-            //      if it satisfies the requirements of MoveAssignable, the value is moved,
-            //      otherwise it is copied
-            wait_(lk);
-            if (except_)
+            if (state_.load(boost::memory_order_acquire) & EXCEPTION)
                 std::rethrow_exception( except_);
-            return value_.get();
-        }
-        
-        void wait_( boost::unique_lock< mutex > & lk) const
-        {
-            //TODO: blocks until the result becomes available
-            while (!ready_)
-                waiters_.wait(lk);
         }
-        
-        template< class Rep, class Period >
-        future_status wait_for_( boost::unique_lock< mutex > & lk,
-                                boost::chrono::duration< Rep, Period > const& timeout_duration) const
+
+        /// Computes a deferred result on the calling thread, only once
+        void run_deferred_() const
         {
-            //TODO: blocks until the result becomes available or timeout
-            while ( ! ready_)
-            {
-                cv_status st( waiters_.wait_for( lk, timeout_duration) );
-                if ( cv_status::timeout == st && ! ready_)
-                    return future_status::timeout;
-            }
-            return future_status::ready;
+            if (!deferred_.load(boost::memory_order_acquire)) return;
+            if (deferred_fn fn=deferred_.exchange(nullptr, boost::memory_order_acq_rel))
+                fn(const_cast<shared_state_base *>(this));
         }
-        
-        future_status wait_until_( boost::unique_lock< mutex > & lk,
-                                  clock_type::time_point const& timeout_time) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            while ( ! ready_)
-            {
-                cv_status st( waiters_.wait_until( lk, timeout_time) );
-                if ( cv_status::timeout == st && ! ready_)
-                    return future_status::timeout;
+
+        bool is_deferred_() const
+        { return deferred_.load(boost::memory_order_acquire)!=nullptr; }
+
+        // Parks while the state isn't ready
+        struct parker : park_handler {
+            explicit parker(const boost::atomic<uintptr_t> &s) : s_(s) {}
+            bool validate() override
+            { return (s_.load() & READY) == 0; }
+            const boost::atomic<uintptr_t> &s_;
+        };
+
+        /// Blocks until ready, returns false on timeout
+        bool wait_until_( const time_point_t *deadline) const
+        {
+            if (!deadline) run_deferred_();
+            for (;;) {
+                uintptr_t s=state_.load(boost::memory_order_acquire);
+                if (s & READY) return true;
+                if (!(s & PARKED) && !state_.compare_exchange_weak(s, s|PARKED))
+                    continue;
+                parker p(state_);
+                park_result r=park(this, p, deadline);
+                if (!r.unparked && deadline && clock_type::now() >= *deadline)
+                    return ready_();
             }
-            return future_status::ready;
         }
-        
-    protected:
-        virtual void deallocate_future() = 0;
-        
+
     public:
-        typedef boost::intrusive_ptr< shared_state >    ptr_t;
-        
-        shared_state() :
-        use_count_( 0), mtx_(), ready_( false),
-        value_(), except_()
-        {}
-        
-        virtual ~shared_state() {}
-        
+        /// Calls `fn` once the state is ready, right away if it is already
         template<typename Fn>
         void add_external_waiter(Fn &&fn)
         {
-            boost::unique_lock< mutex > lk( mtx_);
-            if (ready_) {
-                relock_guard<mutex> g(mtx_);
-                fn();
-            } else {
-                ext_waiters_.emplace_back(std::forward<Fn>(fn));
-            }
-        }
-        
-        void owner_destroyed()
-        {
-            //TODO: lock mutex
-            //      set broken_exception if future was not already done
-            //      done = true, notify all waiters
-            boost::unique_lock< mutex > lk( mtx_);
-            owner_destroyed_();
+            add_callback_node(new callback<typename std::decay<Fn>::type>(std::forward<Fn>(fn)));
         }
-        
-        void set_value( R const& value)
-        {
-            //TODO: store the value into the shared state and make the state ready
-            //      the operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_value_( value);
+
+        /// Invokes `n` once the state is ready, right away if it is already
+        void add_callback_node(callback_node *n)
+        {
+            // Somebody depends on the result now
+            run_deferred_();
+            uintptr_t s=state_.load(boost::memory_order_relaxed);
+            do {
+                if (s & READY) {
+                    n->invoke();
+                    return;
+                }
+                n->next_=list_of(s);
+            } while (!state_.compare_exchange_weak(s, reinterpret_cast<uintptr_t>(n) | (s & FLAGS),
+                                                   boost::memory_order_release));
         }
-        
-        void set_value( R && value)
+
+        void owner_destroyed()
         {
-            //TODO: store the value into the shared state and make the state ready
-            //      rhe operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_value_( std::move( value) );
+            // broken_promise if the result has never been stored
+            if (claim()) {
+                except_ = utility::copy_exception( broken_promise() );
+                publish(true);
+            }
         }
-        
+
         void set_exception( std::exception_ptr except)
-        {
-            //TODO: store the exception pointer p into the shared state and make the state ready
-            //      the operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_exception_( except);
-        }
-        
-        const R& get()
-        {
-            //TODO: the get method waits until the future has a valid result and
-            //      (depending on which template is used) retrieves it
-            //      it effectively calls wait() in order to wait for the result
-            //      the value stored in the shared state
-            //      if it satisfies the requirements of MoveAssignable, the value is moved,
-            //      otherwise it is copied
-            //      valid() == false after a call to this method.
-            //      detect the case when valid == false before the call and throw a
-            //      future_error with an error condition of future_errc::no_state
-            boost::unique_lock< mutex > lk( mtx_);
-            return get_( lk);
-        }
-        
+        { set_exception_( except); }
+
         void wait() const
-        {
-            //TODO: blocks until the result becomes available
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            wait_( lk);
-        }
-        
+        { wait_until_( nullptr); }
+
+        /// Makes the state deferred, `fn` stores the result when first waited for
+        void set_deferred( deferred_fn fn)
+        { deferred_.store(fn, boost::memory_order_release); }
+
         template< class Rep, class Period >
         future_status wait_for( boost::chrono::duration< Rep, Period > const& timeout_duration) const
         {
-            //TODO: blocks until the result becomes available or timeout
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            return wait_for_( lk, timeout_duration);
+            if (is_deferred_()) return future_status::deferred;
+            const time_point_t deadline=clock_type::now()
+                +boost::chrono::duration_cast<duration_t>(timeout_duration);
+            return wait_until_( &deadline) ? future_status::ready : future_status::timeout;
         }
-        
+
         future_status wait_until( clock_type::time_point const& timeout_time) const
         {
-            //TODO: blocks until the result becomes available or timeout
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            return wait_until_( lk, timeout_time);
+            if (is_deferred_()) return future_status::deferred;
+            const time_point_t deadline=timeout_time;
+            return wait_until_( &deadline) ? future_status::ready : future_status::timeout;
         }
-        
+
         void reset()
-        { ready_ = false; }
-        
-        friend inline void intrusive_ptr_add_ref( shared_state * p) noexcept
-        { ++p->use_count_; }
-        
-        friend inline void intrusive_ptr_release( shared_state * p)
         {
-            if ( 0 == --p->use_count_)
-                p->deallocate_future();
+            // Waiters on the previous result get broken_promise, as with std::packaged_task::reset
+            owner_destroyed();
+            // The result is being stored concurrently, drop what is still waiting for it
+            const uintptr_t old=state_.exchange(0, boost::memory_order_acq_rel);
+            if (old & PARKED)
+                unpark_all(this);
+            callback_node *n=list_of(old);
+            while (n) {
+                callback_node *next=n->next_;
+                n->discard();
+                n=next;
+            }
+            except_ = std::exception_ptr();
         }
     };
-    
+
     template< typename R >
-    class shared_state< R & > : public boost::noncopyable
+    class shared_state : public shared_state_base
     {
     private:
         boost::atomic< std::size_t >   use_count_;
-        mutable mutex           mtx_;
-        mutable condition_variable       waiters_;
-        boost::atomic<bool>              ready_;
-        R                   *   value_;
-        std::exception_ptr           except_;
-        typedef std::function<void()>  external_waiter;
-        std::vector<external_waiter>   ext_waiters_;
-        
-        void mark_ready_and_notify_()
+        boost::optional< R >           value_;
+
+    protected:
+        virtual void deallocate_future() = 0;
+
+    public:
+        typedef boost::intrusive_ptr< shared_state >    ptr_t;
+
+        shared_state() :
+        use_count_( 0), value_()
+        {}
+
+        virtual ~shared_state() {}
+
+        void set_value( R const& value)
         {
-            ready_ = true;
-            waiters_.notify_all();
-            for(auto &w: ext_waiters_) {
-                relock_guard<mutex> g(mtx_);
-                w();
+            claim_or_throw();
+            try {
+                value_ = value;
+            } catch(...) {
+                unclaim();
+                throw;
             }
+            publish(false);
         }
-        
-        void owner_destroyed_()
+
+        void set_value( R && value)
         {
-            //TODO: set broken_exception if future was not already done
-            //      notify all waiters
-            if (!ready_) {
-                set_exception_( utility::copy_exception( broken_promise() ) );
+            claim_or_throw();
+            try {
+                value_ = std::move( value);
+            } catch(...) {
+                unclaim();
+                throw;
             }
+            publish(false);
         }
-        
-        void set_value_( R & value)
-        {
-            //TODO: store the value and make the future ready
-            //      notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied() );
-            value_ = & value;
-            mark_ready_and_notify_();
-        }
-        
-        void set_exception_( std::exception_ptr except)
-        {
-            //TODO: store the exception pointer p into the shared state and make the state ready
-            //      done = true, notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied() );
-            except_ = except;
-            mark_ready_and_notify_();
-        }
-        
-        R & get_( boost::unique_lock< mutex > & lk)
-        {
-            //TODO: the get method waits until the future has a valid result and
-            //      (depending on which template is used) retrieves it
-            //      it effectively calls wait_() in order to wait for the result
-            //      if it satisfies the requirements of MoveAssignable, the value is moved,
-            //      otherwise it is copied
-            wait_(lk);
-            if (except_)
-                std::rethrow_exception(except_);
-            return * value_;
-        }
-        
-        void wait_( boost::unique_lock< mutex > & lk) const
+
+        const R& get()
         {
-            //TODO: blocks until the result becomes available
-            while ( ! ready_)
-                waiters_.wait( lk);
+            wait();
+            rethrow_if_exception_();
+            return value_.get();
         }
-        
-        template< class Rep, class Period >
-        future_status wait_for_( boost::unique_lock< mutex > & lk,
-                                boost::chrono::duration< Rep, Period > const& timeout_duration) const
+
+        void reset()
         {
-            //TODO: blocks until the result becomes available or timeout
-            while ( ! ready_)
-            {
-                cv_status st( waiters_.wait_for( lk, timeout_duration) );
-                if ( cv_status::timeout == st && ! ready_)
-                    return future_status::timeout;
-            }
-            return future_status::ready;
+            shared_state_base::reset();
+            value_ = boost::none;
         }
-        
-        future_status wait_until_( boost::unique_lock< mutex > & lk,
-                                  clock_type::time_point const& timeout_time) const
+
+        friend inline void intrusive_ptr_add_ref( shared_state * p) noexcept
+        { ++p->use_count_; }
+
+        friend inline void intrusive_ptr_release( shared_state * p)
         {
-            //TODO: blocks until the result becomes available or timeout
-            while ( ! ready_)
-            {
-                cv_status st( waiters_.wait_until( lk, timeout_time) );
-                if ( cv_status::timeout == st && ! ready_)
-                    return future_status::timeout;
-            }
-            return future_status::ready;
+            if ( 0 == --p->use_count_)
+                p->deallocate_future();
         }
-        
+    };
+
+    template< typename R >
+    class shared_state< R & > : public shared_state_base
+    {
+    private:
+        boost::atomic< std::size_t >   use_count_;
+        R                   *   value_;
+
     protected:
         virtual void deallocate_future() = 0;
-        
+
     public:
         typedef boost::intrusive_ptr< shared_state >    ptr_t;
-        
+
         shared_state() :
-        use_count_( 0), mtx_(), ready_( false),
-        value_( 0), except_()
+        use_count_( 0), value_( 0)
         {}
-        
+
         virtual ~shared_state() {}
-        
-        template<typename Fn>
-        void add_external_waiter(Fn &&fn)
-        {
-            boost::unique_lock< mutex > lk( mtx_);
-            if (ready_) {
-                relock_guard<mutex> g(mtx_);
-                fn();
-            } else {
-                ext_waiters_.emplace_back(std::forward<Fn>(fn));
-            }
-        }
-        
-        void owner_destroyed()
-        {
-            //TODO: lock mutex
-            //      set broken_exception if future was not already done
-            //      done = true, notify all waiters
-            boost::unique_lock< mutex > lk( mtx_);
-            owner_destroyed_();
-        }
-        
+
         void set_value( R & value)
         {
-            //TODO: store the value into the shared state and make the state ready
-            //      the operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_value_( value);
-        }
-        
-        void set_exception( std::exception_ptr except)
-        {
-            //TODO: store the exception pointer p into the shared state and make the state ready
-            //      the operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_exception_( except);
+            claim_or_throw();
+            value_ = & value;
+            publish(false);
         }
-        
+
         R & get()
         {
-            //TODO: the get method waits until the future has a valid result and
-            //      (depending on which template is used) retrieves it
-            //      it effectively calls wait() in order to wait for the result
-            //      the value stored in the shared state
-            //      if it satisfies the requirements of MoveAssignable, the value is moved,
-            //      otherwise it is copied
-            //      valid() == false after a call to this method.
-            //      detect the case when valid == false before the call and throw a
-            //      future_error with an error condition of future_errc::no_state
-            boost::unique_lock< mutex > lk( mtx_);
-            return get_( lk);
-        }
-        
-        void wait() const
-        {
-            //TODO: blocks until the result becomes available
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            wait_( lk);
-        }
-        
-        template< class Rep, class Period >
-        future_status wait_for( boost::chrono::duration< Rep, Period > const& timeout_duration) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            return wait_for_( lk, timeout_duration);
-        }
-        
-        future_status wait_until( clock_type::time_point const& timeout_time) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            return wait_until_( lk, timeout_time);
+            wait();
+            rethrow_if_exception_();
+            return * value_;
         }
-        
-        void reset()
-        { ready_ = false; }
-        
+
         friend inline void intrusive_ptr_add_ref( shared_state * p) noexcept
         { ++p->use_count_; }
-        
+
         friend inline void intrusive_ptr_release( shared_state * p)
         {
             if ( 0 == --p->use_count_)
                 p->deallocate_future();
         }
     };
-    
+
     template<>
-    class shared_state< void > : public boost::noncopyable
+    class shared_state< void > : public shared_state_base
     {
     private:
         boost::atomic< std::size_t >   use_count_;
-        mutable mutex           mtx_;
-        mutable condition_variable       waiters_;
-        boost::atomic<bool>              ready_;
-        std::exception_ptr           except_;
-        typedef std::function<void()>  external_waiter;
-        std::vector<external_waiter>   ext_waiters_;
-        
-        void mark_ready_and_notify_()
-        {
-            ready_ = true;
-            waiters_.notify_all();
-            for(auto &w: ext_waiters_) {
-                relock_guard<mutex> g(mtx_);
-                w();
-            }
-        }
-        
-        void owner_destroyed_()
-        {
-            //TODO: set broken_exception if future was not already done
-            //      notify all waiters
-            if (!ready_) {
-                set_exception_(utility::copy_exception( broken_promise() ) );
-            }
-        }
-        
-        void set_value_()
-        {
-            //TODO: store the value and make the future ready
-            //      notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied() );
-            mark_ready_and_notify_();
-        }
-        
-        void set_exception_( std::exception_ptr except)
-        {
-            //TODO: store the exception pointer p into the shared state and make the state ready
-            //      done = true, notify all waiters
-            if (ready_)
-                BOOST_THROW_EXCEPTION(promise_already_satisfied() );
-            except_ = except;
-            mark_ready_and_notify_();
-        }
-        
-        void get_( boost::unique_lock< mutex > & lk)
-        {
-            //TODO: the get method waits until the future has a valid result and
-            //      (depending on which template is used) retrieves it
-            //      it effectively calls wait_() in order to wait for the result
-            //      if it satisfies the requirements of MoveAssignable, the value is moved,
-            //      otherwise it is copied
-            wait_(lk);
-            if (except_)
-                std::rethrow_exception( except_);
-        }
-        
-        void wait_(boost::unique_lock< mutex > & lk) const
-        {
-            //TODO: blocks until the result becomes available
-            while ( ! ready_)
-                waiters_.wait( lk);
-        }
-        
-        template< class Rep, class Period >
-        future_status wait_for_( boost::unique_lock< mutex > & lk,
-                                boost::chrono::duration< Rep, Period > const& timeout_duration) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            while ( ! ready_)
-            {
-                cv_status st( waiters_.wait_for( lk, timeout_duration) );
-                if ( cv_status::timeout == st && ! ready_)
-                    return future_status::timeout;
-            }
-            return future_status::ready;
-        }
-        
-        future_status wait_until_( boost::unique_lock< mutex > & lk,
-                                  clock_type::time_point const& timeout_time) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            while ( ! ready_)
-            {
-                cv_status st( waiters_.wait_until( lk, timeout_time) );
-                if ( cv_status::timeout == st && ! ready_)
-                    return future_status::timeout;
-            }
-            return future_status::ready;
-        }
-        
+
     protected:
         virtual void deallocate_future() = 0;
-        
+
     public:
         typedef boost::intrusive_ptr< shared_state >    ptr_t;
-        
+
         shared_state() :
-        use_count_( 0), mtx_(), ready_( false), except_()
+        use_count_( 0)
         {}
-        
+
         virtual ~shared_state() {}
-        
-        template<typename Fn>
-        void add_external_waiter(Fn &&fn)
-        {
-            boost::unique_lock< mutex > lk( mtx_);
-            if (ready_) {
-                relock_guard<mutex> g(mtx_);
-                fn();
-            } else {
-                ext_waiters_.emplace_back(std::forward<Fn>(fn));
-            }
-        }
-        
-        void owner_destroyed()
-        {
-            //TODO: lock mutex
-            //      set broken_exception if future was not already done
-            //      done = true, notify all waiters
-            boost::unique_lock< mutex > lk( mtx_);
-            owner_destroyed_();
-        }
-        
+
         void set_value()
         {
-            //TODO: store the value into the shared state and make the state ready
-            //      the operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_value_();
+            claim_or_throw();
+            publish(false);
         }
-        
-        void set_exception( std::exception_ptr except)
-        {
-            //TODO: store the exception pointer p into the shared state and make the state ready
-            //      the operation is atomic, i.e. it behaves as though they acquire a single mutex
-            //      associated with the promise object while updating the promise object
-            //      an exception is thrown if there is no shared state or the shared state already
-            //      stores a value or exception
-            boost::unique_lock< mutex > lk( mtx_);
-            set_exception_( except);
-        }
-        
+
         void get()
         {
-            //TODO: the get method waits until the future has a valid result and
-            //      (depending on which template is used) retrieves it
-            //      it effectively calls wait() in order to wait for the result
-            //      the value stored in the shared state
-            //      if it satisfies the requirements of MoveAssignable, the value is moved,
-            //      otherwise it is copied
-            //      valid() == false after a call to this method.  
-            //      detect the case when valid == false before the call and throw a
-            //      future_error with an error condition of future_errc::no_state
-            boost::unique_lock< mutex > lk( mtx_);
-            get_( lk);
+            wait();
+            rethrow_if_exception_();
         }
-        
-        void wait() const
-        {
-            //TODO: blocks until the result becomes available
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            wait_( lk);
-        }
-        
-        template< class Rep, class Period >
-        future_status wait_for( boost::chrono::duration< Rep, Period > const& timeout_duration) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            return wait_for_( lk, timeout_duration);
-        }
-        
-        future_status wait_until( clock_type::time_point const& timeout_time) const
-        {
-            //TODO: blocks until the result becomes available or timeout
-            //      valid() == true after the call
-            boost::unique_lock< mutex > lk( mtx_);
-            return wait_until_( lk, timeout_time);
-        }
-        
-        void reset()
-        { ready_ = false; }
-        
+
         friend inline void intrusive_ptr_add_ref( shared_state * p) noexcept
         { ++p->use_count_; }
-        
+
         friend inline void intrusive_ptr_release( shared_state * p)
         {
             if ( 0 == --p->use_count_)
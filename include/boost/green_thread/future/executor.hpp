@@ -0,0 +1,119 @@
+//
+//  executor.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_FUTURE_EXECUTOR_HPP
+#define BOOST_GREEN_THREAD_FUTURE_EXECUTOR_HPP
+
+#include <memory>
+#include <type_traits>
+#include <boost/asio/strand.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/thread_data.hpp>
+#include <boost/green_thread/detail/utility.hpp>
+#include <boost/green_thread/thread_only.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        /// Number of inline continuations running on the stack of the current thread
+        BOOST_GREEN_THREAD_DECL int &continuation_depth();
+
+        /// Scheduler of the current thread, the default one in a foreign thread
+        BOOST_GREEN_THREAD_DECL scheduler current_scheduler();
+
+        /**
+         * How `then` keeps an executor until the future is ready, a copy
+         * if it can be copied, otherwise the reference it was given
+         */
+        template<typename Executor>
+        using stored_executor=typename std::conditional<std::is_copy_constructible<typename std::decay<Executor>::type>::value,
+                                                        typename std::decay<Executor>::type,
+                                                        Executor>::type;
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Runs continuations right away on the thread completing the future
+     *
+     * The cheapest choice for short non-blocking continuations, this is what
+     * `then` without an executor uses. A continuation completing the next
+     * future runs the next one nested, past `max_depth` levels the chain
+     * continues in a new thread so long chains don't overflow the stack,
+     * on the scheduler of the thread which created the executor, even if
+     * the future is completed by a foreign thread.
+     */
+    class inline_executor {
+    public:
+        static constexpr int max_depth=8;
+
+        inline_executor()
+        : sched_(detail::current_scheduler())
+        {}
+
+        template<typename Fn>
+        void post(Fn &&fn) const {
+            int &depth=detail::continuation_depth();
+            if (depth>=max_depth) {
+                thread(sched_, std::forward<Fn>(fn)).detach();
+                return;
+            }
+            struct guard {
+                int &depth_;
+                ~guard() { depth_--; }
+            } g={++depth};
+            fn();
+        }
+
+    private:
+        mutable scheduler sched_;
+    };
+
+    /**
+     * Runs continuations in new threads sharing the strand of the thread
+     * which created the executor, so they never run concurrently with it
+     *
+     * Must be created in a thread.
+     */
+    class BOOST_GREEN_THREAD_DECL strand_executor {
+    public:
+        strand_executor();
+
+        template<typename Fn>
+        void post(Fn &&fn) const {
+            spawn(detail::make_thread_data(utility::decay_copy(std::forward<Fn>(fn))));
+        }
+
+    private:
+        void spawn(detail::thread_data_base *entry) const;
+
+        std::shared_ptr<detail::scheduler_object> sched_;
+        std::shared_ptr<boost::asio::strand> strand_;
+    };
+
+    /**
+     * Runs continuations in new threads scheduled on any worker of the
+     * scheduler of the thread which created the executor, they may block
+     */
+    class thread_executor {
+    public:
+        thread_executor()
+        : sched_(detail::current_scheduler())
+        {}
+
+        template<typename Fn>
+        void post(Fn &&fn) const {
+            thread(sched_, std::forward<Fn>(fn)).detach();
+        }
+
+    private:
+        mutable scheduler sched_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -19,6 +19,8 @@
 #include <boost/utility.hpp>
 #include <boost/green_thread/detail/utility.hpp>
 #include <boost/green_thread/exceptions.hpp>
+#include <boost/green_thread/mutex.hpp>
+#include <boost/green_thread/condition_variable.hpp>
 #include <boost/green_thread/future/future_status.hpp>
 #include <boost/green_thread/future/detail/shared_state_object.hpp>
 
@@ -36,6 +38,8 @@ namespace boost { namespace green_thread {
     template<typename R>
     class shared_future;
     
+    class selector;
+    
     namespace detail {
         template<typename T>
         struct is_future : std::integral_constant<bool, false>
@@ -60,6 +64,8 @@ namespace boost { namespace green_thread {
         
         template<typename ...Futures>
         struct async_all_waiter;
+
+        struct future_access;
     }
     
     template<typename Iterator>
@@ -102,6 +108,8 @@ namespace boost { namespace green_thread {
         friend struct detail::async_any_waiter;
         template<typename ...Futures>
         friend struct detail::async_all_waiter;
+        friend class selector;
+        friend struct detail::future_access;
         template<typename Iterator>
         friend auto async_wait_for_any(Iterator begin,Iterator end)
         -> typename std::enable_if<!detail::is_future<Iterator>::value, future<Iterator>>::type;
@@ -212,8 +220,19 @@ namespace boost { namespace green_thread {
             return state_->wait_until(timeout_time);
         }
         
+        /// Runs `func` inline on the thread completing this future
         template<typename F>
         future<typename std::result_of<F(future&)>::type> then(F&& func);
+        
+        /**
+         * Posts `func` to `ex` once this future is ready
+         *
+         * A copyable executor is copied, a non-copyable one, e.g. a
+         * `work_stealing_executor`, is kept by reference and must outlive
+         * the future.
+         */
+        template<typename Executor, typename F>
+        future<typename std::result_of<F(future&)>::type> then(Executor&& ex, F&& func);
     };
     
     template<typename R>
@@ -240,6 +259,8 @@ namespace boost { namespace green_thread {
         friend struct detail::async_any_waiter;
         template<typename ...Futures>
         friend struct detail::async_all_waiter;
+        friend class selector;
+        friend struct detail::future_access;
         template<typename Iterator>
         friend auto async_wait_for_any(Iterator begin,Iterator end)
         -> typename std::enable_if<!detail::is_future<Iterator>::value, future<Iterator>>::type;
@@ -352,8 +373,19 @@ namespace boost { namespace green_thread {
             return state_->wait_until(timeout_time);
         }
 
+        /// Runs `func` inline on the thread completing this future
         template<typename F>
         future<typename std::result_of<F(future&)>::type> then(F&& func);
+        
+        /**
+         * Posts `func` to `ex` once this future is ready
+         *
+         * A copyable executor is copied, a non-copyable one, e.g. a
+         * `work_stealing_executor`, is kept by reference and must outlive
+         * the future.
+         */
+        template<typename Executor, typename F>
+        future<typename std::result_of<F(future&)>::type> then(Executor&& ex, F&& func);
     };
     
     template<>
@@ -380,6 +412,8 @@ namespace boost { namespace green_thread {
         friend struct detail::async_any_waiter;
         template<typename ...Futures>
         friend struct detail::async_all_waiter;
+        friend class selector;
+        friend struct detail::future_access;
         template<typename Iterator>
         friend auto async_wait_for_any(Iterator begin,Iterator end)
         -> typename std::enable_if<!detail::is_future<Iterator>::value, future<Iterator>>::type;
@@ -492,8 +526,19 @@ namespace boost { namespace green_thread {
             return state_->wait_until(timeout_time);
         }
 
+        /// Runs `func` inline on the thread completing this future
         template<typename F>
         future<typename std::result_of<F(future&)>::type> then(F&& func);
+        
+        /**
+         * Posts `func` to `ex` once this future is ready
+         *
+         * A copyable executor is copied, a non-copyable one, e.g. a
+         * `work_stealing_executor`, is kept by reference and must outlive
+         * the future.
+         */
+        template<typename Executor, typename F>
+        future<typename std::result_of<F(future&)>::type> then(Executor&& ex, F&& func);
     };
     
     template<typename R>
@@ -521,6 +566,8 @@ namespace boost { namespace green_thread {
         friend struct detail::async_any_waiter;
         template<typename ...Futures>
         friend struct detail::async_all_waiter;
+        friend class selector;
+        friend struct detail::future_access;
         template<typename Iterator>
         friend auto async_wait_for_any(Iterator begin,Iterator end)
         -> typename std::enable_if<!detail::is_future<Iterator>::value, future<Iterator>>::type;
@@ -657,8 +704,19 @@ namespace boost { namespace green_thread {
             return state_->wait_until(timeout_time);
         }
         
+        /// Runs `func` inline on the thread completing this future
         template<typename F>
         future<typename std::result_of<F(shared_future&)>::type> then(F&& func);
+        
+        /**
+         * Posts `func` to `ex` once this future is ready
+         *
+         * A copyable executor is copied, a non-copyable one, e.g. a
+         * `work_stealing_executor`, is kept by reference and must outlive
+         * the future.
+         */
+        template<typename Executor, typename F>
+        future<typename std::result_of<F(shared_future&)>::type> then(Executor&& ex, F&& func);
     };
     
     template<typename R>
@@ -682,6 +740,8 @@ namespace boost { namespace green_thread {
         friend struct detail::async_any_waiter;
         template<typename ...Futures>
         friend struct detail::async_all_waiter;
+        friend class selector;
+        friend struct detail::future_access;
         template<typename Iterator>
         friend auto async_wait_for_any(Iterator begin,Iterator end)
         -> typename std::enable_if<!detail::is_future<Iterator>::value, future<Iterator>>::type;
@@ -818,8 +878,19 @@ namespace boost { namespace green_thread {
             return state_->wait_until(timeout_time);
         }
         
+        /// Runs `func` inline on the thread completing this future
         template<typename F>
         future<typename std::result_of<F(shared_future&)>::type> then(F&& func);
+        
+        /**
+         * Posts `func` to `ex` once this future is ready
+         *
+         * A copyable executor is copied, a non-copyable one, e.g. a
+         * `work_stealing_executor`, is kept by reference and must outlive
+         * the future.
+         */
+        template<typename Executor, typename F>
+        future<typename std::result_of<F(shared_future&)>::type> then(Executor&& ex, F&& func);
     };
     
     template<>
@@ -843,6 +914,8 @@ namespace boost { namespace green_thread {
         friend struct detail::async_any_waiter;
         template<typename ...Futures>
         friend struct detail::async_all_waiter;
+        friend class selector;
+        friend struct detail::future_access;
         template<typename Iterator>
         friend auto async_wait_for_any(Iterator begin,Iterator end)
         -> typename std::enable_if<!detail::is_future<Iterator>::value, future<Iterator>>::type;
@@ -981,8 +1054,19 @@ namespace boost { namespace green_thread {
             return state_->wait_until(timeout_time);
         }
         
+        /// Runs `func` inline on the thread completing this future
         template<typename F>
         future<typename std::result_of<F(shared_future&)>::type> then(F&& func);
+        
+        /**
+         * Posts `func` to `ex` once this future is ready
+         *
+         * A copyable executor is copied, a non-copyable one, e.g. a
+         * `work_stealing_executor`, is kept by reference and must outlive
+         * the future.
+         */
+        template<typename Executor, typename F>
+        future<typename std::result_of<F(shared_future&)>::type> then(Executor&& ex, F&& func);
     };
     
     template<typename R>
@@ -1218,6 +1302,21 @@ namespace boost { namespace green_thread {
         boost::unique_lock<mutex> lk(mtx);
         cv.wait(lk, [&]()->bool{ return acquired==count; });
     }
+    
+    namespace detail {
+        /// Access to the shared states of futures for the combinators
+        struct future_access {
+            template<typename Future>
+            static shared_state_base &state(Future &f) {
+                return *f.state_;
+            }
+            
+            template<typename R>
+            static future<R> make(typename shared_state<R>::ptr_t p) {
+                return future<R>(p);
+            }
+        };
+    }   // End of namespace boost::green_thread::detail
 }}  // End of namespace boost::green_thread
 
 #endif
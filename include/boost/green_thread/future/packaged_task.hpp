@@ -57,8 +57,8 @@ namespace boost { namespace green_thread {
             >::value>::type
         >
         explicit packaged_task(Fn &&fn) {
-            typedef detail::task_object<Fn, std::allocator<this_type>, R, Args...> object_t;
-            std::allocator<packaged_task<R(Args...)>> alloc;
+            typedef detail::task_object<Fn, pool_allocator<this_type>, R, Args...> object_t;
+            pool_allocator<packaged_task<R(Args...)>> alloc;
             typename object_t::allocator_t a(alloc);
             // placement new
             task_ = ptr_t(::new(a.allocate(1)) object_t(std::forward<Fn>(fn), a));
@@ -67,7 +67,7 @@ namespace boost { namespace green_thread {
         template<typename Fn, typename Allocator>
         explicit packaged_task(std::allocator_arg_t, const Allocator& alloc, Fn &&fn)
         {
-            typedef detail::task_object<Fn, std::allocator<this_type>, R, Args...> object_t;
+            typedef detail::task_object<Fn, Allocator, R, Args...> object_t;
             typename object_t::allocator_t a(alloc);
             // placement new
             task_ = ptr_t(::new(a.allocate(1)) object_t(std::forward<Fn>(fn), a));
@@ -22,9 +22,11 @@
 
 #include <boost/green_thread/exceptions.hpp>
 #include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/pool_allocator.hpp>
 #include <boost/green_thread/future/detail/shared_state.hpp>
 #include <boost/green_thread/future/detail/shared_state_object.hpp>
 #include <boost/green_thread/future/future.hpp>
+#include <boost/green_thread/future/executor.hpp>
 
 namespace boost { namespace green_thread {
     template< typename R >
@@ -52,9 +54,9 @@ namespace boost { namespace green_thread {
             //       the shared state is allocated using alloc
             //       alloc must meet the requirements of Allocator
             typedef detail::shared_state_object<
-            R, std::allocator< promise< R > >
+            R, pool_allocator< promise< R > >
             >                                               object_t;
-            std::allocator< promise< R > > alloc;
+            pool_allocator< promise< R > > alloc;
             typename object_t::allocator_t a( alloc);
             future_ = ptr_t(
                             // placement new
@@ -219,9 +221,9 @@ namespace boost { namespace green_thread {
             //       the shared state is allocated using alloc
             //       alloc must meet the requirements of Allocator
             typedef detail::shared_state_object<
-            R &, std::allocator< promise< R & > >
+            R &, pool_allocator< promise< R & > >
             >                                               object_t;
-            std::allocator< promise< R > > alloc;
+            pool_allocator< promise< R & > > alloc;
             typename object_t::allocator_t a( alloc);
             future_ = ptr_t(
                             // placement new
@@ -360,9 +362,9 @@ namespace boost { namespace green_thread {
             //       the shared state is allocated using alloc
             //       alloc must meet the requirements of Allocator
             typedef detail::shared_state_object<
-            void, std::allocator< promise< void > >
+            void, pool_allocator< promise< void > >
             >                                               object_t;
-            std::allocator< promise< void > > alloc;
+            pool_allocator< promise< void > > alloc;
             object_t::allocator_t a( alloc);
             future_ = ptr_t(
                             // placement new
@@ -628,112 +630,196 @@ namespace boost { namespace green_thread {
     
     template<typename R> template<typename F>
     inline future<typename std::result_of<F(future<R>&)>::type> future<R>::then(F&& func) {
+        return then(inline_executor(), std::forward<F>(func));
+    }
+
+    template<typename R> template<typename Executor, typename F>
+    inline future<typename std::result_of<F(future<R>&)>::type> future<R>::then(Executor&& ex, F&& func) {
         typedef typename std::result_of<F(future<R>&)>::type result_type;
         struct waiter {
             ptr_t src_;
+            detail::stored_executor<Executor> ex_;
             F f_;
             promise<result_type> p_;
-            waiter(ptr_t src, F &&f) : src_(src), f_(std::forward<F>(f)) {}
+            waiter(ptr_t src, Executor &&ex, F &&f) : src_(src), ex_(std::forward<Executor>(ex)), f_(std::forward<F>(f)) {}
             void invoke() {
                 future<R> f(src_);
-                detail::set_promise_value(p_, std::forward<F>(f_), f);
+                src_.reset();
+                try {
+                    detail::set_promise_value(p_, std::forward<F>(f_), f);
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                }
             }
         };
-        std::shared_ptr<waiter> w=std::make_shared<waiter>(state_, std::forward<F>(func));
-        state_->add_external_waiter(std::bind(&waiter::invoke, w));
-        return w->p_.get_future();
+        std::shared_ptr<waiter> w=std::allocate_shared<waiter>(pool_allocator<waiter>(), state_, std::forward<Executor>(ex), std::forward<F>(func));
+        future<result_type> ret=w->p_.get_future();
+        state_->add_external_waiter([w](){
+            w->ex_.post([w](){ w->invoke(); });
+        });
+        return ret;
     }
-
+    
     template<typename R> template<typename F>
     inline future<typename std::result_of<F(future<R&>&)>::type> future<R&>::then(F&& func) {
+        return then(inline_executor(), std::forward<F>(func));
+    }
+
+    template<typename R> template<typename Executor, typename F>
+    inline future<typename std::result_of<F(future<R&>&)>::type> future<R&>::then(Executor&& ex, F&& func) {
         typedef typename std::result_of<F(future<R&>&)>::type result_type;
         struct waiter {
             ptr_t src_;
+            detail::stored_executor<Executor> ex_;
             F f_;
             promise<result_type> p_;
-            waiter(ptr_t src, F &&f) : src_(src), f_(std::forward<F>(f)) {}
+            waiter(ptr_t src, Executor &&ex, F &&f) : src_(src), ex_(std::forward<Executor>(ex)), f_(std::forward<F>(f)) {}
             void invoke() {
                 future<R&> f(src_);
-                detail::set_promise_value(p_, std::forward<F>(f_), f);
+                src_.reset();
+                try {
+                    detail::set_promise_value(p_, std::forward<F>(f_), f);
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                }
             }
         };
-        std::shared_ptr<waiter> w=std::make_shared<waiter>(state_, std::forward<F>(func));
-        state_->add_external_waiter(std::bind(&waiter::invoke, w));
-        return w->p_.get_future();
+        std::shared_ptr<waiter> w=std::allocate_shared<waiter>(pool_allocator<waiter>(), state_, std::forward<Executor>(ex), std::forward<F>(func));
+        future<result_type> ret=w->p_.get_future();
+        state_->add_external_waiter([w](){
+            w->ex_.post([w](){ w->invoke(); });
+        });
+        return ret;
     }
-
+    
     template<typename F>
     inline future<typename std::result_of<F(future<void>&)>::type> future<void>::then(F&& func) {
+        return then(inline_executor(), std::forward<F>(func));
+    }
+
+    template<typename Executor, typename F>
+    inline future<typename std::result_of<F(future<void>&)>::type> future<void>::then(Executor&& ex, F&& func) {
         typedef typename std::result_of<F(future<void>&)>::type result_type;
         struct waiter {
             ptr_t src_;
+            detail::stored_executor<Executor> ex_;
             F f_;
             promise<result_type> p_;
-            waiter(ptr_t src, F &&f) : src_(src), f_(std::forward<F>(f)) {}
+            waiter(ptr_t src, Executor &&ex, F &&f) : src_(src), ex_(std::forward<Executor>(ex)), f_(std::forward<F>(f)) {}
             void invoke() {
                 future<void> f(src_);
-                detail::set_promise_value(p_, std::forward<F>(f_), f);
+                src_.reset();
+                try {
+                    detail::set_promise_value(p_, std::forward<F>(f_), f);
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                }
             }
         };
-        std::shared_ptr<waiter> w=std::make_shared<waiter>(state_, std::forward<F>(func));
-        state_->add_external_waiter(std::bind(&waiter::invoke, w));
-        return w->p_.get_future();
+        std::shared_ptr<waiter> w=std::allocate_shared<waiter>(pool_allocator<waiter>(), state_, std::forward<Executor>(ex), std::forward<F>(func));
+        future<result_type> ret=w->p_.get_future();
+        state_->add_external_waiter([w](){
+            w->ex_.post([w](){ w->invoke(); });
+        });
+        return ret;
     }
-
+    
     template<typename R> template<typename F>
     inline future<typename std::result_of<F(shared_future<R>&)>::type> shared_future<R>::then(F&& func) {
+        return then(inline_executor(), std::forward<F>(func));
+    }
+
+    template<typename R> template<typename Executor, typename F>
+    inline future<typename std::result_of<F(shared_future<R>&)>::type> shared_future<R>::then(Executor&& ex, F&& func) {
         typedef typename std::result_of<F(shared_future<R>&)>::type result_type;
         struct waiter {
             ptr_t src_;
+            detail::stored_executor<Executor> ex_;
             F f_;
             promise<result_type> p_;
-            waiter(ptr_t src, F &&f) : src_(src), f_(std::forward<F>(f)) {}
+            waiter(ptr_t src, Executor &&ex, F &&f) : src_(src), ex_(std::forward<Executor>(ex)), f_(std::forward<F>(f)) {}
             void invoke() {
                 shared_future<R> f(src_);
-                detail::set_promise_value(p_, std::forward<F>(f_), f);
+                src_.reset();
+                try {
+                    detail::set_promise_value(p_, std::forward<F>(f_), f);
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                }
             }
         };
-        std::shared_ptr<waiter> w=std::make_shared<waiter>(state_, std::forward<F>(func));
-        state_->add_external_waiter(std::bind(&waiter::invoke, w));
-        return w->p_.get_future();
+        std::shared_ptr<waiter> w=std::allocate_shared<waiter>(pool_allocator<waiter>(), state_, std::forward<Executor>(ex), std::forward<F>(func));
+        future<result_type> ret=w->p_.get_future();
+        state_->add_external_waiter([w](){
+            w->ex_.post([w](){ w->invoke(); });
+        });
+        return ret;
     }
     
     template<typename R> template<typename F>
     inline future<typename std::result_of<F(shared_future<R&>&)>::type> shared_future<R&>::then(F&& func) {
+        return then(inline_executor(), std::forward<F>(func));
+    }
+
+    template<typename R> template<typename Executor, typename F>
+    inline future<typename std::result_of<F(shared_future<R&>&)>::type> shared_future<R&>::then(Executor&& ex, F&& func) {
         typedef typename std::result_of<F(shared_future<R&>&)>::type result_type;
         struct waiter {
             ptr_t src_;
+            detail::stored_executor<Executor> ex_;
             F f_;
             promise<result_type> p_;
-            waiter(ptr_t src, F &&f) : src_(src), f_(std::forward<F>(f)) {}
+            waiter(ptr_t src, Executor &&ex, F &&f) : src_(src), ex_(std::forward<Executor>(ex)), f_(std::forward<F>(f)) {}
             void invoke() {
                 shared_future<R&> f(src_);
-                detail::set_promise_value(p_, std::forward<F>(f_), f);
+                src_.reset();
+                try {
+                    detail::set_promise_value(p_, std::forward<F>(f_), f);
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                }
             }
         };
-        std::shared_ptr<waiter> w=std::make_shared<waiter>(state_, std::forward<F>(func));
-        state_->add_external_waiter(std::bind(&waiter::invoke, w));
-        return w->p_.get_future();
+        std::shared_ptr<waiter> w=std::allocate_shared<waiter>(pool_allocator<waiter>(), state_, std::forward<Executor>(ex), std::forward<F>(func));
+        future<result_type> ret=w->p_.get_future();
+        state_->add_external_waiter([w](){
+            w->ex_.post([w](){ w->invoke(); });
+        });
+        return ret;
     }
     
     template<typename F>
     inline future<typename std::result_of<F(shared_future<void>&)>::type> shared_future<void>::then(F&& func) {
+        return then(inline_executor(), std::forward<F>(func));
+    }
+
+    template<typename Executor, typename F>
+    inline future<typename std::result_of<F(shared_future<void>&)>::type> shared_future<void>::then(Executor&& ex, F&& func) {
         typedef typename std::result_of<F(shared_future<void>&)>::type result_type;
         struct waiter {
             ptr_t src_;
+            detail::stored_executor<Executor> ex_;
             F f_;
             promise<result_type> p_;
-            waiter(ptr_t src, F &&f) : src_(src), f_(std::forward<F>(f)) {}
+            waiter(ptr_t src, Executor &&ex, F &&f) : src_(src), ex_(std::forward<Executor>(ex)), f_(std::forward<F>(f)) {}
             void invoke() {
                 shared_future<void> f(src_);
-                detail::set_promise_value(p_, std::forward<F>(f_), f);
+                src_.reset();
+                try {
+                    detail::set_promise_value(p_, std::forward<F>(f_), f);
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                }
             }
         };
-        std::shared_ptr<waiter> w=std::make_shared<waiter>(state_, std::forward<F>(func));
-        state_->add_external_waiter(std::bind(&waiter::invoke, w));
-        return w->p_.get_future();
+        std::shared_ptr<waiter> w=std::allocate_shared<waiter>(pool_allocator<waiter>(), state_, std::forward<Executor>(ex), std::forward<F>(func));
+        future<result_type> ret=w->p_.get_future();
+        state_->add_external_waiter([w](){
+            w->ex_.post([w](){ w->invoke(); });
+        });
+        return ret;
     }
-
+    
     template<typename ...Futures>
     future<std::size_t> async_wait_for_any(Futures&... futures) {
         static_assert(utility::and_< detail::is_future<Futures>::value... >::value,
@@ -0,0 +1,186 @@
+//
+//  race.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_FUTURE_RACE_HPP
+#define BOOST_GREEN_THREAD_FUTURE_RACE_HPP
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/thread/lock_types.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/mutex.hpp>
+#include <boost/green_thread/condition_variable.hpp>
+#include <boost/green_thread/future/future.hpp>
+#include <boost/green_thread/future/promise.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        template<typename R>
+        struct race_result {
+            template<typename F>
+            void run(F &f) { value_=f(); }
+            void deliver(promise<R> &p) { p.set_value(std::move(*value_)); }
+            boost::optional<R> value_;
+        };
+
+        template<>
+        struct race_result<void> {
+            template<typename F>
+            void run(F &f) { f(); }
+            void deliver(promise<void> &p) { p.set_value(); }
+        };
+
+        /**
+         * Shared by the thread starting the alternatives on schedule and
+         * the threads running them
+         */
+        template<typename R>
+        class race_state : public std::enable_shared_from_this<race_state<R>> {
+        public:
+            race_state(std::vector<std::function<R()>> &&fns, duration_t delay)
+            : fns_(std::move(fns))
+            , delay_(delay)
+            {}
+
+            future<R> get_future() { return p_.get_future(); }
+
+            /**
+             * Starts the next alternative every `delay_`, or as soon as all
+             * running ones have failed, until one succeeds, then waits for
+             * the interrupted losers
+             */
+            void schedule() {
+                const size_t n=fns_.size();
+                {
+                    boost::unique_lock<mutex> lock(mtx_);
+                    for (size_t i=0; i<n && !done_; i++) {
+                        threads_.push_back(thread(&race_state::run, this->shared_from_this(), i));
+                        if (i+1==n) break;
+                        const time_point_t deadline=boost::chrono::steady_clock::now()+delay_;
+                        const size_t started=i+1;
+                        cv_.wait_until(lock, deadline, [&]{ return done_ || failed_==started; });
+                    }
+                }
+                // No more threads are added once the loop is over
+                for (thread &t : threads_) {
+                    t.join();
+                }
+            }
+
+        private:
+            void run(size_t i) {
+                race_result<R> r;
+                std::exception_ptr error;
+                try {
+                    r.run(fns_[i]);
+                } catch(...) {
+                    // Not handled here, locking may switch threads
+                    error=std::current_exception();
+                }
+                if (error) {
+                    boost::unique_lock<mutex> lock(mtx_);
+                    // Losers interrupted by the winner end up here too
+                    if (done_) return;
+                    error_=error;
+                    if (++failed_==fns_.size()) {
+                        done_=true;
+                        lock.unlock();
+                        p_.set_exception(error_);
+                    } else {
+                        cv_.notify_all();
+                    }
+                    return;
+                }
+                {
+                    boost::lock_guard<mutex> lock(mtx_);
+                    if (done_) return;
+                    done_=true;
+                    for (size_t k=0; k<threads_.size(); k++) {
+                        if (k!=i) threads_[k].interrupt();
+                    }
+                    cv_.notify_all();
+                }
+                r.deliver(p_);
+            }
+
+            const std::vector<std::function<R()>> fns_;
+            const duration_t delay_;
+            mutex mtx_;
+            condition_variable cv_;
+            std::vector<thread> threads_;
+            size_t failed_=0;
+            bool done_=false;
+            std::exception_ptr error_;
+            promise<R> p_;
+        };
+
+        template<typename R, typename... Fs>
+        future<R> start_race(duration_t delay, Fs&&... fs) {
+            std::vector<std::function<R()>> fns{std::function<R()>(std::forward<Fs>(fs))...};
+            auto state=std::make_shared<race_state<R>>(std::move(fns), delay);
+            future<R> ret=state->get_future();
+            thread(&race_state<R>::schedule, state).detach();
+            return ret;
+        }
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Runs alternative ways to get the same result, returns a future of the
+     * first one succeeding
+     *
+     * The first alternative starts right away, each of the next ones starts
+     * `delay` after the previous one, or as soon as every started one has
+     * failed. Once an alternative succeeds the others are not started
+     * anymore and the running ones are interrupted: sleeps, waits on
+     * futures, semaphores and `atomic_wait`, and asio operations guarded by
+     * `asio::cancel_on_interrupt` return with `thread_interrupted`. Locking
+     * a `mutex` or waiting on a `condition_variable` is not cut short, a
+     * loser blocked there only throws once it gets the lock or is notified.
+     * If every alternative fails the future holds the exception of the last
+     * failure.
+     *
+     * Typically used to hedge a request, sending it to another replica if
+     * the first one has not answered within the usual latency.
+     */
+    template<typename Rep, typename Period, typename F, typename... Fs>
+    auto hedge(const boost::chrono::duration<Rep, Period> &delay, F &&f, Fs&&... fs)
+    -> future<typename std::result_of<typename std::decay<F>::type()>::type>
+    {
+        typedef typename std::result_of<typename std::decay<F>::type()>::type result_type;
+        return detail::start_race<result_type>(boost::chrono::duration_cast<detail::duration_t>(delay),
+                                               std::forward<F>(f),
+                                               std::forward<Fs>(fs)...);
+    }
+
+    /**
+     * Runs all alternatives at once, returns a future of the first one
+     * succeeding, the others are interrupted
+     *
+     * @see hedge
+     */
+    template<typename F, typename... Fs>
+    auto race(F &&f, Fs&&... fs)
+    -> future<typename std::result_of<typename std::decay<F>::type()>::type>
+    {
+        typedef typename std::result_of<typename std::decay<F>::type()>::type result_type;
+        return detail::start_race<result_type>(detail::duration_t::zero(),
+                                               std::forward<F>(f),
+                                               std::forward<Fs>(fs)...);
+    }
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -0,0 +1,281 @@
+//
+//  when_all.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_FUTURE_WHEN_ALL_HPP
+#define BOOST_GREEN_THREAD_FUTURE_WHEN_ALL_HPP
+
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/green_thread/exceptions.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/future/detail/shared_state.hpp>
+#include <boost/green_thread/future/future.hpp>
+#include <boost/green_thread/future/promise.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Result of `when_any`, the position of the first future completed
+     * successfully and its value
+     */
+    template<typename T>
+    struct when_any_result {
+        std::size_t index;
+        T value;
+    };
+
+    namespace detail {
+        template<typename Future>
+        struct future_value {
+            typedef typename std::decay<decltype(std::declval<Future &>().get())>::type type;
+        };
+
+        /**
+         * Waits for a range of futures with one countdown
+         *
+         * The futures are moved into a single block together with the
+         * callback nodes linked into their shared states, so waiting for N
+         * futures costs no allocation per future. The last arrival completes
+         * the result and frees the whole group.
+         */
+        template<typename Future, typename Derived>
+        class future_group {
+        public:
+            template<typename Iterator>
+            static void start(std::unique_ptr<Derived> self, Iterator begin) {
+                // Everything is consumed before the first node is linked, a
+                // state which is ready right away completes the group inline
+                for (std::size_t i=0; i<self->size_; ++i, ++begin) {
+                    entry &e=self->entries_[i];
+                    e.owner_=self.get();
+                    e.index_=i;
+                    e.future_=std::move(*begin);
+                }
+                Derived *g=self.release();
+                for (std::size_t i=0; i<g->size_; ++i) {
+                    future_access::state(g->entries_[i].future_).add_callback_node(&g->entries_[i]);
+                }
+                // Drops the reference held by the setup
+                g->arrive(nullptr);
+            }
+
+        protected:
+            struct entry : shared_state_base::callback_node {
+                void invoke() override { owner_->arrive(this); }
+                // The group holds the future, so the state outlives the node
+                void discard() override {}
+
+                Derived *owner_=nullptr;
+                std::size_t index_=0;
+                Future future_;
+            };
+
+            explicit future_group(std::size_t n)
+            : size_(n)
+            , entries_(new entry[n])
+            , pending_(n+1)
+            {}
+
+            void arrive(entry *e) {
+                Derived *self=static_cast<Derived *>(this);
+                if (e) self->on_ready(*e);
+                if (pending_.fetch_sub(1, boost::memory_order_acq_rel)==1) {
+                    self->on_complete();
+                    delete self;
+                }
+            }
+
+            const std::size_t size_;
+            std::unique_ptr<entry[]> entries_;
+            boost::atomic<std::size_t> pending_;
+        };
+
+        template<typename Future, typename T=typename future_value<Future>::type>
+        class when_all_state : public future_group<Future, when_all_state<Future, T>> {
+            typedef future_group<Future, when_all_state> base_type;
+            friend base_type;
+
+        public:
+            explicit when_all_state(std::size_t n) : base_type(n) {}
+
+            future<std::vector<T>> get_future() { return p_.get_future(); }
+
+        private:
+            void on_ready(typename base_type::entry &) {}
+
+            void on_complete() {
+                std::vector<T> values;
+                try {
+                    values.reserve(this->size_);
+                    for (std::size_t i=0; i<this->size_; i++) {
+                        values.push_back(this->entries_[i].future_.get());
+                    }
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                    return;
+                }
+                p_.set_value(std::move(values));
+            }
+
+            promise<std::vector<T>> p_;
+        };
+
+        template<typename Future>
+        class when_all_state<Future, void> : public future_group<Future, when_all_state<Future, void>> {
+            typedef future_group<Future, when_all_state> base_type;
+            friend base_type;
+
+        public:
+            explicit when_all_state(std::size_t n) : base_type(n) {}
+
+            future<void> get_future() { return p_.get_future(); }
+
+        private:
+            void on_ready(typename base_type::entry &) {}
+
+            void on_complete() {
+                try {
+                    for (std::size_t i=0; i<this->size_; i++) {
+                        this->entries_[i].future_.get();
+                    }
+                } catch(...) {
+                    p_.set_exception(std::current_exception());
+                    return;
+                }
+                p_.set_value();
+            }
+
+            promise<void> p_;
+        };
+
+        template<typename Future, typename T=typename future_value<Future>::type>
+        class when_any_state : public future_group<Future, when_any_state<Future, T>> {
+            typedef future_group<Future, when_any_state> base_type;
+            friend base_type;
+
+        public:
+            typedef when_any_result<T> result_type;
+
+            explicit when_any_state(std::size_t n) : base_type(n), won_(false) {}
+
+            future<result_type> get_future() { return p_.get_future(); }
+
+        private:
+            void on_ready(typename base_type::entry &e) {
+                if (won_.load(boost::memory_order_relaxed)) return;
+                try {
+                    result_type r{e.index_, e.future_.get()};
+                    if (!won_.exchange(true)) p_.set_value(std::move(r));
+                } catch(...) {
+                    boost::lock_guard<spinlock> lock(error_mtx_);
+                    if (!error_) error_=std::current_exception();
+                }
+            }
+
+            void on_complete() {
+                // Every future has failed
+                if (!won_.load()) p_.set_exception(error_);
+            }
+
+            boost::atomic<bool> won_;
+            spinlock error_mtx_;
+            std::exception_ptr error_;
+            promise<result_type> p_;
+        };
+
+        template<typename Future>
+        class when_any_state<Future, void> : public future_group<Future, when_any_state<Future, void>> {
+            typedef future_group<Future, when_any_state> base_type;
+            friend base_type;
+
+        public:
+            typedef std::size_t result_type;
+
+            explicit when_any_state(std::size_t n) : base_type(n), won_(false) {}
+
+            future<result_type> get_future() { return p_.get_future(); }
+
+        private:
+            void on_ready(typename base_type::entry &e) {
+                if (won_.load(boost::memory_order_relaxed)) return;
+                try {
+                    e.future_.get();
+                    if (!won_.exchange(true)) p_.set_value(e.index_);
+                } catch(...) {
+                    boost::lock_guard<spinlock> lock(error_mtx_);
+                    if (!error_) error_=std::current_exception();
+                }
+            }
+
+            void on_complete() {
+                if (!won_.load()) p_.set_exception(error_);
+            }
+
+            boost::atomic<bool> won_;
+            spinlock error_mtx_;
+            std::exception_ptr error_;
+            promise<result_type> p_;
+        };
+
+        template<typename State, typename Iterator>
+        auto start_group(Iterator begin, Iterator end) -> decltype(std::declval<State &>().get_future()) {
+            typedef typename std::iterator_traits<Iterator>::value_type future_type;
+            static_assert(is_future<future_type>::value, "Iterator must refer to future type");
+            const std::size_t n=std::distance(begin, end);
+            for (Iterator i=begin; i!=end; ++i) {
+                if (!i->valid()) BOOST_THROW_EXCEPTION(future_uninitialized());
+            }
+            std::unique_ptr<State> state(new State(n));
+            auto ret=state->get_future();
+            State::start(std::move(state), begin);
+            return ret;
+        }
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Returns a future which becomes ready once every future in the range
+     * is, holding their values in order
+     *
+     * The futures are moved out of the range. If any of them holds an
+     * exception, the result holds the exception of the first one in the
+     * range. Futures of `void` give a `future<void>`.
+     */
+    template<typename Iterator>
+    auto when_all(Iterator begin, Iterator end)
+    -> decltype(detail::start_group<detail::when_all_state<typename std::iterator_traits<Iterator>::value_type>>(begin, end))
+    {
+        typedef typename std::iterator_traits<Iterator>::value_type future_type;
+        return detail::start_group<detail::when_all_state<future_type>>(begin, end);
+    }
+
+    /**
+     * Returns a future which becomes ready with the position and the value
+     * of the first future in the range completed successfully
+     *
+     * The futures are moved out of the range. If all of them fail the
+     * result holds the exception of the first failure, an empty range is an
+     * `invalid_argument`. Futures of `void` give the position only.
+     */
+    template<typename Iterator>
+    auto when_any(Iterator begin, Iterator end)
+    -> decltype(detail::start_group<detail::when_any_state<typename std::iterator_traits<Iterator>::value_type>>(begin, end))
+    {
+        typedef typename std::iterator_traits<Iterator>::value_type future_type;
+        if (begin==end) BOOST_THROW_EXCEPTION(invalid_argument());
+        return detail::start_group<detail::when_any_state<future_type>>(begin, end);
+    }
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -0,0 +1,88 @@
+//
+//  work_stealing_executor.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_FUTURE_WORK_STEALING_EXECUTOR_HPP
+#define BOOST_GREEN_THREAD_FUTURE_WORK_STEALING_EXECUTOR_HPP
+
+#include <memory>
+#include <utility>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/thread_data.hpp>
+#include <boost/green_thread/detail/utility.hpp>
+#include <boost/green_thread/future/future.hpp>
+#include <boost/green_thread/future/packaged_task.hpp>
+#include <boost/green_thread/future/async.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        struct work_stealing_pool;
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Runs functions of any result type in a fixed set of threads, returns
+     * futures
+     *
+     * Every worker thread has its own queue. Functions submitted by a task
+     * running in the executor go to the queue of its worker and run newest
+     * first, functions submitted from elsewhere are spread over the queues.
+     * An idle worker takes the oldest function of another queue before
+     * going to sleep, so submissions and dequeues seldom contend.
+     *
+     * Destroying the executor runs the remaining functions and joins the
+     * workers.
+     */
+    class BOOST_GREEN_THREAD_DECL work_stealing_executor {
+    public:
+        /// Starts `pool_size` workers, as many as the scheduler has worker threads if 0
+        explicit work_stealing_executor(size_t pool_size=0);
+
+        ~work_stealing_executor();
+
+        /// Number of worker threads
+        size_t size() const;
+
+        template<typename Fn, typename ...Args>
+        typename detail::task_data<Fn, Args...>::future_type
+        submit(Fn &&fn, Args&&... args) {
+            typedef detail::task_data<Fn, Args...> data_type;
+            typename data_type::task_type task(data_type(std::forward<Fn>(fn), std::forward<Args>(args)...));
+            typename data_type::future_type ret(task.get_future());
+            push(detail::make_thread_data(std::move(task)));
+            return ret;
+        }
+
+        template<typename Fn, typename ...Args>
+        typename detail::task_data<Fn, Args...>::future_type
+        operator()(Fn &&fn, Args&&... args) {
+            return submit(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        }
+
+        /**
+         * Runs `fn` in the executor without a future, so it can be used
+         * as an executor for `future::then`, an exception thrown by `fn`
+         * is dropped
+         */
+        template<typename Fn>
+        void post(Fn &&fn) {
+            push(detail::make_thread_data(utility::decay_copy(std::forward<Fn>(fn))));
+        }
+
+    private:
+        work_stealing_executor(const work_stealing_executor &)=delete;
+        void operator=(const work_stealing_executor &)=delete;
+
+        /// Queues `task`, takes ownership
+        void push(detail::thread_data_base *task);
+
+        std::unique_ptr<detail::work_stealing_pool> impl_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
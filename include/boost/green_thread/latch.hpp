@@ -0,0 +1,100 @@
+//
+//  latch.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_LATCH_HPP
+#define BOOST_GREEN_THREAD_LATCH_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <boost/atomic.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/waiter.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Single-use downward counter, threads wait until the counter reaches zero
+     *
+     * Counting down is a single atomic operation, waiters park on a lock-free
+     * list which is closed and woken in one batch by the thread bringing the
+     * counter to zero. Can be used by both green threads and foreign threads.
+     */
+    class latch {
+    public:
+        /**
+         * constructor, initializes the internal counter with `expected`
+         */
+        explicit latch(std::ptrdiff_t expected)
+        : count_(expected)
+        {
+            assert(expected>=0);
+            if (expected==0) waiters_.close();
+        }
+        
+        /**
+         * returns the maximum value of the internal counter
+         */
+        static constexpr std::ptrdiff_t max() noexcept {
+            return std::numeric_limits<std::ptrdiff_t>::max();
+        }
+        
+        /**
+         * decrements the internal counter by `n` without blocking
+         */
+        void count_down(std::ptrdiff_t n=1) {
+            assert(n>=0);
+            const std::ptrdiff_t c=count_.fetch_sub(n, boost::memory_order_acq_rel)-n;
+            assert(c>=0);
+            if (n>0 && c==0) {
+                detail::waiter_stack::notify_all(waiters_.close());
+            }
+        }
+        
+        /**
+         * returns true if the internal counter has reached zero
+         */
+        bool try_wait() const noexcept {
+            return count_.load(boost::memory_order_acquire)==0;
+        }
+        
+        /**
+         * blocks until the internal counter reaches zero, an interruption
+         * is only reported once the counter has reached zero
+         */
+        void wait() const {
+            if (try_wait()) return;
+            detail::waiter w;
+            // Fails if the latch has been released already, the waiter can't
+            // leave the stack before the release, so the wait isn't cut short
+            // by an interruption
+            if (waiters_.push(&w)) {
+                w.wait(false);
+            }
+        }
+        
+        /**
+         * decrements the internal counter by `n` and blocks until it reaches zero
+         */
+        void arrive_and_wait(std::ptrdiff_t n=1) {
+            count_down(n);
+            wait();
+        }
+        
+    private:
+        /// non-copyable
+        latch(const latch&) = delete;
+        void operator=(const latch&) = delete;
+        
+        boost::atomic<std::ptrdiff_t> count_;
+        mutable detail::waiter_stack waiters_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -0,0 +1,52 @@
+//
+//  lock_profile.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_LOCK_PROFILE_HPP
+#define BOOST_GREEN_THREAD_LOCK_PROFILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Contention statistics of a lock, reported by `scheduler::lock_profile`
+     *
+     * Only recorded if the library is built with BOOST_GREEN_THREAD_LOCK_PROFILING.
+     * Covers `mutex`, `recursive_mutex`, `timed_mutex`, `recursive_timed_mutex`,
+     * `shared_timed_mutex` and `condition_variable` used by green threads.
+     */
+    struct lock_profile_entry {
+        /// address of the lock
+        const void *lock;
+        /// name given by `set_lock_name`, empty if not named
+        std::string name;
+        /// number of acquisitions, or waits for a condition variable
+        uint64_t acquisitions;
+        /// number of acquisitions which had to wait
+        uint64_t contentions;
+        /// total time spent waiting
+        detail::duration_t total_wait;
+        /// longest wait
+        detail::duration_t max_wait;
+        /// longest time the lock was held exclusively
+        detail::duration_t max_hold;
+    };
+    
+    /**
+     * Names a lock in profiling reports, an empty name removes the name, the
+     * name should be removed before the lock is destroyed if the address may
+     * be reused by another lock
+     */
+    BOOST_GREEN_THREAD_DECL void set_lock_name(const void *lock, const std::string &name);
+}}  // End of namespace boost::green_thread
+
+#endif
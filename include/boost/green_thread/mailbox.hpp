@@ -0,0 +1,260 @@
+//
+//  mailbox.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_MAILBOX_HPP
+#define BOOST_GREEN_THREAD_MAILBOX_HPP
+
+#include <memory>
+#include <type_traits>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/thread/thread_only.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+#include <boost/green_thread/thread.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Link embedded in every message sent through a `mailbox`
+     */
+    struct mailbox_node {
+        mailbox_node()
+        : next_(nullptr)
+        {}
+
+        boost::atomic<mailbox_node *> next_;
+    };
+
+    /**
+     * Unbounded intrusive mailbox with many senders and one receiver
+     *
+     * Messages derive from `mailbox_node`, so sending doesn't allocate, and
+     * takes one atomic exchange on the head, framed by a count of the senders
+     * in flight so that closing can wait for them. The receiver walks the
+     * list from the tail and only parks when the mailbox is empty, senders
+     * only go to the parking lot if they see the receiver parked. Based on
+     * Dmitry Vyukov's non-blocking MPSC queue.
+     *
+     * Every message for which `push` returned true is received by a receiver
+     * popping until it gets nullptr, messages rejected by a closed mailbox
+     * are destroyed by `push`.
+     */
+    template<typename T>
+    class mailbox {
+        static_assert(std::is_base_of<mailbox_node, T>::value, "Message type must derive from mailbox_node");
+    public:
+        typedef T value_type;
+        typedef std::unique_ptr<T> pointer;
+
+        mailbox()
+        : head_(&stub_)
+        , tail_(&stub_)
+        , parked_(false)
+        , senders_(0)
+        {}
+
+        /// destructor, deletes messages never received
+        ~mailbox() {
+            bool busy;
+            while (T *m=take(busy)) delete m;
+        }
+
+        /**
+         * Sends a message, can be called from any thread
+         *
+         * @return false if the mailbox has been closed, the message is
+         * destroyed in this case
+         */
+        bool push(pointer msg) {
+            if (senders_.fetch_add(SENDER, boost::memory_order_acquire) & CLOSED) {
+                senders_.fetch_sub(SENDER, boost::memory_order_relaxed);
+                return false;
+            }
+            link(msg.release());
+            // The receiver of a closed mailbox looks once more after this
+            senders_.fetch_sub(SENDER, boost::memory_order_release);
+            // Pairs with the parked flag store in pop, either the receiver
+            // sees the message or we see the receiver parked
+            if (parked_.load() && parked_.exchange(false)) {
+                detail::unpark_one(&parked_);
+            }
+            return true;
+        }
+
+        /**
+         * Receives a message, blocks while the mailbox is empty, returns
+         * nullptr once the mailbox is closed and empty
+         *
+         * Must only be called by the receiving thread.
+         */
+        pointer pop() {
+            return pop_until(nullptr);
+        }
+
+        /**
+         * Receives a message without blocking
+         */
+        pointer try_pop() {
+            bool busy;
+            T *m;
+            // A sender between its exchange and its link will be done soon
+            while (!(m=take(busy)) && busy) yield();
+            return pointer(m);
+        }
+
+        /**
+         * Receives a message, returns nullptr if the mailbox is closed and
+         * empty or stays empty for the specified timeout duration
+         */
+        template<class Rep, class Period>
+        pointer try_pop_for(const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_duration);
+            return pop_until(&deadline);
+        }
+
+        /**
+         * Rejects further messages and wakes the receiver, messages already
+         * accepted by `push` can still be received, the receiver gets nullptr
+         * once all of them are
+         */
+        void close() {
+            senders_.fetch_or(CLOSED);
+            if (parked_.exchange(false)) {
+                detail::unpark_one(&parked_);
+            }
+        }
+
+        bool is_open() const {
+            return !(senders_.load() & CLOSED);
+        }
+
+        /**
+         * Returns true if no message is pending, only meaningful for the
+         * receiving thread
+         */
+        bool empty() const {
+            return tail_==&stub_ && head_.load()==&stub_;
+        }
+
+    private:
+        enum : std::size_t {
+            CLOSED=1,
+            // Unit of the count of senders between their check and their link
+            SENDER=2,
+        };
+
+        /// non-copyable, non-movable, messages point into the stub
+        mailbox(const mailbox &)=delete;
+        void operator=(const mailbox &)=delete;
+
+        static void yield() {
+            if (this_thread::is_a_thread()) {
+                this_thread::yield();
+            } else {
+                boost::this_thread::yield();
+            }
+        }
+
+        void link(mailbox_node *n) {
+            n->next_.store(nullptr, boost::memory_order_relaxed);
+            mailbox_node *prev=head_.exchange(n);
+            prev->next_.store(n, boost::memory_order_release);
+        }
+
+        /**
+         * Unlinks the oldest message, `busy` is set if a sender is still
+         * linking its message in
+         */
+        T *take(bool &busy) {
+            busy=false;
+            mailbox_node *tail=tail_;
+            mailbox_node *next=tail->next_.load(boost::memory_order_acquire);
+            if (tail==&stub_) {
+                if (!next) {
+                    busy=(head_.load()!=&stub_);
+                    return nullptr;
+                }
+                tail_=next;
+                tail=next;
+                next=next->next_.load(boost::memory_order_acquire);
+            }
+            if (next) {
+                tail_=next;
+                return static_cast<T *>(tail);
+            }
+            if (tail!=head_.load()) {
+                busy=true;
+                return nullptr;
+            }
+            // The tail is the last message, put the stub behind it so it can be unlinked
+            link(&stub_);
+            next=tail->next_.load(boost::memory_order_acquire);
+            if (next) {
+                tail_=next;
+                return static_cast<T *>(tail);
+            }
+            busy=true;
+            return nullptr;
+        }
+
+        struct parker : detail::park_handler {
+            explicit parker(const mailbox &m) : m_(m) {}
+            bool validate() override {
+                return m_.parked_.load() && m_.empty() && !(m_.senders_.load() & CLOSED);
+            }
+            const mailbox &m_;
+        };
+
+        pointer pop_until(const detail::time_point_t *deadline) {
+            for (;;) {
+                bool busy;
+                if (T *m=take(busy)) return pointer(m);
+                if (busy) {
+                    yield();
+                    continue;
+                }
+                const std::size_t s=senders_.load(boost::memory_order_acquire);
+                if (s & CLOSED) {
+                    // Senders which got in before the close are still linking
+                    if (s!=CLOSED) {
+                        yield();
+                        continue;
+                    }
+                    // They are all done, whatever they sent is visible now
+                    if (T *m=take(busy)) return pointer(m);
+                    if (!busy) return pointer();
+                    yield();
+                    continue;
+                }
+                if (deadline && boost::chrono::steady_clock::now()>=*deadline) {
+                    return pointer();
+                }
+                parked_.store(true);
+                if (empty() && !(senders_.load() & CLOSED)) {
+                    parker p(*this);
+                    detail::park(&parked_, p, deadline);
+                }
+                parked_.store(false);
+            }
+        }
+
+        boost::atomic<mailbox_node *> head_;
+        char padding0_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        mailbox_node *tail_;
+        mailbox_node stub_;
+        boost::atomic<bool> parked_;
+        // Closed flag and count of senders in flight
+        boost::atomic<std::size_t> senders_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
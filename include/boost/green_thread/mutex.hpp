@@ -13,18 +13,57 @@
 
 #include <deque>
 #include <memory>
+#include <cstdint>
+#include <boost/atomic.hpp>
 #include <boost/green_thread/detail/config.hpp>
 #include <boost/chrono/system_clocks.hpp>
 #include <boost/thread/lock_types.hpp>
 #include <boost/green_thread/detail/forward.hpp>
 #include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/detail/lock_profiler.hpp>
 
 namespace boost { namespace green_thread {
+    /**
+     * Ownership transfer policy of `mutex` and `recursive_mutex`
+     */
+    enum class lock_policy {
+        /**
+         * `unlock()` hands the ownership to the front waiter directly,
+         * waiters acquire the mutex in strict FIFO order
+         */
+        handoff,
+        /**
+         * `unlock()` releases the mutex and wakes the front waiter, which
+         * competes with running threads to acquire it, a waiter which has
+         * been waiting longer than the starvation threshold is handed the
+         * ownership directly
+         */
+        barging,
+    };
+    
     class BOOST_GREEN_THREAD_DECL mutex {
     public:
         /// constructor
         mutex()=default;
         
+        /**
+         * constructor, creates a mutex with specified ownership transfer
+         * policy and default starvation threshold
+         */
+        explicit mutex(lock_policy policy)
+        : policy_(policy)
+        {}
+        
+        /**
+         * constructor, creates a mutex with specified ownership transfer
+         * policy and starvation threshold
+         */
+        template<class Rep, class Period>
+        mutex(lock_policy policy, const boost::chrono::duration<Rep,Period>& starvation_threshold)
+        : policy_(policy)
+        , starvation_threshold_(boost::chrono::duration_cast<detail::duration_t>(starvation_threshold))
+        {}
+        
         /**
          * locks the mutex, blocks if the mutex is not available
          */
@@ -45,7 +84,16 @@ namespace boost { namespace green_thread {
         void operator=(const mutex&) = delete;
         detail::spinlock mtx_;
         detail::thread_ptr_t owner_;
-        std::deque<detail::thread_ptr_t> suspended_;
+        struct suspended_item {
+            detail::thread_ptr_t f_;
+            detail::time_point_t since_;
+        };
+        std::deque<suspended_item> suspended_;
+        lock_policy policy_=lock_policy::handoff;
+        detail::duration_t starvation_threshold_=boost::chrono::milliseconds(1);
+        // A barging waiter has been woken and hasn't competed yet
+        bool waking_=false;
+        detail::lock_profile_point profile_;
         friend struct condition_variable;
     };
     
@@ -102,6 +150,7 @@ namespace boost { namespace green_thread {
             bool operator==(detail::thread_ptr_t f) const { return f_==f; }
         };
         std::deque<suspended_item> suspended_;
+        detail::lock_profile_point profile_;
     };
     
     class BOOST_GREEN_THREAD_DECL recursive_mutex {
@@ -109,6 +158,24 @@ namespace boost { namespace green_thread {
         /// constructor
         recursive_mutex()=default;
 
+        /**
+         * constructor, creates a mutex with specified ownership transfer
+         * policy and default starvation threshold
+         */
+        explicit recursive_mutex(lock_policy policy)
+        : policy_(policy)
+        {}
+        
+        /**
+         * constructor, creates a mutex with specified ownership transfer
+         * policy and starvation threshold
+         */
+        template<class Rep, class Period>
+        recursive_mutex(lock_policy policy, const boost::chrono::duration<Rep,Period>& starvation_threshold)
+        : policy_(policy)
+        , starvation_threshold_(boost::chrono::duration_cast<detail::duration_t>(starvation_threshold))
+        {}
+
         /**
          * locks the mutex, blocks if the mutex is not available
          */
@@ -132,7 +199,16 @@ namespace boost { namespace green_thread {
         detail::spinlock mtx_;
         size_t level_=0;
         detail::thread_ptr_t owner_;
-        std::deque<detail::thread_ptr_t> suspended_;
+        struct suspended_item {
+            detail::thread_ptr_t f_;
+            detail::time_point_t since_;
+        };
+        std::deque<suspended_item> suspended_;
+        lock_policy policy_=lock_policy::handoff;
+        detail::duration_t starvation_threshold_=boost::chrono::milliseconds(1);
+        // A barging waiter has been woken and hasn't competed yet
+        bool waking_=false;
+        detail::lock_profile_point profile_;
     };
     
     class BOOST_GREEN_THREAD_DECL recursive_timed_mutex {
@@ -188,6 +264,110 @@ namespace boost { namespace green_thread {
             bool operator==(detail::thread_ptr_t f) const { return f_==f; }
         };
         std::deque<suspended_item> suspended_;
+        detail::lock_profile_point profile_;
+    };
+    
+    /**
+     * Mutex shared by green threads and foreign threads
+     *
+     * The state is a single atomic word, locking and unlocking take one CAS
+     * when uncontended. Contending green threads park their coroutine and
+     * foreign threads block on a native event, both in the same address keyed
+     * wait queue, so the ownership can be handed over across both of them
+     * without blocking worker threads on an OS lock.
+     */
+    class BOOST_GREEN_THREAD_DECL hybrid_mutex {
+    public:
+        /// constructor
+        hybrid_mutex()
+        : state_(0)
+        {}
+        
+        /**
+         * constructor, creates a mutex with specified ownership transfer
+         * policy and default starvation threshold
+         */
+        explicit hybrid_mutex(lock_policy policy)
+        : state_(0)
+        , policy_(policy)
+        {}
+        
+        /**
+         * constructor, creates a mutex with specified ownership transfer
+         * policy and starvation threshold
+         */
+        template<class Rep, class Period>
+        hybrid_mutex(lock_policy policy, const boost::chrono::duration<Rep,Period>& starvation_threshold)
+        : state_(0)
+        , policy_(policy)
+        , starvation_threshold_(boost::chrono::duration_cast<detail::duration_t>(starvation_threshold))
+        {}
+        
+        /**
+         * locks the mutex, blocks if the mutex is not available
+         */
+        void lock() {
+            uint8_t expected=0;
+            if (!state_.compare_exchange_strong(expected, LOCKED, boost::memory_order_acquire, boost::memory_order_relaxed)) {
+                lock_slow(nullptr);
+            }
+        }
+        
+        /**
+         * tries to lock the mutex, returns if the mutex is not available
+         */
+        bool try_lock();
+        
+        /**
+         * tries to lock the mutex, returns if the mutex has been
+         * unavailable for the specified timeout duration
+         */
+        template<class Rep, class Period>
+        bool try_lock_for(const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            return try_lock_until(boost::chrono::steady_clock::now()+timeout_duration);
+        }
+        
+        /**
+         * tries to lock the mutex, returns if the mutex has been
+         * unavailable until specified time point has been reached
+         */
+        template<class Clock, class Duration>
+        bool try_lock_until(const boost::chrono::time_point<Clock,Duration>& timeout_time) {
+            if (try_lock()) return true;
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_time-Clock::now());
+            return lock_slow(&deadline);
+        }
+        
+        /**
+         * unlocks the mutex
+         */
+        void unlock() {
+            uint8_t expected=LOCKED;
+            if (!state_.compare_exchange_strong(expected, 0, boost::memory_order_release, boost::memory_order_relaxed)) {
+                unlock_slow();
+            }
+        }
+        
+    private:
+        /// non-copyable
+        hybrid_mutex(const hybrid_mutex&) = delete;
+        void operator=(const hybrid_mutex&) = delete;
+        
+        bool lock_slow(const detail::time_point_t *deadline);
+        void unlock_slow();
+        
+        struct parker;
+        struct unparker;
+        struct waker;
+        
+        enum : uint8_t { LOCKED=1, PARKED=2 };
+        boost::atomic<uint8_t> state_;
+        lock_policy policy_=lock_policy::barging;
+        detail::duration_t starvation_threshold_=boost::chrono::milliseconds(1);
+        // Next time a barging unlock hands the ownership over, only accessed
+        // with the parking lot bucket locked
+        detail::time_point_t fair_at_;
     };
 }}  // End of namespace boost::green_thread
 
@@ -0,0 +1,623 @@
+//
+//  pipeline.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_PIPELINE_HPP
+#define BOOST_GREEN_THREAD_PIPELINE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/green_thread/exceptions.hpp>
+#include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/mutex.hpp>
+#include <boost/green_thread/semaphore.hpp>
+#include <boost/green_thread/concurrent_queue.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+
+namespace boost { namespace green_thread {
+    /// Counters of a pipeline stage
+    struct pipeline_stage_stats {
+        std::string name;
+        size_t parallelism;
+        /// items done
+        uint64_t items;
+        /// time spent in the stage function, summed over the workers
+        detail::duration_t busy;
+        /// time the workers spent waiting for input
+        detail::duration_t starved;
+        /// time the workers spent waiting for room in the next stage
+        detail::duration_t blocked;
+        /// since the pipeline started, until it finished
+        detail::duration_t elapsed;
+
+        /// items per second
+        double throughput() const {
+            const double s=boost::chrono::duration<double>(elapsed).count();
+            return s>0 ? items/s : 0;
+        }
+
+        /// mean time the stage function takes on an item
+        detail::duration_t latency() const {
+            return items>0 ? busy/static_cast<detail::duration_t::rep>(items) : detail::duration_t::zero();
+        }
+
+        /// fraction of the time the workers were busy, the bottleneck is the stage closest to 1
+        double utilization() const {
+            const double total=boost::chrono::duration<double>(elapsed).count()*parallelism;
+            return total>0 ? boost::chrono::duration<double>(busy).count()/total : 0;
+        }
+    };
+
+    namespace detail {
+        template<typename T>
+        struct pipeline_item {
+            /// position in the input, used to restore the order
+            size_t seq;
+            T value;
+        };
+
+        template<typename T>
+        using pipeline_batch=std::vector<pipeline_item<T>>;
+
+        /// Stages pass batches, the capacity is counted in batches
+        template<typename T>
+        using pipeline_channel=concurrent_queue<pipeline_batch<T>>;
+
+        /// Placeholder for the output of a pipeline ending with a sink
+        struct pipeline_none {};
+
+        template<typename T>
+        struct pipeline_value { typedef T type; };
+
+        template<>
+        struct pipeline_value<void> { typedef pipeline_none type; };
+
+        /// Type of the items coming out of `Fn` called on items of type `T`
+        template<typename Fn, typename T>
+        struct pipeline_result {
+            typedef typename std::decay<typename std::result_of<Fn&(T&&)>::type>::type type;
+        };
+
+        template<typename Fn>
+        struct pipeline_result<Fn, void> {};
+
+        /**
+         * Items arriving in any order, handed out by increasing sequence
+         * number without gaps
+         *
+         * Slot `i` of the window holds sequence number `next_+i`. The window
+         * is bounded by the items `pipeline::push` lets in, see
+         * `pipeline_core::window_`.
+         */
+        template<typename T>
+        class reorder_buffer {
+        public:
+            reorder_buffer()
+            : next_(0)
+            {}
+
+            void put(size_t seq, T &&v) {
+                const size_t i=seq-next_;
+                if (i>=window_.size()) window_.resize(i+1);
+                window_[i]=std::move(v);
+            }
+
+            /**
+             * Calls `f(seq, value)` on the items which are next in order,
+             * returns how many
+             */
+            template<typename F>
+            size_t drain(F f) {
+                size_t n=0;
+                while (!window_.empty() && window_.front()) {
+                    f(next_, std::move(*window_.front()));
+                    window_.pop_front();
+                    next_++;
+                    n++;
+                }
+                return n;
+            }
+
+        private:
+            std::deque<boost::optional<T>> window_;
+            size_t next_;
+        };
+
+        struct pipeline_core;
+
+        struct pipeline_stage_base {
+            pipeline_stage_base(pipeline_core &core, const std::string &name, size_t parallelism, bool ordered)
+            : core_(core)
+            , name_(name)
+            , parallelism_(parallelism)
+            , ordered_(ordered)
+            , window_end_(false)
+            , items_(0)
+            , busy_(0)
+            , starved_(0)
+            , blocked_(0)
+            {}
+
+            virtual ~pipeline_stage_base() {}
+
+            /// Body of the worker threads
+            virtual void work()=0;
+
+            pipeline_stage_stats stats(duration_t elapsed) const {
+                return pipeline_stage_stats{name_,
+                                            parallelism_,
+                                            items_.load(boost::memory_order_relaxed),
+                                            duration_t(busy_.load(boost::memory_order_relaxed)),
+                                            duration_t(starved_.load(boost::memory_order_relaxed)),
+                                            duration_t(blocked_.load(boost::memory_order_relaxed)),
+                                            elapsed};
+            }
+
+            static void add(boost::atomic<duration_t::rep> &counter, duration_t d) {
+                counter.fetch_add(d.count(), boost::memory_order_relaxed);
+            }
+
+            /// Lets `n` more items into the pipeline if this stage ends the window
+            void leave_window(size_t n);
+
+            pipeline_core &core_;
+            std::string name_;
+            size_t parallelism_;
+            bool ordered_;
+            /// last ordered stage, items drained from its reorder buffer leave the window
+            bool window_end_;
+            boost::atomic<uint64_t> items_;
+            boost::atomic<duration_t::rep> busy_;
+            boost::atomic<duration_t::rep> starved_;
+            boost::atomic<duration_t::rep> blocked_;
+        };
+
+        struct pipeline_core {
+            pipeline_core(size_t capacity, size_t batch)
+            : capacity_(capacity)
+            , batch_(batch)
+            , window_size_(capacity*batch)
+            , failed_(false)
+            , started_(false)
+            , finished_(false)
+            {}
+
+            /// Keeps the first error and closes every channel so all workers stop
+            void fail(std::exception_ptr e) {
+                {
+                    boost::lock_guard<spinlock> lock(error_mtx_);
+                    if (!error_) error_=e;
+                }
+                abort();
+            }
+
+            void abort() {
+                failed_.store(true, boost::memory_order_relaxed);
+                for (auto &c : closers_) c();
+                // Wakes `push` waiting for room, it sees the failure next time
+                if (window_) window_->release(window_size_);
+            }
+
+            duration_t elapsed() const {
+                if (!started_) return duration_t::zero();
+                return (finished_ ? finish_time_ : boost::chrono::steady_clock::now())-start_time_;
+            }
+
+            size_t capacity_;
+            size_t batch_;
+            /**
+             * Items pushed and not yet past the last ordered stage, bounding
+             * the reorder buffers, `push` blocks past it, null without an
+             * ordered stage
+             *
+             * An ordered stage can't stop taking items while it waits for
+             * the next one in order, which may still be behind them, so the
+             * bound is put on the input instead.
+             */
+            std::unique_ptr<counting_semaphore> window_;
+            size_t window_size_;
+            std::vector<std::unique_ptr<pipeline_stage_base>> stages_;
+            std::vector<std::function<void()>> closers_;
+            std::vector<thread> threads_;
+            boost::atomic<bool> failed_;
+            spinlock error_mtx_;
+            std::exception_ptr error_;
+            bool started_;
+            bool finished_;
+            time_point_t start_time_;
+            time_point_t finish_time_;
+        };
+
+        /// Stage mapping every item with `fn`
+        template<typename In, typename Out, typename Fn>
+        struct pipeline_stage : pipeline_stage_base {
+            pipeline_stage(pipeline_core &core,
+                           const std::string &name,
+                           size_t parallelism,
+                           bool ordered,
+                           Fn &&fn,
+                           std::shared_ptr<pipeline_channel<In>> in,
+                           std::shared_ptr<pipeline_channel<Out>> out)
+            : pipeline_stage_base(core, name, parallelism, ordered)
+            , fn_(std::move(fn))
+            , in_(std::move(in))
+            , out_(std::move(out))
+            , live_(parallelism)
+            {}
+
+            void work() override {
+                pipeline_batch<In> in;
+                pipeline_batch<Out> out;
+                for (;;) {
+                    const time_point_t t0=boost::chrono::steady_clock::now();
+                    in.clear();
+                    const bool got=in_->pop(in);
+                    const time_point_t t1=boost::chrono::steady_clock::now();
+                    add(starved_, t1-t0);
+                    if (!got || core_.failed_.load(boost::memory_order_relaxed)) break;
+                    out.reserve(in.size());
+                    std::exception_ptr error;
+                    try {
+                        for (auto &item : in) {
+                            out.push_back(pipeline_item<Out>{item.seq, fn_(std::move(item.value))});
+                        }
+                    } catch(...) {
+                        error=std::current_exception();
+                    }
+                    const time_point_t t2=boost::chrono::steady_clock::now();
+                    add(busy_, t2-t1);
+                    items_.fetch_add(out.size(), boost::memory_order_relaxed);
+                    if (error) {
+                        core_.fail(error);
+                        break;
+                    }
+                    const bool ok=ordered_ ? emit_ordered(out) : out_->push(std::move(out));
+                    out.clear();
+                    add(blocked_, boost::chrono::steady_clock::now()-t2);
+                    if (!ok) break;
+                }
+                if (live_.fetch_sub(1, boost::memory_order_acq_rel)==1) out_->close();
+            }
+
+            /// Passes on the items which are next in order, in batches
+            bool emit_ordered(pipeline_batch<Out> &out) {
+                // Pushing under the lock keeps the batches of different workers in order
+                boost::lock_guard<mutex> lock(order_mtx_);
+                for (auto &item : out) reorder_.put(item.seq, std::move(item.value));
+                out.clear();
+                bool ok=true;
+                const size_t n=reorder_.drain([&](size_t seq, Out &&v){
+                    out.push_back(pipeline_item<Out>{seq, std::move(v)});
+                    if (out.size()>=core_.batch_) {
+                        ok=out_->push(std::move(out)) && ok;
+                        out.clear();
+                    }
+                });
+                if (!out.empty()) ok=out_->push(std::move(out)) && ok;
+                leave_window(n);
+                return ok;
+            }
+
+            Fn fn_;
+            std::shared_ptr<pipeline_channel<In>> in_;
+            std::shared_ptr<pipeline_channel<Out>> out_;
+            /// workers still running, the last one closes the output
+            boost::atomic<size_t> live_;
+            mutex order_mtx_;
+            reorder_buffer<Out> reorder_;
+        };
+
+        /// Last stage, consuming every item with `fn`
+        template<typename In, typename Fn>
+        struct pipeline_stage<In, void, Fn> : pipeline_stage_base {
+            pipeline_stage(pipeline_core &core,
+                           const std::string &name,
+                           size_t parallelism,
+                           bool ordered,
+                           Fn &&fn,
+                           std::shared_ptr<pipeline_channel<In>> in,
+                           std::shared_ptr<pipeline_channel<pipeline_none>>)
+            : pipeline_stage_base(core, name, parallelism, ordered)
+            , fn_(std::move(fn))
+            , in_(std::move(in))
+            {}
+
+            void work() override {
+                pipeline_batch<In> in;
+                for (;;) {
+                    const time_point_t t0=boost::chrono::steady_clock::now();
+                    in.clear();
+                    const bool got=in_->pop(in);
+                    const time_point_t t1=boost::chrono::steady_clock::now();
+                    add(starved_, t1-t0);
+                    if (!got || core_.failed_.load(boost::memory_order_relaxed)) break;
+                    std::exception_ptr error;
+                    size_t n=0;
+                    try {
+                        if (ordered_) {
+                            // Items are consumed in order, one worker at a time
+                            boost::lock_guard<mutex> lock(order_mtx_);
+                            for (auto &item : in) reorder_.put(item.seq, std::move(item.value));
+                            leave_window(reorder_.drain([&](size_t, In &&v){
+                                fn_(std::move(v));
+                                n++;
+                            }));
+                        } else {
+                            for (auto &item : in) {
+                                fn_(std::move(item.value));
+                                n++;
+                            }
+                        }
+                    } catch(...) {
+                        error=std::current_exception();
+                    }
+                    add(busy_, boost::chrono::steady_clock::now()-t1);
+                    items_.fetch_add(n, boost::memory_order_relaxed);
+                    if (error) {
+                        core_.fail(error);
+                        break;
+                    }
+                }
+            }
+
+            Fn fn_;
+            std::shared_ptr<pipeline_channel<In>> in_;
+            mutex order_mtx_;
+            reorder_buffer<In> reorder_;
+        };
+
+        inline void pipeline_stage_base::leave_window(size_t n) {
+            if (window_end_ && n>0) core_.window_->release(n);
+        }
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Chain of stages connected by bounded channels, items of type `In`
+     * are pushed into the first stage, items of type `Out` come out of the
+     * last one, `Out` is `void` if the last stage is a sink
+     *
+     * Each stage runs a function on every item on a number of green
+     * threads. Items move between stages in batches of up to `batch`
+     * items, a channel holds at most `capacity` batches, a stage which
+     * can't keep up blocks the stages before it and eventually `push`.
+     *
+     * Stage functions map one item to exactly one item. Items are numbered
+     * when pushed, an ordered stage passes them on in that order, whatever
+     * order its workers finish them. With an ordered stage, at most
+     * `capacity*batch` items are between `push` and the last ordered
+     * stage, which bounds the items an ordered stage holds back, `push`
+     * blocks until earlier items get through.
+     *
+     * ~~~
+     * auto p=pipeline<std::string>()
+     *     .stage("parse", parse, 4, true)
+     *     .stage("write", write);
+     * p.start();
+     * while (std::getline(is, line)) p.push(line);
+     * p.close();
+     * p.wait();
+     * ~~~
+     */
+    template<typename In, typename Out=In>
+    class pipeline {
+        typedef typename detail::pipeline_value<Out>::type value_type;
+
+    public:
+        typedef In input_type;
+        typedef Out output_type;
+
+        explicit pipeline(size_t capacity=8, size_t batch=32)
+        : core_(new detail::pipeline_core(std::max(capacity, size_t(1)), std::max(batch, size_t(1))))
+        , head_(std::make_shared<detail::pipeline_channel<In>>(core_->capacity_))
+        , next_seq_(0)
+        , popped_pos_(0)
+        {
+            static_assert(std::is_same<In, Out>::value, "pipeline starts with the type of its input");
+            // With no stage the pipeline passes the items through
+            tail_=head_;
+            add_closer(head_);
+        }
+
+        pipeline(pipeline &&)=default;
+
+        /// Stops and joins the workers if `wait` hasn't been called
+        ~pipeline() {
+            if (!core_ || !core_->started_ || core_->finished_) return;
+            core_->abort();
+            join();
+        }
+
+        /**
+         * Appends a stage calling `fn` on every item on `parallelism`
+         * threads, a stage function returning `void` ends the pipeline
+         *
+         * `fn` is called concurrently if `parallelism` is more than 1. If
+         * `ordered` is true, the items leave the stage in the order they
+         * entered the pipeline, or for the last stage, `fn` is called in
+         * that order. `*this` is moved into the returned pipeline.
+         */
+        template<typename Fn, typename R=typename detail::pipeline_result<Fn, Out>::type>
+        pipeline<In, R> stage(const std::string &name, Fn fn, size_t parallelism=1, bool ordered=false) {
+            static_assert(!std::is_void<Out>::value, "pipeline already ends with a sink");
+            if (!core_ || core_->started_) BOOST_THROW_EXCEPTION(invalid_argument(boost::system::errc::operation_not_permitted));
+            typedef typename detail::pipeline_value<R>::type next_type;
+            std::shared_ptr<detail::pipeline_channel<next_type>> out;
+            if (!std::is_void<R>::value) out=std::make_shared<detail::pipeline_channel<next_type>>(core_->capacity_);
+            core_->stages_.emplace_back(new detail::pipeline_stage<Out, R, Fn>(*core_,
+                                                                              name,
+                                                                              std::max(parallelism, size_t(1)),
+                                                                              ordered,
+                                                                              std::move(fn),
+                                                                              tail_,
+                                                                              out));
+            pipeline<In, R> ret(std::move(*this));
+            ret.tail_=out;
+            if (out) ret.add_closer(out);
+            return ret;
+        }
+
+        /// Starts the workers, must be called from a green thread
+        void start() {
+            if (!core_ || core_->started_) BOOST_THROW_EXCEPTION(invalid_argument(boost::system::errc::operation_not_permitted));
+            core_->started_=true;
+            core_->start_time_=boost::chrono::steady_clock::now();
+            for (auto i=core_->stages_.rbegin(); i!=core_->stages_.rend(); ++i) {
+                if (!(*i)->ordered_) continue;
+                (*i)->window_end_=true;
+                core_->window_.reset(new counting_semaphore(core_->window_size_));
+                break;
+            }
+            for (auto &s : core_->stages_) {
+                detail::pipeline_stage_base *p=s.get();
+                for (size_t i=0; i<p->parallelism_; i++) {
+                    core_->threads_.emplace_back([p](){ p->work(); });
+                }
+            }
+        }
+
+        /**
+         * Adds an item, blocks while the first stage is full, returns false
+         * if the pipeline has been closed or has failed
+         *
+         * Items are passed on in batches, `flush` passes a partial batch.
+         * Must be called from one thread at a time.
+         */
+        bool push(const In &v) {
+            if (!enter_window()) return false;
+            pending_.push_back(detail::pipeline_item<In>{next_seq_++, v});
+            return pending_.size()<core_->batch_ || flush();
+        }
+
+        bool push(In &&v) {
+            if (!enter_window()) return false;
+            pending_.push_back(detail::pipeline_item<In>{next_seq_++, std::move(v)});
+            return pending_.size()<core_->batch_ || flush();
+        }
+
+        /// Passes on the items pushed so far
+        bool flush() {
+            if (pending_.empty()) return true;
+            const bool ok=head_->push(std::move(pending_));
+            pending_.clear();
+            return ok;
+        }
+
+        /// Ends the input, the stages finish the items pushed before
+        void close() {
+            flush();
+            head_->close();
+        }
+
+        /**
+         * Takes an item out of the last stage, blocks until one is
+         * available, returns false once the pipeline is done
+         *
+         * The last stage blocks while nobody pops. Must be called from one
+         * thread at a time.
+         */
+        template<typename T=Out>
+        typename std::enable_if<!std::is_void<T>::value, bool>::type pop(T &v) {
+            if (popped_pos_>=popped_.size()) {
+                popped_.clear();
+                popped_pos_=0;
+                if (!tail_->pop(popped_)) return false;
+            }
+            v=std::move(popped_[popped_pos_++].value);
+            return true;
+        }
+
+        /**
+         * Waits until every stage is done, rethrows the first exception
+         * thrown by a stage function
+         *
+         * `close` must have been called, and if the pipeline doesn't end
+         * with a sink, every item popped.
+         */
+        void wait() {
+            if (!core_ || !core_->started_ || core_->finished_) return;
+            join();
+            if (core_->error_) std::rethrow_exception(core_->error_);
+        }
+
+        /// Counters of every stage, can be read while running
+        std::vector<pipeline_stage_stats> stats() const {
+            std::vector<pipeline_stage_stats> ret;
+            const detail::duration_t elapsed=core_->elapsed();
+            for (auto &s : core_->stages_) ret.push_back(s->stats(elapsed));
+            return ret;
+        }
+
+        /// Index of the stage with the highest utilization
+        size_t bottleneck() const {
+            std::vector<pipeline_stage_stats> s=stats();
+            size_t ret=0;
+            for (size_t i=1; i<s.size(); i++) {
+                if (s[i].utilization()>s[ret].utilization()) ret=i;
+            }
+            return ret;
+        }
+
+    private:
+        template<typename, typename> friend class pipeline;
+
+        /// Takes over the stages of a pipeline one stage shorter
+        template<typename T>
+        explicit pipeline(pipeline<In, T> &&other)
+        : core_(std::move(other.core_))
+        , head_(std::move(other.head_))
+        , pending_(std::move(other.pending_))
+        , next_seq_(other.next_seq_)
+        , popped_pos_(0)
+        {}
+
+        /// Waits for room for one more item if there is an ordered stage
+        bool enter_window() {
+            if (!core_->window_) return true;
+            if (core_->failed_.load(boost::memory_order_relaxed)) return false;
+            core_->window_->acquire();
+            return true;
+        }
+
+        template<typename T>
+        void add_closer(const std::shared_ptr<detail::pipeline_channel<T>> &c) {
+            core_->closers_.push_back([c](){ c->close(); });
+        }
+
+        void join() {
+            for (auto &t : core_->threads_) t.join();
+            core_->finished_=true;
+            core_->finish_time_=boost::chrono::steady_clock::now();
+        }
+
+        std::unique_ptr<detail::pipeline_core> core_;
+        std::shared_ptr<detail::pipeline_channel<In>> head_;
+        std::shared_ptr<detail::pipeline_channel<value_type>> tail_;
+        /// batch being filled by `push`
+        detail::pipeline_batch<In> pending_;
+        size_t next_seq_;
+        /// batch being emptied by `pop`
+        detail::pipeline_batch<value_type> popped_;
+        size_t popped_pos_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
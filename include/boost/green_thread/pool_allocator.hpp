@@ -0,0 +1,93 @@
+//
+//  pool_allocator.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_POOL_ALLOCATOR_HPP
+#define BOOST_GREEN_THREAD_POOL_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <boost/config.hpp>
+#include <boost/green_thread/detail/config.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        /**
+         * Allocates from the free list of the size class of `bytes` kept by
+         * the calling worker thread, falls back to `operator new` for large
+         * blocks and when the free list is empty
+         */
+        BOOST_GREEN_THREAD_DECL void *pool_allocate(std::size_t bytes);
+        
+        /**
+         * Returns a block to the free list of the calling worker thread,
+         * `bytes` must be the size it was allocated with
+         */
+        BOOST_GREEN_THREAD_DECL void pool_deallocate(void *p, std::size_t bytes) noexcept;
+    }   // End of namespace boost::green_thread::detail
+    
+    /**
+     * Allocator over per-worker size-class pools
+     *
+     * Small objects which are allocated and freed at a high rate, like the
+     * shared states of futures, are recycled by the worker thread without
+     * going to the global allocator. Blocks freed by another worker go to
+     * that worker's pool, every pool keeps a bounded number of blocks.
+     */
+    template<typename T>
+    class pool_allocator {
+    public:
+        typedef T value_type;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+        
+        template<typename U>
+        struct rebind {
+            typedef pool_allocator<U> other;
+        };
+        
+        BOOST_CONSTEXPR pool_allocator() noexcept {}
+        
+        template<typename U>
+        BOOST_CONSTEXPR pool_allocator(const pool_allocator<U> &) noexcept {}
+        
+        T *allocate(std::size_t n) {
+            return static_cast<T *>(detail::pool_allocate(n*sizeof(T)));
+        }
+        
+        void deallocate(T *p, std::size_t n) noexcept {
+            detail::pool_deallocate(p, n*sizeof(T));
+        }
+        
+        template<typename U, typename... Args>
+        void construct(U *p, Args&&... args) {
+            ::new(static_cast<void *>(p)) U(std::forward<Args>(args)...);
+        }
+        
+        template<typename U>
+        void destroy(U *p) {
+            p->~U();
+        }
+    };
+    
+    template<typename T, typename U>
+    inline bool operator==(const pool_allocator<T> &, const pool_allocator<U> &) noexcept {
+        return true;
+    }
+    
+    template<typename T, typename U>
+    inline bool operator!=(const pool_allocator<T> &, const pool_allocator<U> &) noexcept {
+        return false;
+    }
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -0,0 +1,238 @@
+//
+//  select.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_SELECT_HPP
+#define BOOST_GREEN_THREAD_SELECT_HPP
+
+#include <memory>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/select_state.hpp>
+#include <boost/green_thread/future/future.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        struct select_case {
+            virtual ~select_case() {}
+
+            /**
+             * Completes the operation if the source is ready, `ok` is false
+             * if the source has been closed
+             */
+            virtual bool try_complete(bool &ok)=0;
+
+            /// Asks the source to signal `state` when it may become ready
+            virtual void subscribe(select_state &state)=0;
+
+            virtual void unsubscribe()=0;
+        };
+
+        template<typename Queue>
+        struct pop_case : select_case {
+            pop_case(Queue &q, typename Queue::value_type &out)
+            : q_(q)
+            , out_(out)
+            {
+                obs_.events_=select_observer::READABLE;
+            }
+
+            bool try_complete(bool &ok) override {
+                if (q_.try_pop(out_)) return ok=true;
+                if (q_.is_open()) return false;
+                // Closed, nothing can be pushed anymore but leftovers may be there
+                ok=q_.try_pop(out_);
+                return true;
+            }
+
+            void subscribe(select_state &state) override {
+                obs_.state_=&state;
+                q_.add_observer(&obs_);
+            }
+
+            void unsubscribe() override {
+                q_.remove_observer(&obs_);
+            }
+
+            Queue &q_;
+            typename Queue::value_type &out_;
+            select_observer obs_;
+        };
+
+        template<typename Queue>
+        struct push_case : select_case {
+            template<typename U>
+            push_case(Queue &q, U &&v)
+            : q_(q)
+            , value_(std::forward<U>(v))
+            {
+                obs_.events_=select_observer::WRITABLE;
+            }
+
+            bool try_complete(bool &ok) override {
+                if (!q_.is_open()) {
+                    ok=false;
+                    return true;
+                }
+                // Pushes a copy so the selector can be waited again
+                return ok=q_.try_push(value_);
+            }
+
+            void subscribe(select_state &state) override {
+                obs_.state_=&state;
+                q_.add_observer(&obs_);
+            }
+
+            void unsubscribe() override {
+                q_.remove_observer(&obs_);
+            }
+
+            Queue &q_;
+            typename Queue::value_type value_;
+            select_observer obs_;
+        };
+
+        struct ready_case : select_case {
+            ready_case()
+            : ready_(std::make_shared<boost::atomic<bool>>(false))
+            {}
+
+            bool try_complete(bool &ok) override {
+                return ok=ready_->load();
+            }
+
+            // The future signals the selector directly, see `selector::on_ready`
+            void subscribe(select_state &) override {}
+
+            void unsubscribe() override {}
+
+            std::shared_ptr<boost::atomic<bool>> ready_;
+        };
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Waits on several sources at once, like Go's `select` statement
+     *
+     * Cases are registered once and the selector can be waited repeatedly.
+     * A wait completes exactly one ready case and returns its index, the
+     * calling thread parks once per round no matter how many sources are
+     * watched, and is woken by whichever source fires first. Channels must
+     * be lock-based `concurrent_queue`s.
+     *
+     *     selector sel;
+     *     int v;
+     *     size_t from_q1=sel.on_pop(q1, v);
+     *     size_t to_q2=sel.on_push(q2, 42);
+     *     size_t stop=sel.on_ready(stop_future);
+     *     size_t i=sel.wait_for(boost::chrono::seconds(1));
+     */
+    class BOOST_GREEN_THREAD_DECL selector {
+    public:
+        /// returned by timed and non-blocking waits if no case is ready
+        static constexpr size_t timeout=size_t(-1);
+
+        /// constructor
+        selector();
+
+        /// destructor
+        ~selector();
+
+        /**
+         * Adds a case popping from `q` into `out`, the case completes with
+         * `ok()==false` if the queue is closed and empty
+         */
+        template<typename Queue>
+        size_t on_pop(Queue &q, typename Queue::value_type &out) {
+            return add_case(std::unique_ptr<detail::select_case>(new detail::pop_case<Queue>(q, out)));
+        }
+
+        /**
+         * Adds a case pushing a copy of `v` into `q`, the case completes with
+         * `ok()==false` if the queue is closed
+         */
+        template<typename Queue, typename U>
+        size_t on_push(Queue &q, U &&v) {
+            return add_case(std::unique_ptr<detail::select_case>(new detail::push_case<Queue>(q, std::forward<U>(v))));
+        }
+
+        /**
+         * Adds a case completing once the future is ready
+         */
+        template<typename Future>
+        size_t on_ready(Future &f) {
+            std::unique_ptr<detail::ready_case> c(new detail::ready_case);
+            auto ready=c->ready_;
+            // Sources don't keep the selector alive, only the shared state
+            std::weak_ptr<detail::select_state> state(state_);
+            f.state_->add_external_waiter([ready, state](){
+                ready->store(true);
+                if (auto s=state.lock()) s->signal();
+            });
+            return add_case(std::move(c));
+        }
+
+        /**
+         * Completes a ready case without blocking, returns `timeout` if none
+         * is ready
+         */
+        size_t try_select();
+
+        /**
+         * Blocks until a case completes and returns its index
+         */
+        size_t wait() {
+            return select_until(nullptr);
+        }
+
+        /**
+         * Blocks until a case completes or the specified timeout duration
+         * elapses, returns `timeout` in the latter case
+         */
+        template<class Rep, class Period>
+        size_t wait_for(const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            return wait_until(boost::chrono::steady_clock::now()+timeout_duration);
+        }
+
+        /**
+         * Blocks until a case completes or specified time point has been
+         * reached, returns `timeout` in the latter case
+         */
+        template<class Clock, class Duration>
+        size_t wait_until(const boost::chrono::time_point<Clock,Duration>& timeout_time) {
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_time-Clock::now());
+            return select_until(&deadline);
+        }
+
+        /**
+         * Returns false if the last completed case found its source closed
+         */
+        bool ok() const {
+            return ok_;
+        }
+
+    private:
+        /// non-copyable
+        selector(const selector&) = delete;
+        void operator=(const selector&) = delete;
+
+        size_t add_case(std::unique_ptr<detail::select_case> c);
+        size_t select_until(const detail::time_point_t *deadline);
+
+        std::shared_ptr<detail::select_state> state_;
+        std::vector<std::unique_ptr<detail::select_case>> cases_;
+        size_t next_=0;
+        bool ok_=false;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
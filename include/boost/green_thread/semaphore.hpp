@@ -0,0 +1,111 @@
+//
+//  semaphore.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_SEMAPHORE_HPP
+#define BOOST_GREEN_THREAD_SEMAPHORE_HPP
+
+#include <cstddef>
+#include <limits>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/detail/waiter.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Counting semaphore
+     *
+     * Acquiring and releasing take a CAS on the counter when nobody waits,
+     * waiters are parked in FIFO order and a release wakes as many of them as
+     * the released units can satisfy in one pass. Can be used by both green
+     * threads and foreign threads.
+     */
+    class BOOST_GREEN_THREAD_DECL counting_semaphore {
+    public:
+        /**
+         * constructor, initializes the internal counter with `desired`
+         */
+        explicit counting_semaphore(std::ptrdiff_t desired);
+
+        /**
+         * returns the maximum possible value of the internal counter
+         */
+        static constexpr std::ptrdiff_t max() noexcept {
+            return std::numeric_limits<std::ptrdiff_t>::max();
+        }
+
+        /**
+         * increments the internal counter by `update` and wakes waiters
+         * whose requests can be satisfied
+         */
+        void release(std::ptrdiff_t update=1);
+
+        /**
+         * decrements the internal counter by `n`, blocks until the counter
+         * is large enough
+         */
+        void acquire(std::ptrdiff_t n=1);
+
+        /**
+         * tries to decrement the internal counter by `n` without blocking
+         */
+        bool try_acquire(std::ptrdiff_t n=1) noexcept;
+
+        /**
+         * tries to decrement the internal counter by `n`, returns false if
+         * the counter has been too small for the specified timeout duration
+         */
+        template<class Rep, class Period>
+        bool try_acquire_for(const boost::chrono::duration<Rep,Period>& timeout_duration, std::ptrdiff_t n=1) {
+            return try_acquire_until(boost::chrono::steady_clock::now()+timeout_duration, n);
+        }
+
+        /**
+         * tries to decrement the internal counter by `n`, returns false if
+         * the counter has been too small until specified time point has been reached
+         */
+        template<class Clock, class Duration>
+        bool try_acquire_until(const boost::chrono::time_point<Clock,Duration>& timeout_time, std::ptrdiff_t n=1) {
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_time-Clock::now());
+            return acquire_slow(n, &deadline);
+        }
+
+        /**
+         * returns the current value of the internal counter
+         */
+        std::ptrdiff_t available() const noexcept {
+            return count_.load(boost::memory_order_relaxed);
+        }
+
+    private:
+        /// non-copyable
+        counting_semaphore(const counting_semaphore&) = delete;
+        void operator=(const counting_semaphore&) = delete;
+
+        struct acquirer : detail::waiter {
+            explicit acquirer(std::ptrdiff_t n) : n_(n) {}
+            std::ptrdiff_t n_;
+        };
+
+        bool try_take(std::ptrdiff_t n) noexcept;
+        bool acquire_slow(std::ptrdiff_t n, const detail::time_point_t *deadline);
+        void dispatch();
+
+        boost::atomic<std::ptrdiff_t> count_;
+        boost::atomic<size_t> waiters_;
+        detail::spinlock mtx_;
+        detail::waiter_queue queue_;
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -16,6 +16,8 @@
 #define BOOST_GREEN_THREAD_SHARED_MUTEX_HPP
 
 #include <mutex>
+#include <cstdint>
+#include <boost/atomic.hpp>
 #include <boost/green_thread/exceptions.hpp>
 #include <boost/green_thread/mutex.hpp>
 #include <boost/green_thread/condition_variable.hpp>
@@ -140,10 +142,13 @@ namespace boost { namespace green_thread {
          */
         void lock_shared() {
             boost::unique_lock<mutex> lk(state_change);
+            const bool contended=!state.can_lock_shared();
+            const detail::time_point_t since=detail::lock_profile_point::now();
             while(!state.can_lock_shared()) {
                 shared_cond.wait(lk);
             }
             state.lock_shared();
+            detail::lock_profile_point::acquired_shared(this, contended, since);
         }
         
         /**
@@ -155,6 +160,7 @@ namespace boost { namespace green_thread {
                 return false;
             }
             state.lock_shared();
+            detail::lock_profile_point::acquired_shared(this, false, detail::time_point_t());
             return true;
         }
         
@@ -174,12 +180,15 @@ namespace boost { namespace green_thread {
         template <class Clock, class Duration>
         bool try_lock_shared_until(const boost::chrono::time_point<Clock, Duration>& abs_time) {
             boost::unique_lock<mutex> lk(state_change);
+            const bool contended=!state.can_lock_shared();
+            const detail::time_point_t since=detail::lock_profile_point::now();
             while(!state.can_lock_shared()) {
                 if(cv_status::timeout==shared_cond.wait_until(lk,abs_time)) {
                     return false;
                 }
             }
             state.lock_shared();
+            detail::lock_profile_point::acquired_shared(this, contended, since);
             return true;
         }
 
@@ -211,11 +220,14 @@ namespace boost { namespace green_thread {
          */
         void lock() {
             boost::unique_lock<mutex> lk(state_change);
+            const bool contended=state.shared_count || state.exclusive;
+            const detail::time_point_t since=profile_.now();
             while (state.shared_count || state.exclusive) {
                 state.exclusive_waiting_blocked=true;
                 exclusive_cond.wait(lk);
             }
             state.exclusive=true;
+            profile_.acquired(this, contended, since);
         }
         
         /**
@@ -227,6 +239,7 @@ namespace boost { namespace green_thread {
                 return false;
             } else {
                 state.exclusive=true;
+                profile_.acquired(this, false);
                 return true;
             }
             
@@ -248,6 +261,8 @@ namespace boost { namespace green_thread {
         template <class Clock, class Duration>
         bool try_lock_until(const boost::chrono::time_point<Clock, Duration>& abs_time) {
             boost::unique_lock<mutex> lk(state_change);
+            const bool contended=state.shared_count || state.exclusive;
+            const detail::time_point_t since=profile_.now();
             while(state.shared_count || state.exclusive) {
                 state.exclusive_waiting_blocked=true;
                 if(cv_status::timeout == exclusive_cond.wait_until(lk,abs_time)) {
@@ -260,6 +275,7 @@ namespace boost { namespace green_thread {
                 }
             }
             state.exclusive=true;
+            profile_.acquired(this, contended, since);
             return true;
         }
         
@@ -269,6 +285,7 @@ namespace boost { namespace green_thread {
         void unlock() {
             boost::unique_lock<mutex> lk(state_change);
             state.assert_locked();
+            profile_.released(this);
             state.exclusive=false;
             state.exclusive_waiting_blocked=false;
             state.assert_free();
@@ -334,17 +351,21 @@ namespace boost { namespace green_thread {
             boost::unique_lock<mutex> lk(state_change);
             state.assert_lock_upgraded();
             state.unlock_shared();
+            const bool contended=state.more_shared();
+            const detail::time_point_t since=profile_.now();
             while (state.more_shared()) {
                 upgrade_cond.wait(lk);
             }
             state.upgrade=false;
             state.exclusive=true;
             state.assert_locked();
+            profile_.acquired(this, contended, since);
         }
         
         void unlock_and_lock_upgrade() {
             boost::unique_lock<mutex> lk(state_change);
             state.assert_locked();
+            profile_.released(this);
             state.exclusive=false;
             state.upgrade=true;
             state.lock_shared();
@@ -365,6 +386,7 @@ namespace boost { namespace green_thread {
                 state.exclusive=true;
                 state.upgrade=false;
                 state.assert_locked();
+                profile_.acquired(this, false);
                 return true;
             }
             return false;
@@ -399,6 +421,7 @@ namespace boost { namespace green_thread {
         void unlock_and_lock_shared() {
             boost::unique_lock<mutex> lk(state_change);
             state.assert_locked();
+            profile_.released(this);
             state.exclusive=false;
             state.lock_shared();
             state.exclusive_waiting_blocked=false;
@@ -506,6 +529,7 @@ namespace boost { namespace green_thread {
         condition_variable shared_cond;
         condition_variable exclusive_cond;
         condition_variable upgrade_cond;
+        detail::lock_profile_point profile_;
         
         void release_waiters() {
             exclusive_cond.notify_one();
@@ -514,6 +538,113 @@ namespace boost { namespace green_thread {
         
     };
     
+    /**
+     * Reader-biased shared mutex
+     *
+     * Readers publish themselves in per-lock reader indicator slots, each slot
+     * occupies its own cache line and is picked by hashing the reader's thread
+     * id, so an uncontended `lock_shared` is one CAS on a local slot. Writers
+     * revoke the reader bias and wait for the published readers to drain,
+     * then the bias is inhibited for a while proportional to the cost of the
+     * revocation, in which readers fall back to the underlying
+     * `shared_timed_mutex` (BRAVO).
+     */
+    class BOOST_GREEN_THREAD_DECL shared_mutex {
+    public:
+        /// constructor
+        shared_mutex();
+        
+        /**
+         * locks the mutex, blocks if the mutex is not available
+         */
+        void lock();
+        
+        /**
+         * tries to lock the mutex, returns if the mutex is not available
+         */
+        bool try_lock();
+        
+        /**
+         * tries to lock the mutex, returns if the mutex has been
+         * unavailable for the specified timeout duration
+         */
+        template <class Rep, class Period>
+        bool try_lock_for(const boost::chrono::duration<Rep, Period>& rel_time) {
+            return try_lock_rel(boost::chrono::duration_cast<detail::duration_t>(rel_time));
+        }
+        
+        /**
+         * tries to lock the mutex, returns if the mutex has been
+         * unavailable until specified time point has been reached
+         */
+        template <class Clock, class Duration>
+        bool try_lock_until(const boost::chrono::time_point<Clock, Duration>& abs_time) {
+            return try_lock_for(abs_time-Clock::now());
+        }
+        
+        /**
+         * unlocks the mutex
+         */
+        void unlock();
+        
+        /**
+         * locks the mutex for shared ownership, blocks if the mutex is not available
+         */
+        void lock_shared();
+        
+        /**
+         * tries to lock the mutex for shared ownership, returns if the mutex is not available
+         */
+        bool try_lock_shared();
+        
+        /**
+         * tries to lock the mutex for shared ownership, returns if the mutex has been
+         * unavailable for the specified timeout duration
+         */
+        template <class Rep, class Period>
+        bool try_lock_shared_for(const boost::chrono::duration<Rep, Period>& rel_time) {
+            return try_lock_shared_rel(boost::chrono::duration_cast<detail::duration_t>(rel_time));
+        }
+        
+        /**
+         * tries to lock the mutex for shared ownership, returns if the mutex has been
+         * unavailable until specified time point has been reached
+         */
+        template <class Clock, class Duration>
+        bool try_lock_shared_until(const boost::chrono::time_point<Clock, Duration>& abs_time) {
+            return try_lock_shared_for(abs_time-Clock::now());
+        }
+        
+        /**
+         * unlocks the mutex (shared ownership)
+         */
+        void unlock_shared();
+        
+    private:
+        shared_mutex(const shared_mutex &)=delete;
+        void operator=(const shared_mutex &)=delete;
+        
+        bool try_lock_rel(detail::duration_t d);
+        bool try_lock_shared_rel(detail::duration_t d);
+        bool try_fast_lock_shared(uintptr_t id);
+        void after_slow_lock_shared();
+        bool revoke(const detail::time_point_t *deadline);
+        
+        enum { slot_count=32 };
+        struct slot {
+            boost::atomic<uintptr_t> reader_;
+            char padding_[BOOST_GREEN_THREAD_CACHELINE_SIZE-sizeof(boost::atomic<uintptr_t>)];
+        };
+        
+        boost::atomic<bool> reader_bias_;
+        boost::atomic<detail::duration_t::rep> inhibit_until_;
+        slot slots_[slot_count];
+        shared_timed_mutex underlying_;
+        // Used only when a writer waits for published readers to drain
+        mutex revocation_mtx_;
+        condition_variable revocation_cv_;
+    };
+    
     template<typename Mutex>
     class shared_lock {
     protected:
@@ -0,0 +1,599 @@
+//
+//  spill_buffer.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_SPILL_BUFFER_HPP
+#define BOOST_GREEN_THREAD_SPILL_BUFFER_HPP
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <exception>
+#include <ios>
+#include <functional>
+#include <type_traits>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/exceptions.hpp>
+#include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/latch.hpp>
+#include <boost/green_thread/concurrent_queue.hpp>
+#include <boost/green_thread/future/executor.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Turns elements into bytes and back for `spill_buffer`
+     *
+     * The primary template copies trivially copyable types as they are,
+     * specialize it for other types.
+     */
+    template<typename T>
+    struct spill_serializer {
+        static_assert(std::is_trivially_copyable<T>::value, "Specialize spill_serializer for this type");
+
+        static void save(std::vector<char> &out, const T &v) {
+            const char *p=reinterpret_cast<const char *>(&v);
+            out.insert(out.end(), p, p+sizeof(T));
+        }
+
+        /// reads an element at `p` and advances `p` past it
+        static T load(const char *&p) {
+            T v;
+            std::memcpy(&v, p, sizeof(T));
+            p+=sizeof(T);
+            return v;
+        }
+    };
+
+    template<typename Char, typename Traits, typename Allocator>
+    struct spill_serializer<std::basic_string<Char, Traits, Allocator>> {
+        typedef std::basic_string<Char, Traits, Allocator> string_type;
+
+        static void save(std::vector<char> &out, const string_type &v) {
+            const uint64_t n=v.size();
+            const char *p=reinterpret_cast<const char *>(&n);
+            out.insert(out.end(), p, p+sizeof(n));
+            p=reinterpret_cast<const char *>(v.data());
+            out.insert(out.end(), p, p+n*sizeof(Char));
+        }
+
+        static string_type load(const char *&p) {
+            uint64_t n;
+            std::memcpy(&n, p, sizeof(n));
+            p+=sizeof(n);
+            string_type v(static_cast<size_t>(n), Char());
+            if (n) std::memcpy(&v[0], p, n*sizeof(Char));
+            p+=n*sizeof(Char);
+            return v;
+        }
+    };
+
+    /**
+     * Where and when a `spill_buffer` spills
+     */
+    struct spill_options {
+        /// Segment files are named after this prefix, the temporary directory by default
+        std::string path_prefix=default_path_prefix();
+        /// Number of elements kept in memory before spilling
+        size_t memory_limit=4096;
+        /// Size of a segment file in bytes, larger elements get a file of their own
+        size_t segment_size=size_t(4)<<20;
+        /// Full segments kept in memory while they wait for the disk, a push spilling past them fails
+        size_t max_unwritten=8;
+
+        static std::string default_path_prefix() {
+            for (const char *name : {"TMPDIR", "TMP", "TEMP"}) {
+                if (const char *dir=std::getenv(name)) return std::string(dir)+"/green_thread_spill_";
+            }
+#if defined(BOOST_WINDOWS)
+            return "green_thread_spill_";
+#else
+            return "/tmp/green_thread_spill_";
+#endif
+        }
+    };
+
+    /**
+     * FIFO buffer keeping at most `memory_limit` elements in memory and
+     * spilling the rest to memory-mapped segment files
+     *
+     * Used as the container of `basic_concurrent_queue`, see
+     * `spilling_queue`. An unbounded queue over it absorbs bursts without
+     * blocking producers, while holding at most `memory_limit` elements
+     * plus `max_unwritten` segments waiting for the disk and two more
+     * being filled and read back in memory.
+     *
+     * Elements past the limit are serialized into a segment, a full segment
+     * is handed to a background I/O thread which writes it to a file, so
+     * worker threads never wait for the disk. A segment which can't be
+     * written stays in memory, once `max_unwritten` segments are waiting a
+     * push which needs a new one throws `thread_resource_error` with
+     * `errc::no_buffer_space` instead of growing, the disk is too slow or
+     * full to keep up.
+     *
+     * Segments are read back in order, the next one is prefetched by the I/O
+     * thread while the memory part drains. Until it has been read `ready()`
+     * is false, the queue parks its consumers without holding its lock and
+     * the buffer wakes them through the `on_ready` callback, so neither the
+     * consumers nor the producers wait for the disk under the lock. Files of
+     * consumed segments are reused by later segments and removed when the
+     * buffer is destroyed.
+     */
+    template<typename T, typename Serializer=spill_serializer<T>>
+    class spill_buffer {
+    public:
+        typedef std::deque<T> container_type;
+        typedef T value_type;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+
+        explicit spill_buffer(const spill_options &options=spill_options())
+        : options_(options)
+        , size_(0)
+        , fill_count_(0)
+        , prefetched_(false)
+        , tag_(random_tag())
+        , next_file_(0)
+        , stopped_(false)
+        , segments_written_(0)
+        , unwritten_(0)
+        , notifiers_(0)
+        , sched_(detail::current_scheduler())
+        , io_thread_([this](){ run_io(); })
+        {
+            if (options_.segment_size==0) options_.segment_size=1;
+            if (options_.max_unwritten==0) options_.max_unwritten=1;
+        }
+
+        /// destructor, stops the I/O thread and removes all segment files
+        ~spill_buffer() {
+            {
+                boost::lock_guard<boost::mutex> lock(io_mtx_);
+                stopped_=true;
+            }
+            io_cv_.notify_one();
+            io_thread_.join();
+            // Ready callbacks still running refer to the buffer
+            while (notifiers_.load()!=0) {
+                if (this_thread::is_a_thread()) {
+                    this_thread::yield();
+                } else {
+                    boost::this_thread::yield();
+                }
+            }
+            for (const auto &f : files_) {
+                boost::interprocess::file_mapping::remove(f.name_.c_str());
+            }
+        }
+
+        bool empty() const {
+            return size_==0;
+        }
+
+        size_type size() const {
+            return size_;
+        }
+
+        /**
+         * Whether `front` can return without waiting for the disk, false
+         * while the oldest element is in a segment not read back yet
+         */
+        bool ready() const {
+            if (!head_.empty()) return true;
+            if (segments_.empty()) return fill_count_>0;
+            const segment &s=*segments_.front();
+            boost::lock_guard<detail::spinlock> lock(s.mtx_);
+            // A wanted segment keeps its bytes until consumed
+            return s.wanted_ && (s.data_ || s.error_);
+        }
+
+        /**
+         * Calls `f` on a green thread of the scheduler which created the
+         * buffer whenever a segment has been read back, `ready` may have
+         * turned true
+         */
+        void on_ready(std::function<void()> f) {
+            on_ready_=std::move(f);
+        }
+
+        /// the oldest element, waits for the segment to be read back unless `ready()`
+        reference front() {
+            if (head_.empty()) refill();
+            return head_.front();
+        }
+
+        void push(const T &v) {
+            if (in_memory()) {
+                head_.push_back(v);
+            } else {
+                spill(v);
+            }
+            size_++;
+        }
+
+        void push(T &&v) {
+            if (in_memory()) {
+                head_.push_back(std::move(v));
+            } else {
+                spill(v);
+            }
+            size_++;
+        }
+
+        void pop() {
+            if (head_.empty()) refill();
+            head_.pop_front();
+            size_--;
+            if (!prefetched_ && !segments_.empty() && head_.size()<=options_.memory_limit/2) {
+                // Read the next segment while the rest of the memory part drains
+                prefetch();
+            }
+        }
+
+        /// Number of segment files created so far, stays low as files are reused
+        size_type files_created() const {
+            boost::lock_guard<detail::spinlock> lock(files_mtx_);
+            return files_.size();
+        }
+
+        /// Number of segments written to disk so far
+        size_type segments_written() const {
+            return segments_written_.load();
+        }
+
+    private:
+        /// non-copyable, the I/O thread refers to the buffer
+        spill_buffer(const spill_buffer &)=delete;
+        void operator=(const spill_buffer &)=delete;
+
+        struct file {
+            std::string name_;
+            size_type size_;
+        };
+
+        // Sealed elements, in memory until written, on disk until prefetched
+        struct segment {
+            segment()
+            : loaded_(1)
+            {}
+
+            mutable detail::spinlock mtx_;
+            std::shared_ptr<const std::vector<char>> data_;
+            size_type count_=0;
+            size_type bytes_=0;
+            file *file_=nullptr;
+            bool consumed_=false;
+            // A load has been posted, the bytes are kept if not written yet
+            bool wanted_=false;
+            // Counted in unwritten_, the bytes are only in memory
+            bool pending_=true;
+            // Released once the posted load is done
+            latch loaded_;
+            std::exception_ptr error_;
+        };
+
+        // Elements go to memory until the first one is spilled, and then
+        // to the segments until they are all read back, to keep the order
+        bool in_memory() const {
+            return segments_.empty() && fill_count_==0 && head_.size()<options_.memory_limit;
+        }
+
+        void spill(const T &v) {
+            if (unwritten_.load()>=options_.max_unwritten) {
+                BOOST_THROW_EXCEPTION(thread_resource_error(boost::system::errc::no_buffer_space,
+                                                            "spill_buffer: too many segments waiting for the disk"));
+            }
+            const size_type before=fill_.size();
+            Serializer::save(fill_, v);
+            if (fill_.size()>options_.segment_size && fill_count_>0) {
+                // Doesn't fit, the element starts the next segment
+                std::vector<char> rest(fill_.begin()+before, fill_.end());
+                fill_.resize(before);
+                seal();
+                fill_.swap(rest);
+            }
+            fill_count_++;
+            if (fill_.size()>=options_.segment_size) seal();
+        }
+
+        void seal() {
+            std::shared_ptr<segment> s=std::make_shared<segment>();
+            s->count_=fill_count_;
+            s->bytes_=fill_.size();
+            s->data_=std::make_shared<const std::vector<char>>(std::move(fill_));
+            fill_=std::vector<char>();
+            fill_.reserve(options_.segment_size);
+            fill_count_=0;
+            segments_.push_back(s);
+            unwritten_++;
+            post([this, s](){ write(s); });
+            // The consumer is waiting for this one already
+            if (head_.empty() && !prefetched_) prefetch();
+        }
+
+        // Posts the load of the oldest segment
+        void prefetch() {
+            prefetched_=true;
+            std::shared_ptr<segment> s=segments_.front();
+            {
+                boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                s->wanted_=true;
+            }
+            post([this, s](){ load(s); });
+        }
+
+        // Moves the oldest spilled elements back to memory
+        void refill() {
+            if (segments_.empty()) {
+                // Elements not sealed yet
+                decode(fill_.data(), fill_count_);
+                fill_.clear();
+                fill_count_=0;
+                return;
+            }
+            std::shared_ptr<segment> s=segments_.front();
+            std::shared_ptr<const std::vector<char>> data;
+            {
+                boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                data=s->data_;
+            }
+            if (!data) {
+                // On disk, wait for the I/O thread to read it
+                if (!prefetched_) prefetch();
+                s->loaded_.wait();
+                std::exception_ptr error;
+                {
+                    boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                    data=s->data_;
+                    error=s->error_;
+                }
+                if (!data) std::rethrow_exception(error);
+            }
+            decode(data->data(), s->count_);
+            file *f;
+            segments_.pop_front();
+            prefetched_=false;
+            {
+                boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                s->consumed_=true;
+                s->data_.reset();
+                f=s->file_;
+                s->file_=nullptr;
+                written(*s);
+            }
+            // A segment still being written gives its file back when done
+            if (f) release(f);
+        }
+
+        void decode(const char *p, size_type count) {
+            for (size_type i=0; i<count; i++) {
+                head_.push_back(Serializer::load(p));
+            }
+        }
+
+        // Runs on the I/O thread
+        void write(const std::shared_ptr<segment> &s) {
+            std::shared_ptr<const std::vector<char>> data;
+            {
+                boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                if (s->consumed_) return;
+                data=s->data_;
+            }
+            file *f=nullptr;
+            try {
+                f=acquire(s->bytes_);
+                boost::interprocess::file_mapping m(f->name_.c_str(), boost::interprocess::read_write);
+                boost::interprocess::mapped_region r(m, boost::interprocess::read_write, 0, s->bytes_);
+                std::memcpy(r.get_address(), data->data(), s->bytes_);
+            } catch(...) {
+                // The segment stays in memory
+                if (f) release(f);
+                return;
+            }
+            segments_written_++;
+            boost::lock_guard<detail::spinlock> lock(s->mtx_);
+            written(*s);
+            if (s->consumed_) {
+                release(f);
+                return;
+            }
+            s->file_=f;
+            // Keeps the bytes if the consumer already asked for them
+            if (!s->wanted_) s->data_.reset();
+        }
+
+        // Runs on the I/O thread, always after the write of the segment
+        void load(const std::shared_ptr<segment> &s) {
+            file *f;
+            {
+                boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                f=(s->consumed_ || s->data_) ? nullptr : s->file_;
+            }
+            if (f) {
+                std::shared_ptr<const std::vector<char>> data;
+                std::exception_ptr error;
+                try {
+                    data=read(*f, s->bytes_);
+                } catch(...) {
+                    // The consumer waiting for it gets the error
+                    error=std::current_exception();
+                }
+                boost::lock_guard<detail::spinlock> lock(s->mtx_);
+                if (!s->consumed_) {
+                    s->data_=data;
+                    s->error_=error;
+                }
+            }
+            s->loaded_.count_down();
+            notify_ready();
+        }
+
+        // The bytes of `s` are no longer only in memory, s.mtx_ must be held
+        void written(segment &s) {
+            if (!s.pending_) return;
+            s.pending_=false;
+            unwritten_--;
+        }
+
+        // Runs on the I/O thread, the callback takes the queue lock, which
+        // only a green thread can do
+        void notify_ready() {
+            if (!on_ready_) return;
+            notifiers_++;
+            try {
+                thread(sched_, [this](){
+                    struct guard {
+                        boost::atomic<size_type> &n_;
+                        ~guard() { n_--; }
+                    } g={notifiers_};
+                    on_ready_();
+                }).detach();
+            } catch(...) {
+                notifiers_--;
+            }
+        }
+
+        static std::shared_ptr<const std::vector<char>> read(const file &f, size_type bytes) {
+            boost::interprocess::file_mapping m(f.name_.c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region r(m, boost::interprocess::read_only, 0, bytes);
+            const char *p=static_cast<const char *>(r.get_address());
+            return std::make_shared<const std::vector<char>>(p, p+bytes);
+        }
+
+        // A free file large enough, or a new one
+        file *acquire(size_type bytes) {
+            {
+                boost::lock_guard<detail::spinlock> lock(files_mtx_);
+                for (auto i=free_files_.begin(); i!=free_files_.end(); ++i) {
+                    if ((*i)->size_>=bytes) {
+                        file *f=*i;
+                        free_files_.erase(i);
+                        return f;
+                    }
+                }
+            }
+            std::unique_ptr<file> f(new file);
+            f->size_=std::max(bytes, options_.segment_size);
+            std::FILE *fp=nullptr;
+            for (int attempt=0; !fp; attempt++) {
+                f->name_=options_.path_prefix+std::to_string(tag_)+"_"+std::to_string(next_file_++)+".seg";
+                // Created exclusively, never clobbers the files of another buffer or process
+                fp=std::fopen(f->name_.c_str(), "w+bx");
+                if (!fp) {
+                    if (errno!=EEXIST || attempt>=16) throw std::ios_base::failure("cannot create "+f->name_);
+                    tag_=random_tag();
+                }
+            }
+            const bool sized=std::fseek(fp, long(f->size_-1), SEEK_SET)==0 && std::fputc(0, fp)!=EOF;
+            if (std::fclose(fp)!=0 || !sized) {
+                std::remove(f->name_.c_str());
+                throw std::ios_base::failure("cannot extend "+f->name_);
+            }
+            boost::lock_guard<detail::spinlock> lock(files_mtx_);
+            files_.push_back(std::move(*f));
+            return &files_.back();
+        }
+
+        static uint64_t random_tag() {
+            std::random_device rd;
+            return (uint64_t(rd())<<32)^rd();
+        }
+
+        void release(file *f) {
+            boost::lock_guard<detail::spinlock> lock(files_mtx_);
+            free_files_.push_back(f);
+        }
+
+        void post(std::function<void()> task) {
+            {
+                boost::lock_guard<boost::mutex> lock(io_mtx_);
+                tasks_.push_back(std::move(task));
+            }
+            io_cv_.notify_one();
+        }
+
+        void run_io() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    boost::unique_lock<boost::mutex> lock(io_mtx_);
+                    while (tasks_.empty() && !stopped_) io_cv_.wait(lock);
+                    // Pending writes are pointless once the buffer is going away
+                    if (stopped_) return;
+                    task=std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+
+        spill_options options_;
+
+        // Consumer side, protected by the queue lock
+        size_type size_;
+        std::deque<T> head_;
+        std::deque<std::shared_ptr<segment>> segments_;
+        std::vector<char> fill_;
+        size_type fill_count_;
+        bool prefetched_;
+
+        // Segment files, a deque keeps them in place, the tag is only
+        // changed by the I/O thread
+        uint64_t tag_;
+        size_type next_file_;
+        mutable detail::spinlock files_mtx_;
+        std::deque<file> files_;
+        std::vector<file *> free_files_;
+
+        boost::mutex io_mtx_;
+        boost::condition_variable io_cv_;
+        std::deque<std::function<void()>> tasks_;
+        bool stopped_;
+        boost::atomic<size_type> segments_written_;
+        boost::atomic<size_type> unwritten_;
+        std::function<void()> on_ready_;
+        boost::atomic<size_type> notifiers_;
+        scheduler sched_;
+        boost::thread io_thread_;
+    };
+
+    namespace detail {
+        template<typename T, typename Serializer>
+        struct queue_adapter<T, spill_buffer<T, Serializer>> {
+            typedef spill_buffer<T, Serializer> type;
+        };
+    }   // End of namespace boost::green_thread::detail
+
+    /**
+     * Unbounded concurrent queue with bounded memory, elements over the
+     * limit wait in segment files
+     *
+     *     spill_options opts;
+     *     opts.memory_limit=1<<16;
+     *     spilling_queue<event> q(spilling_queue<event>::size_type(-1), true, opts);
+     */
+    template<typename T, typename Serializer=spill_serializer<T> > using spilling_queue = concurrent_queue<T, spill_buffer<T, Serializer>>;
+}}  // End of namespace boost::green_thread
+
+#endif
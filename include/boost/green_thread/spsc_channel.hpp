@@ -0,0 +1,279 @@
+//
+//  spsc_channel.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_SPSC_CHANNEL_HPP
+#define BOOST_GREEN_THREAD_SPSC_CHANNEL_HPP
+
+#include <memory>
+#include <type_traits>
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+#include <boost/green_thread/concurrent_queue.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Bounded channel with exactly one producer and one consumer
+     *
+     * The head and tail indices live on separate cache lines and each side
+     * keeps a cached copy of the other side's index, so a push or a pop
+     * usually touches no line written by the other side. A side only parks
+     * when the ring is full or empty, and the other side only goes to the
+     * parking lot when it sees the parked flag. Copying or moving `T` must
+     * not throw.
+     */
+    template<typename T>
+    class spsc_channel {
+    public:
+        typedef T value_type;
+        typedef size_t size_type;
+        
+        /**
+         * constructor, the capacity is rounded up to a power of 2
+         */
+        explicit spsc_channel(size_type capacity=1024)
+        : mask_(round_up(capacity)-1)
+        , buffer_(new storage_type[mask_+1])
+        , closed_(false)
+        , tail_(0)
+        , consumer_parked_(false)
+        , cached_head_(0)
+        , head_(0)
+        , producer_parked_(false)
+        , cached_tail_(0)
+        {}
+        
+        ~spsc_channel() {
+            const size_type t=tail_.load(boost::memory_order_relaxed);
+            for (size_type h=head_.load(boost::memory_order_relaxed); h!=t; h++) {
+                slot(h)->~T();
+            }
+        }
+        
+        /**
+         * closes the channel, the consumer can still pop remaining items
+         */
+        void close() {
+            closed_.store(true);
+            detail::unpark_all(&tail_);
+            detail::unpark_all(&head_);
+        }
+        
+        bool is_open() const {
+            return !closed_.load(boost::memory_order_relaxed);
+        }
+        
+        /**
+         * pushes an item, blocks while the channel is full, returns false if
+         * the channel is closed, must only be called by the producer
+         */
+        bool push(const T &data) {
+            return push_until(data, nullptr);
+        }
+        
+        bool push(T &&data) {
+            return push_until(std::move(data), nullptr);
+        }
+        
+        /**
+         * pushes an item without blocking, must only be called by the producer
+         */
+        bool try_push(const T &data) {
+            return is_open() && push_item(data);
+        }
+        
+        bool try_push(T &&data) {
+            return is_open() && push_item(std::move(data));
+        }
+        
+        template<class Rep, class Period>
+        bool try_push_for(T data, const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_duration);
+            return push_until(std::move(data), &deadline);
+        }
+        
+        /**
+         * pops an item, blocks while the channel is empty, returns false if
+         * the channel is closed and empty, must only be called by the consumer
+         */
+        bool pop(T &popped_value) {
+            return pop_until(popped_value, nullptr);
+        }
+        
+        /**
+         * pops an item without blocking, must only be called by the consumer
+         */
+        bool try_pop(T &popped_value) {
+            return pop_item(popped_value);
+        }
+        
+        template<class Rep, class Period>
+        bool try_pop_for(T &popped_value, const boost::chrono::duration<Rep,Period>& timeout_duration) {
+            const detail::time_point_t deadline=boost::chrono::steady_clock::now()
+                +boost::chrono::duration_cast<detail::duration_t>(timeout_duration);
+            return pop_until(popped_value, &deadline);
+        }
+        
+        /**
+         * number of items, only approximate while the other side is running
+         */
+        size_type size() const {
+            return tail_.load(boost::memory_order_acquire)-head_.load(boost::memory_order_acquire);
+        }
+        
+        size_type capacity() const {
+            return mask_+1;
+        }
+        
+        // Minimal range-based for loop support
+        typedef detail::concurrent_queue_iterator<spsc_channel> iterator;
+        
+        iterator begin() {
+            return iterator(this);
+        }
+        
+        iterator end() const {
+            return iterator();
+        }
+        
+    private:
+        spsc_channel(const spsc_channel &)=delete;
+        void operator=(const spsc_channel &)=delete;
+        
+        typedef typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage_type;
+        
+        static size_type round_up(size_type n) {
+            size_type r=2;
+            while (r<n) r<<=1;
+            return r;
+        }
+        
+        T *slot(size_type i) {
+            return reinterpret_cast<T *>(&buffer_[i & mask_]);
+        }
+        
+        // Parks while `index` stays at `seen` and the channel is open
+        struct parker : detail::park_handler {
+            parker(const spsc_channel &c, const boost::atomic<size_type> &index, size_type seen)
+            : c_(c)
+            , index_(index)
+            , seen_(seen)
+            {}
+            
+            virtual bool validate() override {
+                return index_.load(boost::memory_order_relaxed)==seen_ && c_.is_open();
+            }
+            
+            const spsc_channel &c_;
+            const boost::atomic<size_type> &index_;
+            size_type seen_;
+        };
+        
+        /**
+         * Parks on the other side's index, returns false on timeout
+         */
+        bool park(boost::atomic<size_type> &index,
+                  size_type seen,
+                  boost::atomic<bool> &parked,
+                  const detail::time_point_t *deadline)
+        {
+            parked.store(true, boost::memory_order_relaxed);
+            // Pairs with the fence in wake, either the other side sees the
+            // flag or we see the index moved
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            parker p(*this, index, seen);
+            detail::park_result r={true, 0};
+            if (index.load(boost::memory_order_relaxed)==seen && is_open()) {
+                r=detail::park(&index, p, deadline);
+            }
+            parked.store(false, boost::memory_order_relaxed);
+            return r.unparked || !deadline || boost::chrono::steady_clock::now()<*deadline;
+        }
+        
+        void wake(boost::atomic<size_type> &index, boost::atomic<bool> &parked) {
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            if (parked.load(boost::memory_order_relaxed)) {
+                detail::unpark_one(&index);
+            }
+        }
+        
+        template<typename U>
+        bool push_item(U &&data) {
+            const size_type t=tail_.load(boost::memory_order_relaxed);
+            if (t-cached_head_>mask_) {
+                // Looks full, refresh the consumer's index
+                cached_head_=head_.load(boost::memory_order_acquire);
+                if (t-cached_head_>mask_) return false;
+            }
+            new (slot(t)) T(std::forward<U>(data));
+            tail_.store(t+1, boost::memory_order_release);
+            wake(tail_, consumer_parked_);
+            return true;
+        }
+        
+        bool pop_item(T &popped_value) {
+            const size_type h=head_.load(boost::memory_order_relaxed);
+            if (h==cached_tail_) {
+                // Looks empty, refresh the producer's index
+                cached_tail_=tail_.load(boost::memory_order_acquire);
+                if (h==cached_tail_) return false;
+            }
+            T *p=slot(h);
+            popped_value=std::move(*p);
+            p->~T();
+            head_.store(h+1, boost::memory_order_release);
+            wake(head_, producer_parked_);
+            return true;
+        }
+        
+        template<typename U>
+        bool push_until(U &&data, const detail::time_point_t *deadline) {
+            for (;;) {
+                if (!is_open()) return false;
+                if (push_item(std::forward<U>(data))) return true;
+                // Full, wait for the consumer to move the head
+                if (!park(head_, cached_head_, producer_parked_, deadline)) return false;
+            }
+        }
+        
+        bool pop_until(T &popped_value, const detail::time_point_t *deadline) {
+            for (;;) {
+                if (pop_item(popped_value)) return true;
+                if (!is_open()) {
+                    // Closed, drain items pushed before closing
+                    return pop_item(popped_value);
+                }
+                // Empty, wait for the producer to move the tail
+                if (!park(tail_, cached_tail_, consumer_parked_, deadline)) return false;
+            }
+        }
+        
+        // Read-only after construction
+        const size_type mask_;
+        std::unique_ptr<storage_type[]> buffer_;
+        boost::atomic<bool> closed_;
+        char padding0_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        // Producer side
+        boost::atomic<size_type> tail_;
+        boost::atomic<bool> consumer_parked_;
+        size_type cached_head_;
+        char padding1_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        // Consumer side
+        boost::atomic<size_type> head_;
+        boost::atomic<bool> producer_parked_;
+        size_type cached_tail_;
+        char padding2_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+    };
+}}  // End of namespace boost::green_thread
+
+#endif
@@ -0,0 +1,115 @@
+//
+//  task_graph.hpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#ifndef BOOST_GREEN_THREAD_TASK_GRAPH_HPP
+#define BOOST_GREEN_THREAD_TASK_GRAPH_HPP
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/green_thread/detail/config.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+
+namespace boost { namespace green_thread {
+    /**
+     * Directed acyclic graph of functions, each one runs once all of its
+     * predecessors are done
+     *
+     * Every node keeps an atomic count of unfinished predecessors, the
+     * function finishing last starts the node, so nothing waits for an
+     * edge. Ready nodes run on pool threads of the scheduler, one of the
+     * nodes made ready by a function runs on the same thread right after.
+     *
+     * A graph can be run any number of times, but must not be modified or
+     * run again while running, which throws `invalid_argument` with
+     * `errc::operation_not_permitted`, like changing a started pipeline.
+     */
+    class BOOST_GREEN_THREAD_DECL task_graph {
+    public:
+        typedef size_t node_id;
+
+        /// Timing of a node in the last run
+        struct node_timing {
+            std::string name;
+            /// false if skipped after a failure
+            bool ran;
+            /// start relative to the start of the run
+            detail::duration_t start;
+            detail::duration_t duration;
+        };
+
+        /// Timings of the last run
+        struct timing_report {
+            detail::duration_t wall_time;
+            /// sum of the durations along the critical path
+            detail::duration_t critical_path_time;
+            /// chain of dependent nodes with the longest total duration, first to last
+            std::vector<node_id> critical_path;
+            /// indexed by node id
+            std::vector<node_timing> nodes;
+        };
+
+        task_graph();
+        ~task_graph();
+
+        /// Adds a node running `fn`, `name` is used in timing reports
+        node_id add(std::function<void()> fn, const std::string &name=std::string());
+
+        /// Makes `after` wait for `before`
+        void precede(node_id before, node_id after);
+
+        /// Number of nodes
+        size_t size() const;
+
+        /**
+         * Runs every node and waits until they are done, can be called from
+         * both green threads and foreign threads
+         *
+         * If a function throws, the nodes not started yet are skipped and
+         * the first exception is rethrown once the running ones are done.
+         * Throws `invalid_argument` if the graph has a cycle.
+         */
+        void run();
+
+        /// Timings of the last run
+        const timing_report &report() const;
+
+    private:
+        task_graph(const task_graph &)=delete;
+        void operator=(const task_graph &)=delete;
+
+        struct node {
+            std::function<void()> fn_;
+            std::string name_;
+            std::vector<node_id> successors_;
+            size_t predecessors_;
+        };
+
+        struct run_state;
+
+        void sort();
+        void execute(const std::shared_ptr<run_state> &s, node_id id) const;
+        void make_report(const run_state &s);
+
+        std::vector<node> nodes_;
+        // Topological order, empty if outdated
+        std::vector<node_id> order_;
+        bool running_;
+        timing_report report_;
+    };
+
+    /// Prints the critical path and the timings of the nodes
+    BOOST_GREEN_THREAD_DECL std::ostream &operator<<(std::ostream &os, const task_graph::timing_report &r);
+}}  // End of namespace boost::green_thread
+
+#endif
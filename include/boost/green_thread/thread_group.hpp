@@ -43,7 +43,7 @@ namespace boost { namespace green_thread {
          */
         bool is_this_thread_in() {
             thread::id id = this_thread::get_id();
-            shared_lock<shared_timed_mutex> guard(m_);
+            shared_lock<shared_mutex> guard(m_);
             for(std::list<thread*>::iterator it=threads_.begin(),end=threads_.end(); it!=end; ++it) {
                 if ((*it)->get_id() == id)
                     return true;
@@ -57,7 +57,7 @@ namespace boost { namespace green_thread {
         bool is_thread_in(thread* thrd) {
             if(thrd) {
                 thread::id id = thrd->get_id();
-                shared_lock<shared_timed_mutex> guard(m_);
+                shared_lock<shared_mutex> guard(m_);
                 for(std::list<thread*>::iterator it=threads_.begin(),end=threads_.end(); it!=end; ++it) {
                     if ((*it)->get_id() == id)
                         return true;
@@ -74,7 +74,7 @@ namespace boost { namespace green_thread {
         template<typename Fn, typename... Args>
         thread* create_thread(Fn &&fn, Args&&... args)
         {
-            boost::lock_guard<shared_timed_mutex> guard(m_);
+            boost::lock_guard<shared_mutex> guard(m_);
             std::unique_ptr<thread> new_thread(new thread(std::forward<Fn>(fn), std::forward<Args>(args)...));
             threads_.push_back(new_thread.get());
             return new_thread.release();
@@ -85,7 +85,7 @@ namespace boost { namespace green_thread {
          */
         void add_thread(thread* thrd) {
             if(thrd) {
-                boost::lock_guard<shared_timed_mutex> guard(m_);
+                boost::lock_guard<shared_mutex> guard(m_);
                 threads_.push_back(thrd);
             }
         }
@@ -94,7 +94,7 @@ namespace boost { namespace green_thread {
          * remove a thread from the thread group
          */
         void remove_thread(thread* thrd) {
-            boost::lock_guard<shared_timed_mutex> guard(m_);
+            boost::lock_guard<shared_mutex> guard(m_);
             std::list<thread*>::iterator const it=std::find(threads_.begin(),threads_.end(),thrd);
             if(it!=threads_.end()) {
                 threads_.erase(it);
@@ -105,7 +105,7 @@ namespace boost { namespace green_thread {
          * wait until all threads exit
          */
         void join_all() {
-            shared_lock<shared_timed_mutex> guard(m_);
+            shared_lock<shared_mutex> guard(m_);
             
             for(std::list<thread*>::iterator it=threads_.begin(),end=threads_.end(); it!=end; ++it) {
                 if ((*it)->joinable())
@@ -117,13 +117,13 @@ namespace boost { namespace green_thread {
          * returns the number of threads in the group
          */
         size_t size() const {
-            shared_lock<shared_timed_mutex> guard(m_);
+            shared_lock<shared_mutex> guard(m_);
             return threads_.size();
         }
         
     private:
         std::list<thread*> threads_;
-        mutable shared_timed_mutex m_;
+        mutable shared_mutex m_;
     };
 }}  // End of namespace boost::green_thread
 
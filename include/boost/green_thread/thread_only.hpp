@@ -12,6 +12,7 @@
 #define BOOST_GREEN_THREAD_THREAD_ONLY_HPP
 
 #include <memory>
+#include <vector>
 #include <functional>
 #include <utility>
 #include <type_traits>
@@ -20,9 +21,12 @@
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/detail/interrupt_hook.hpp>
 #include <boost/green_thread/detail/thread_data.hpp>
 
 namespace boost { namespace green_thread {
+    struct lock_profile_entry;
+    
     /// struct scheduler
     class BOOST_GREEN_THREAD_DECL scheduler {
     public:
@@ -54,6 +58,18 @@ namespace boost { namespace green_thread {
          */
         size_t worker_pool_size() const;
         
+        /**
+         * returns statistics of the `top_n` locks with the longest total wait
+         * time, recorded by the worker threads of the scheduler, empty if the
+         * library is built without BOOST_GREEN_THREAD_LOCK_PROFILING
+         */
+        std::vector<lock_profile_entry> lock_profile(size_t top_n=10) const;
+        
+        /**
+         * clears recorded lock statistics
+         */
+        void reset_lock_profile();
+        
         /**
          * returns the scheduler singleton
          */
@@ -333,6 +349,31 @@ namespace boost { namespace green_thread {
             int level_=0;
         };
         
+        /**
+         * class interruption_callback
+         *
+         * Calls a function when the current thread is interrupted while the
+         * instance exists, so an operation which is not woken up by the
+         * interruption itself, like a pending asio operation, can be
+         * cancelled. The function is called right away if an interruption
+         * is already pending, it can be called from any thread with a lock
+         * held, so it must be short and must not block.
+         */
+        class BOOST_GREEN_THREAD_DECL interruption_callback : private green_thread::detail::interrupt_hook {
+        public:
+            explicit interruption_callback(std::function<void()> fn);
+            ~interruption_callback();
+            
+        private:
+            /// non-copyable
+            interruption_callback(const interruption_callback &)=delete;
+            void operator=(const interruption_callback &)=delete;
+            
+            void on_interrupt() noexcept override;
+            
+            std::function<void()> fn_;
+        };
+        
         /// Check if the interruption is enabled
         BOOST_GREEN_THREAD_DECL bool interruption_enabled() noexcept;
 
@@ -0,0 +1,110 @@
+//
+//  async_pool.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+#include <boost/green_thread/future/async.hpp>
+#include "scheduler_object.hpp"
+
+namespace boost { namespace green_thread { namespace detail {
+    struct async_pool::worker : park_handler {
+        worker() : task_(nullptr), woken_(false) {}
+
+        bool validate() override
+        { return !woken_.load(boost::memory_order_acquire); }
+
+        // Next task, null if the pool is closed
+        boost::atomic<thread_data_base *> task_;
+        boost::atomic<bool> woken_;
+    };
+
+    async_pool::async_pool(scheduler_object &sched)
+    : sched_(sched)
+    {}
+
+    void async_pool::post(thread_data_base *task) {
+        std::unique_ptr<thread_data_base> t(task);
+        {
+            boost::lock_guard<spinlock> lock(mtx_);
+            if (!idle_.empty()) {
+                // The most recently parked one, its stack is still warm
+                wake(idle_.back(), t.release());
+                idle_.pop_back();
+                return;
+            }
+        }
+        thread_ptr_t p=sched_.make_thread(make_thread_data(&async_pool::run, this, t.get()));
+        t.release();
+        // Nobody joins pool threads
+        p->get_thread_strand().post(std::bind(&thread_object::detach, p));
+    }
+
+    void async_pool::wake(worker *w, thread_data_base *task) {
+        // Called with mtx_ locked, the worker can't exit before it is released
+        w->task_.store(task, boost::memory_order_relaxed);
+        w->woken_.store(true, boost::memory_order_release);
+        unpark_one(w);
+    }
+
+    size_t async_pool::idle_count() const {
+        boost::lock_guard<spinlock> lock(mtx_);
+        return idle_.size();
+    }
+
+    void async_pool::close() {
+        boost::lock_guard<spinlock> lock(mtx_);
+        closed_=true;
+        for (worker *w : idle_) {
+            wake(w, nullptr);
+        }
+        idle_.clear();
+    }
+
+    void async_pool::reopen() {
+        boost::lock_guard<spinlock> lock(mtx_);
+        closed_=false;
+    }
+
+    void async_pool::run(thread_data_base *task) {
+        std::unique_ptr<thread_data_base> t(task);
+        worker self;
+        while (t) {
+            // Tasks are packaged, they don't throw
+            t->run();
+            t.reset();
+            {
+                boost::lock_guard<spinlock> lock(mtx_);
+                if (closed_ || idle_.size()>=max_idle) return;
+                self.woken_.store(false, boost::memory_order_relaxed);
+                idle_.push_back(&self);
+            }
+            while (!self.woken_.load(boost::memory_order_acquire)) {
+                park(&self, self);
+            }
+            t.reset(self.task_.exchange(nullptr, boost::memory_order_relaxed));
+        }
+    }
+
+    void post_to_pool(thread_data_base *task) {
+        if (auto cf=current_thread_object()) {
+            cf->sched_->pool_.post(task);
+        } else {
+            // Like threads, the default scheduler outside of a thread
+            scheduler_object::get_instance()->pool_.post(task);
+        }
+    }
+
+    size_t pool_concurrency() {
+        if (auto cf=current_thread_object()) {
+            return cf->sched_->worker_pool_size();
+        }
+        return scheduler_object::get_instance()->worker_pool_size();
+    }
+}}} // End of namespace boost::green_thread::detail
@@ -29,7 +29,9 @@ namespace boost { namespace green_thread {
             // as other will see there is a thread in the waiting queue.
             suspended_.push_back(suspended_item({m, tf, 0}));
         }
+        const detail::time_point_t since=detail::lock_profile_point::now();
         { detail::relock_guard<mutex> relock(*m); tf->pause(); }
+        detail::lock_profile_point::waited(this, since);
     }
     
     void condition_variable::timeout_handler(detail::thread_ptr_t this_thread,
@@ -73,7 +75,9 @@ namespace boost { namespace green_thread {
                                                                         std::ref(ret),
                                                                         std::placeholders::_1)));
         }
+        const detail::time_point_t since=detail::lock_profile_point::now();
         { detail::relock_guard<mutex> relock(*m); tf->pause(); }
+        detail::lock_profile_point::waited(this, since);
         return ret;
     }
     
@@ -125,6 +129,31 @@ namespace boost { namespace green_thread {
         }
     }
 
+    void condition_variable::notify_n(size_t n) {
+        {
+            boost::lock_guard<detail::spinlock> lock(mtx_);
+            if (n==0 || suspended_.empty()) {
+                return;
+            }
+            for (; n>0 && !suspended_.empty(); n--) {
+                suspended_item p(suspended_.front());
+                suspended_.pop_front();
+                if (p.t_) {
+                    // Cancel attached timer if it's set
+                    // Timer handler will reschedule the waiting thread
+                    p.t_->cancel();
+                } else {
+                    // No timer attached to the waiting thread, directly schedule it
+                    p.f_->resume();
+                }
+            }
+        }
+        // Yield once for the whole batch
+        if (auto cf=current_thread_object()) {
+            cf->yield();
+        }
+    }
+
     struct cleanup_handler {
         condition_variable &c_;
         boost::unique_lock<mutex> l_;
@@ -0,0 +1,50 @@
+//
+//  executor.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/green_thread/exceptions.hpp>
+#include <boost/green_thread/future/executor.hpp>
+#include "scheduler_object.hpp"
+#include "thread_object.hpp"
+
+static const auto NOT_A_THREAD=boost::green_thread::thread_exception(boost::system::errc::no_such_process);
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        int &continuation_depth() {
+            if (auto cf=current_thread_object()) {
+                return cf->continuation_depth_;
+            }
+            static THREAD_LOCAL int depth=0;
+            return depth;
+        }
+
+        scheduler current_scheduler() {
+            if (auto cf=current_thread_object()) {
+                return scheduler(cf->sched_);
+            }
+            return scheduler::get_instance();
+        }
+    }   // End of namespace boost::green_thread::detail
+
+    strand_executor::strand_executor() {
+        detail::thread_object *cf=current_thread_object();
+        if (!cf) {
+            BOOST_THROW_EXCEPTION(NOT_A_THREAD);
+        }
+        sched_=cf->sched_;
+        strand_=cf->thread_strand_;
+    }
+
+    void strand_executor::spawn(detail::thread_data_base *entry) const {
+        detail::thread_ptr_t t=sched_->make_thread(strand_, entry);
+        // Nobody joins continuation threads
+        t->get_thread_strand().post(std::bind(&detail::thread_object::detach, t));
+    }
+}}  // End of namespace boost::green_thread
@@ -0,0 +1,145 @@
+//
+//  lock_profiler.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <algorithm>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/lock_profile.hpp>
+#include <boost/green_thread/detail/lock_profiler.hpp>
+#include "scheduler_object.hpp"
+
+namespace boost { namespace green_thread {
+    namespace {
+        boost::mutex names_mtx;
+        std::unordered_map<const void *, std::string> &names() {
+            static std::unordered_map<const void *, std::string> n;
+            return n;
+        }
+    }
+    
+    void set_lock_name(const void *lock, const std::string &name) {
+        boost::lock_guard<boost::mutex> guard(names_mtx);
+        if (name.empty()) {
+            names().erase(lock);
+        } else {
+            names()[lock]=name;
+        }
+    }
+    
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+    namespace detail {
+        // Buffer of the calling worker thread and the scheduler it belongs to
+        static THREAD_LOCAL lock_profile_buffer *buffer_=nullptr;
+        static THREAD_LOCAL uint64_t buffer_serial_=0;
+        
+        static lock_profile_buffer *get_buffer() {
+            thread_object *cf=current_thread_object();
+            if (!cf) {
+                // Not recorded outside of green threads
+                return nullptr;
+            }
+            scheduler_object *sched=cf->get_scheduler().get();
+            if (buffer_serial_!=sched->profile_serial_) {
+                // First sample of this worker thread in this scheduler
+                std::unique_ptr<lock_profile_buffer> b(new lock_profile_buffer);
+                buffer_=b.get();
+                buffer_serial_=sched->profile_serial_;
+                boost::lock_guard<boost::mutex> guard(sched->mtx_);
+                sched->profile_buffers_.push_back(std::move(b));
+            }
+            return buffer_;
+        }
+        
+        void profile_acquired(const void *lock, bool contended, duration_t wait) {
+            lock_profile_buffer *b=get_buffer();
+            if (!b) return;
+            boost::lock_guard<spinlock> guard(b->mtx_);
+            lock_samples &s=b->samples_[lock];
+            s.acquisitions++;
+            if (contended) {
+                s.contentions++;
+                s.total_wait+=wait;
+                s.max_wait=std::max(s.max_wait, wait);
+            }
+        }
+        
+        void profile_released(const void *lock, duration_t hold) {
+            lock_profile_buffer *b=get_buffer();
+            if (!b) return;
+            boost::lock_guard<spinlock> guard(b->mtx_);
+            lock_samples &s=b->samples_[lock];
+            s.max_hold=std::max(s.max_hold, hold);
+        }
+    }   // End of namespace boost::green_thread::detail
+    
+    std::vector<lock_profile_entry> scheduler::lock_profile(size_t top_n) const {
+        // Merge buffers of all worker threads
+        std::unordered_map<const void *, detail::lock_samples> merged;
+        {
+            boost::lock_guard<boost::mutex> guard(impl_->mtx_);
+            for (auto &b : impl_->profile_buffers_) {
+                boost::lock_guard<detail::spinlock> buffer_guard(b->mtx_);
+                for (auto &i : b->samples_) {
+                    detail::lock_samples &s=merged[i.first];
+                    s.acquisitions+=i.second.acquisitions;
+                    s.contentions+=i.second.contentions;
+                    s.total_wait+=i.second.total_wait;
+                    s.max_wait=std::max(s.max_wait, i.second.max_wait);
+                    s.max_hold=std::max(s.max_hold, i.second.max_hold);
+                }
+            }
+        }
+        std::vector<lock_profile_entry> ret;
+        ret.reserve(merged.size());
+        for (auto &i : merged) {
+            lock_profile_entry e={
+                i.first,
+                std::string(),
+                i.second.acquisitions,
+                i.second.contentions,
+                i.second.total_wait,
+                i.second.max_wait,
+                i.second.max_hold,
+            };
+            ret.push_back(e);
+        }
+        auto by_wait=[](const lock_profile_entry &a, const lock_profile_entry &b) {
+            return a.total_wait>b.total_wait;
+        };
+        if (ret.size()>top_n) {
+            std::partial_sort(ret.begin(), ret.begin()+top_n, ret.end(), by_wait);
+            ret.resize(top_n);
+        } else {
+            std::sort(ret.begin(), ret.end(), by_wait);
+        }
+        boost::lock_guard<boost::mutex> guard(names_mtx);
+        for (auto &e : ret) {
+            auto i=names().find(e.lock);
+            if (i!=names().end()) e.name=i->second;
+        }
+        return ret;
+    }
+    
+    void scheduler::reset_lock_profile() {
+        boost::lock_guard<boost::mutex> guard(impl_->mtx_);
+        for (auto &b : impl_->profile_buffers_) {
+            boost::lock_guard<detail::spinlock> buffer_guard(b->mtx_);
+            b->samples_.clear();
+        }
+    }
+#else
+    std::vector<lock_profile_entry> scheduler::lock_profile(size_t /*top_n*/) const {
+        return std::vector<lock_profile_entry>();
+    }
+    
+    void scheduler::reset_lock_profile() {}
+#endif
+}}  // End of namespace boost::green_thread
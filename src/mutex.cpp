@@ -9,7 +9,9 @@
 //
 
 #include <boost/thread/lock_guard.hpp>
+#include <boost/thread/thread_only.hpp>
 #include <boost/green_thread/mutex.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
 #include "thread_object.hpp"
 
 namespace boost { namespace green_thread {
@@ -36,13 +38,54 @@ namespace boost { namespace green_thread {
             // This mutex is not locked
             // Acquire the mutex
             owner_=tf;
+            profile_.acquired(this, false);
             return;
         }
         // This mutex is locked
         // Add this thread into waiting queue
-        suspended_.push_back(tf);
+        const detail::time_point_t since=boost::chrono::steady_clock::now();
+        suspended_.push_back({tf, since});
 
-        { detail::relock_guard<detail::spinlock> relock(mtx_); tf->pause(); }
+        for (;;) {
+            try {
+                detail::relock_guard<detail::spinlock> relock(mtx_);
+                tf->pause();
+            } catch(...) {
+                if (owner_!=tf) {
+                    // Woken in barging mode, let another waiter compete
+                    waking_=false;
+                    if (!owner_ && !suspended_.empty()) {
+                        waking_=true;
+                        detail::thread_ptr_t w(std::move(suspended_.front().f_));
+                        suspended_.pop_front();
+                        w->resume();
+                    }
+                } else if (suspended_.empty()) {
+                    // Handed the ownership while interrupted, give it up
+                    owner_.reset();
+                } else {
+                    // Handed the ownership while interrupted, pass it on
+                    std::swap(owner_, suspended_.front().f_);
+                    suspended_.pop_front();
+                    owner_->resume();
+                }
+                throw;
+            }
+            // The ownership has been handed to this thread
+            if (owner_==tf) {
+                profile_.acquired(this, true, since);
+                return;
+            }
+            // Woken in barging mode, compete with running threads
+            waking_=false;
+            if (!owner_) {
+                owner_=tf;
+                profile_.acquired(this, true, since);
+                return;
+            }
+            // Lost, wait again at the front of the queue
+            suspended_.push_front({tf, since});
+        }
     }
     
     void mutex::unlock() {
@@ -53,13 +96,28 @@ namespace boost { namespace green_thread {
             // This thread doesn't own the mutex
             BOOST_THROW_EXCEPTION(NOPERM);
         }
+        profile_.released(this);
         if (suspended_.empty()) {
             // Nobody is waiting
             owner_.reset();
             return;
         }
+        if (policy_==lock_policy::barging
+            && (boost::chrono::steady_clock::now()-suspended_.front().since_<starvation_threshold_))
+        {
+            // Release the mutex and wake the front waiter, unless another
+            // waiter has been woken and is about to compete
+            owner_.reset();
+            if (!waking_) {
+                waking_=true;
+                detail::thread_ptr_t w(std::move(suspended_.front().f_));
+                suspended_.pop_front();
+                w->resume();
+            }
+            return;
+        }
         // Set new owner and remove it from suspended queue
-        std::swap(owner_, suspended_.front());
+        std::swap(owner_, suspended_.front().f_);
         suspended_.pop_front();
         owner_->resume();
 
@@ -76,6 +134,7 @@ namespace boost { namespace green_thread {
             // This mutex is not locked
             // Acquire the mutex
             owner_=tf;
+            profile_.acquired(this, false);
         }
         // Return true if this thread owns the mutex
         return owner_==tf;
@@ -91,17 +150,59 @@ namespace boost { namespace green_thread {
         } else if(!owner_) {
             // This mutex is not locked
             // Acquire the mutex
-            assert(suspended_.empty());
             assert(level_==0);
             owner_=tf;
             level_=1;
+            profile_.acquired(this, false);
             return;
         }
         // This mutex is locked
         // Add this thread into waiting queue
-        suspended_.push_back(tf);
+        const detail::time_point_t since=boost::chrono::steady_clock::now();
+        suspended_.push_back({tf, since});
         
-        { detail::relock_guard<detail::spinlock> relock(mtx_); tf->pause(); }
+        for (;;) {
+            try {
+                detail::relock_guard<detail::spinlock> relock(mtx_);
+                tf->pause();
+            } catch(...) {
+                if (owner_!=tf) {
+                    // Woken in barging mode, let another waiter compete
+                    waking_=false;
+                    if (!owner_ && !suspended_.empty()) {
+                        waking_=true;
+                        detail::thread_ptr_t w(std::move(suspended_.front().f_));
+                        suspended_.pop_front();
+                        w->resume();
+                    }
+                } else if (suspended_.empty()) {
+                    // Handed the ownership while interrupted, give it up
+                    owner_.reset();
+                    level_=0;
+                } else {
+                    // Handed the ownership while interrupted, pass it on
+                    std::swap(owner_, suspended_.front().f_);
+                    suspended_.pop_front();
+                    owner_->resume();
+                }
+                throw;
+            }
+            // The ownership has been handed to this thread
+            if (owner_==tf) {
+                profile_.acquired(this, true, since);
+                return;
+            }
+            // Woken in barging mode, compete with running threads
+            waking_=false;
+            if (!owner_) {
+                owner_=tf;
+                level_=1;
+                profile_.acquired(this, true, since);
+                return;
+            }
+            // Lost, wait again at the front of the queue
+            suspended_.push_front({tf, since});
+        }
     }
     
     void recursive_mutex::unlock() {
@@ -117,14 +218,29 @@ namespace boost { namespace green_thread {
             // This thread still owns the mutex
             return;
         }
+        profile_.released(this);
         if (suspended_.empty()) {
             // Nobody is waiting
             owner_.reset();
             assert(level_==0);
             return;
         }
+        if (policy_==lock_policy::barging
+            && (boost::chrono::steady_clock::now()-suspended_.front().since_<starvation_threshold_))
+        {
+            // Release the mutex and wake the front waiter, unless another
+            // waiter has been woken and is about to compete
+            owner_.reset();
+            if (!waking_) {
+                waking_=true;
+                detail::thread_ptr_t w(std::move(suspended_.front().f_));
+                suspended_.pop_front();
+                w->resume();
+            }
+            return;
+        }
         // Set new owner and remove it from suspended queue
-        std::swap(owner_, suspended_.front());
+        std::swap(owner_, suspended_.front().f_);
         suspended_.pop_front();
         level_=1;
         owner_->resume();
@@ -142,10 +258,10 @@ namespace boost { namespace green_thread {
         } else if(!owner_) {
             // This mutex is not locked
             // Acquire the mutex
-            assert(suspended_.empty());
             assert(level_==0);
             owner_=tf;
             level_=1;
+            profile_.acquired(this, false);
         }
         // Cannot acquire the lock now
         return owner_==tf;
@@ -161,13 +277,16 @@ namespace boost { namespace green_thread {
             // This mutex is not locked
             // Acquire the mutex
             owner_=tf;
+            profile_.acquired(this, false);
             return;
         }
         // This mutex is locked
         // Add this thread into waiting queue without attached timer
+        const detail::time_point_t since=profile_.now();
         suspended_.push_back({tf, 0});
         
         { detail::relock_guard<detail::spinlock> relock(mtx_); tf->pause(); }
+        profile_.acquired(this, true, since);
     }
     
     bool timed_mutex::try_lock() {
@@ -181,6 +300,7 @@ namespace boost { namespace green_thread {
             // This mutex is not locked
             // Acquire the mutex
             owner_=tf;
+            profile_.acquired(this, false);
             return true;
         }
         // Cannot acquire the lock now
@@ -195,6 +315,7 @@ namespace boost { namespace green_thread {
             // This thread doesn't own the mutex
             BOOST_THROW_EXCEPTION(NOPERM);
         }
+        profile_.released(this);
         if (suspended_.empty()) {
             // Nobody is waiting
             owner_.reset();
@@ -244,10 +365,12 @@ namespace boost { namespace green_thread {
             // This mutex is not locked
             // Acquire the mutex
             owner_=tf;
+            profile_.acquired(this, false);
             return true;
         }
         // This mutex is locked
         // Add this thread into waiting queue
+        const detail::time_point_t since=profile_.now();
         detail::timer_t t(tf->get_io_service());
         t.expires_from_now(d);
         t.async_wait(tf->get_thread_strand().wrap(std::bind(&timed_mutex::timeout_handler,
@@ -259,6 +382,9 @@ namespace boost { namespace green_thread {
         // This thread will be resumed when timer triggered/canceled or other called unlock()
         { detail::relock_guard<detail::spinlock> relock(mtx_); tf->pause(); }
         
+        if (owner_==tf) {
+            profile_.acquired(this, true, since);
+        }
         return owner_==tf;
     }
 
@@ -274,13 +400,16 @@ namespace boost { namespace green_thread {
             // Acquire the mutex
             owner_=tf;
             level_=1;
+            profile_.acquired(this, false);
             return;
         }
         // This mutex is locked
         // Add this thread into waiting queue without attached timer
+        const detail::time_point_t since=profile_.now();
         suspended_.push_back({tf, 0});
         
         { detail::relock_guard<detail::spinlock> relock(mtx_); tf->pause(); }
+        profile_.acquired(this, true, since);
     }
     
     void recursive_timed_mutex::unlock() {
@@ -296,6 +425,7 @@ namespace boost { namespace green_thread {
             // This thread still owns the mutex
             return;
         }
+        profile_.released(this);
         if (suspended_.empty()) {
             // Nobody is waiting
             owner_.reset();
@@ -330,6 +460,7 @@ namespace boost { namespace green_thread {
             // Acquire the mutex
             owner_=tf;
             level_=1;
+            profile_.acquired(this, false);
         }
         // Cannot acquire the lock now
         return owner_==tf;
@@ -364,10 +495,12 @@ namespace boost { namespace green_thread {
             // Acquire the mutex
             owner_=tf;
             level_=1;
+            profile_.acquired(this, false);
             return true;
         }
         // This mutex is locked
         // Add this thread into waiting queue
+        const detail::time_point_t since=profile_.now();
         detail::timer_t t(tf->get_io_service());
         t.expires_from_now(d);
         t.async_wait(tf->get_thread_strand().wrap(std::bind(&recursive_timed_mutex::timeout_handler,
@@ -378,6 +511,138 @@ namespace boost { namespace green_thread {
         
         // This thread will be resumed when timer triggered/canceled or other called unlock()
         { detail::relock_guard<detail::spinlock> relock(mtx_); tf->pause(); }
+        if (owner_==tf) {
+            profile_.acquired(this, true, since);
+        }
         return owner_==tf;
     }
+    
+    namespace {
+        // Token of an unpark which hands the ownership over
+        const uintptr_t HANDOFF=1;
+    }
+    
+    struct hybrid_mutex::waker : detail::unpark_handler {
+        explicit waker(hybrid_mutex &m)
+        : m_(m)
+        {}
+        
+        virtual uintptr_t operator()(bool /*unparked*/, bool has_more) override {
+            if (!has_more) {
+                m_.state_.fetch_and(uint8_t(~PARKED), boost::memory_order_relaxed);
+            }
+            return 0;
+        }
+        
+        hybrid_mutex &m_;
+    };
+    
+    struct hybrid_mutex::parker : detail::park_handler {
+        explicit parker(hybrid_mutex &m)
+        : m_(m)
+        {}
+        
+        virtual bool validate() override {
+            // Park only if the unlocker will see us
+            return m_.state_.load(boost::memory_order_relaxed)==(LOCKED|PARKED);
+        }
+        
+        virtual void timed_out(bool was_last) override {
+            if (was_last) {
+                m_.state_.fetch_and(uint8_t(~PARKED), boost::memory_order_relaxed);
+            }
+        }
+        
+        virtual void interrupted(uintptr_t token) override {
+            if (token==HANDOFF) {
+                m_.unlock();
+            } else if (m_.state_.load(boost::memory_order_relaxed)==PARKED) {
+                // Pass the wakeup on, others may wait for an unlocked mutex
+                waker w(m_);
+                detail::unpark_one(&m_, &w);
+            }
+        }
+        
+        hybrid_mutex &m_;
+    };
+    
+    struct hybrid_mutex::unparker : detail::unpark_handler {
+        explicit unparker(hybrid_mutex &m)
+        : m_(m)
+        {}
+        
+        virtual uintptr_t operator()(bool unparked, bool has_more) override {
+            const uint8_t parked=has_more ? PARKED : 0;
+            bool handoff=unparked;
+            if (unparked && m_.policy_==lock_policy::barging) {
+                // Hand over once in a while so parked threads don't starve
+                const auto now=boost::chrono::steady_clock::now();
+                handoff=(now>=m_.fair_at_);
+                if (handoff) m_.fair_at_=now+m_.starvation_threshold_;
+            }
+            if (handoff) {
+                // Keep it locked, owned by the unparked thread now
+                m_.state_.store(LOCKED|parked, boost::memory_order_relaxed);
+                return HANDOFF;
+            }
+            m_.state_.store(parked, boost::memory_order_release);
+            return 0;
+        }
+        
+        hybrid_mutex &m_;
+    };
+    
+    bool hybrid_mutex::try_lock() {
+        uint8_t s=state_.load(boost::memory_order_relaxed);
+        while (!(s & LOCKED)) {
+            if (state_.compare_exchange_weak(s, s|LOCKED, boost::memory_order_acquire, boost::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    bool hybrid_mutex::lock_slow(const detail::time_point_t *deadline) {
+        parker p(*this);
+        int spin=0;
+        for (;;) {
+            uint8_t s=state_.load(boost::memory_order_relaxed);
+            if (!(s & LOCKED)) {
+                // Barging, may jump ahead of parked threads
+                if (state_.compare_exchange_weak(s, s|LOCKED, boost::memory_order_acquire, boost::memory_order_relaxed)) {
+                    return true;
+                }
+                continue;
+            }
+            if (!(s & PARKED)) {
+                // Spin a little while nobody parks, the owner may be running
+                if (spin<10) {
+                    spin++;
+                    if (auto cf=current_thread_object()) {
+                        cf->yield();
+                    } else {
+                        boost::this_thread::yield();
+                    }
+                    continue;
+                }
+                if (!state_.compare_exchange_weak(s, s|PARKED, boost::memory_order_relaxed, boost::memory_order_relaxed)) {
+                    continue;
+                }
+            }
+            detail::park_result r=detail::park(this, p, deadline);
+            if (r.unparked && r.token==HANDOFF) {
+                // The unlocker left the mutex locked for us
+                return true;
+            }
+            if (!r.unparked && deadline && boost::chrono::steady_clock::now()>=*deadline) {
+                return try_lock();
+            }
+            spin=0;
+        }
+    }
+    
+    void hybrid_mutex::unlock_slow() {
+        unparker u(*this);
+        detail::unpark_one(this, &u);
+    }
 }}  // End of namespace boost::green_thread
@@ -0,0 +1,123 @@
+//
+//  parking_lot.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/detail/waiter.hpp>
+
+namespace boost { namespace green_thread { namespace detail {
+    namespace {
+        struct parked : waiter {
+            explicit parked(const void *addr) : addr_(addr) {}
+            const void *addr_;
+            uintptr_t token_=0;
+        };
+        
+        struct bucket {
+            spinlock mtx_;
+            waiter_queue queue_;
+            char padding_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        };
+        
+        enum { bucket_bits=8, bucket_count=1<<bucket_bits };
+        
+        bucket buckets[bucket_count];
+        
+        bucket &bucket_for(const void *addr) {
+            // Fibonacci hashing
+            const uint64_t h=uint64_t(reinterpret_cast<uintptr_t>(addr))*UINT64_C(0x9E3779B97F4A7C15);
+            return buckets[h>>(64-bucket_bits)];
+        }
+        
+        parked *find(waiter *w, const void *addr) {
+            for (; w; w=w->next_) {
+                if (static_cast<parked *>(w)->addr_==addr) return static_cast<parked *>(w);
+            }
+            return nullptr;
+        }
+    }
+    
+    park_result park(const void *addr, park_handler &handler, const time_point_t *deadline) {
+        bucket &b=bucket_for(addr);
+        parked w(addr);
+        {
+            boost::lock_guard<spinlock> lock(b.mtx_);
+            if (!handler.validate()) {
+                park_result ret={false, 0};
+                return ret;
+            }
+            if (deadline) {
+                w.expires_at(*deadline);
+            }
+            b.queue_.push_back(&w);
+        }
+        bool notified;
+        try {
+            notified=w.wait();
+        } catch(...) {
+            if (w.notified()) {
+                handler.interrupted(w.token_);
+            } else {
+                boost::lock_guard<spinlock> lock(b.mtx_);
+                if (w.linked_) {
+                    b.queue_.erase(&w);
+                    handler.timed_out(!find(b.queue_.front(), addr));
+                }
+            }
+            throw;
+        }
+        if (!notified) {
+            boost::lock_guard<spinlock> lock(b.mtx_);
+            // An unparker may have dropped us already
+            if (w.linked_) {
+                b.queue_.erase(&w);
+                handler.timed_out(!find(b.queue_.front(), addr));
+            }
+        }
+        park_result ret={notified, notified ? w.token_ : 0};
+        return ret;
+    }
+    
+    bool unpark_one(const void *addr, unpark_handler *handler) {
+        bucket &b=bucket_for(addr);
+        boost::lock_guard<spinlock> lock(b.mtx_);
+        while (parked *w=find(b.queue_.front(), addr)) {
+            const bool has_more=find(w->next_, addr)!=nullptr;
+            b.queue_.erase(w);
+            if (handler) {
+                w->token_=(*handler)(true, has_more);
+            }
+            // Notify under the lock, a timed out waiter leaves only after
+            // taking the lock
+            if (w->notify()) return true;
+            // Timed out, try the next one
+        }
+        if (handler) {
+            (*handler)(false, false);
+        }
+        return false;
+    }
+    
+    size_t unpark_all(const void *addr, uintptr_t token) {
+        bucket &b=bucket_for(addr);
+        boost::lock_guard<spinlock> lock(b.mtx_);
+        size_t n=0;
+        parked *w=find(b.queue_.front(), addr);
+        while (w) {
+            parked *next=find(w->next_, addr);
+            b.queue_.erase(w);
+            w->token_=token;
+            if (w->notify()) n++;
+            w=next;
+        }
+        return n;
+    }
+}}} // End of namespace boost::green_thread::detail
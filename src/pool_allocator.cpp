@@ -0,0 +1,103 @@
+//
+//  pool_allocator.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/thread/tss.hpp>
+#include <boost/green_thread/detail/forward.hpp>
+#include <boost/green_thread/pool_allocator.hpp>
+#include "thread_object.hpp"
+
+namespace {
+    // Size classes are multiples of 32 bytes up to 1KB
+    constexpr std::size_t granularity=32;
+    constexpr std::size_t classes=32;
+    // Blocks kept per size class and thread, the rest goes back to the global allocator
+    constexpr std::size_t max_cached=256;
+    
+    struct free_block {
+        free_block *next_;
+    };
+    
+    struct thread_cache {
+        free_block *heads_[classes]={};
+        std::size_t counts_[classes]={};
+        
+        ~thread_cache();
+    };
+    
+    THREAD_LOCAL thread_cache *current_cache=nullptr;
+    // Set once the cache of the thread is gone, blocks freed by later
+    // thread exit handlers skip the pool
+    THREAD_LOCAL bool cache_destroyed=false;
+    
+    // Owns the caches, so they are freed on thread exit
+    boost::thread_specific_ptr<thread_cache> &cache_owner() {
+        static boost::thread_specific_ptr<thread_cache> owner;
+        return owner;
+    }
+    
+    thread_cache::~thread_cache() {
+        for (std::size_t i=0; i<classes; i++) {
+            while (free_block *b=heads_[i]) {
+                heads_[i]=b->next_;
+                ::operator delete(b);
+            }
+        }
+        current_cache=nullptr;
+        cache_destroyed=true;
+    }
+    
+    thread_cache *get_cache() {
+        if (!current_cache && !cache_destroyed) {
+            current_cache=new thread_cache;
+            cache_owner().reset(current_cache);
+        }
+        return current_cache;
+    }
+}   // End of anonymous namespace
+
+namespace boost { namespace green_thread { namespace detail {
+    void *pool_allocate(std::size_t bytes) {
+        if (bytes==0) bytes=1;
+        const std::size_t c=(bytes-1)/granularity;
+        if (c>=classes) return ::operator new(bytes);
+        if (thread_cache *tc=get_cache()) {
+            if (free_block *b=tc->heads_[c]) {
+                tc->heads_[c]=b->next_;
+                tc->counts_[c]--;
+                return b;
+            }
+        }
+        return ::operator new((c+1)*granularity);
+    }
+    
+    void pool_deallocate(void *p, std::size_t bytes) noexcept {
+        if (!p) return;
+        if (bytes==0) bytes=1;
+        const std::size_t c=(bytes-1)/granularity;
+        if (c<classes) {
+            thread_cache *tc=current_cache;
+            if (!tc && !cache_destroyed) {
+                try {
+                    tc=get_cache();
+                } catch(...) {
+                    tc=nullptr;
+                }
+            }
+            if (tc && tc->counts_[c]<max_cached) {
+                free_block *b=static_cast<free_block *>(p);
+                b->next_=tc->heads_[c];
+                tc->heads_[c]=b;
+                tc->counts_[c]++;
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+}}} // End of namespace boost::green_thread::detail
@@ -14,9 +14,17 @@
 #include "scheduler_object.hpp"
 
 namespace boost { namespace green_thread { namespace detail {
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+    static boost::atomic<uint64_t> profile_serials(0);
+#endif
+    
     scheduler_object::scheduler_object()
     : thread_count_(0)
     , started_(false)
+    , pool_(*this)
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+    , profile_serial_(++profile_serials)
+#endif
     {}
     
     thread_ptr_t scheduler_object::make_thread(thread_data_base *entry) {
@@ -77,6 +85,7 @@ namespace boost { namespace green_thread { namespace detail {
         threads_.clear();
         started_=false;
         io_service_.reset();
+        pool_.reopen();
     }
     
     void scheduler_object::add_thread(size_t nthr) {
@@ -101,6 +110,10 @@ namespace boost { namespace green_thread { namespace detail {
     
     void scheduler_object::on_check_timer(boost::system::error_code ec) {
         boost::lock_guard<boost::mutex> guard(mtx_);
+        if (thread_count_>0 && thread_count_==pool_.idle_count()) {
+            // Nothing but idle pool threads left, let them exit first
+            pool_.close();
+        }
         if (thread_count_>0 || !started_) {
             check_timer->expires_from_now(boost::chrono::milliseconds(50));
             check_timer->async_wait(std::bind(&scheduler_object::on_check_timer, shared_from_this(), std::placeholders::_1));
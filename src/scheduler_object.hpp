@@ -13,11 +13,64 @@
 
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include <boost/asio/io_service.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
 #include "thread_object.hpp"
 
 namespace boost { namespace green_thread { namespace detail {
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+    struct lock_samples {
+        uint64_t acquisitions=0;
+        uint64_t contentions=0;
+        duration_t total_wait=duration_t::zero();
+        duration_t max_wait=duration_t::zero();
+        duration_t max_hold=duration_t::zero();
+    };
+    
+    // Lock statistics recorded by one worker thread, only the worker writes
+    // it, the spinlock is taken against readers
+    struct lock_profile_buffer {
+        spinlock mtx_;
+        std::unordered_map<const void *, lock_samples> samples_;
+    };
+#endif
+    
+    /**
+     * Threads of a scheduler kept alive between `launch::pool` tasks
+     *
+     * A task is handed to the most recently idle thread if there is one,
+     * otherwise a new thread is started for it, so tasks never wait for
+     * each other. Idle threads stay parked until the scheduler has nothing
+     * else to run.
+     */
+    struct async_pool {
+        /// Idle threads beyond this exit
+        static constexpr size_t max_idle=64;
+        
+        explicit async_pool(scheduler_object &sched);
+        
+        /// Runs `task` on a pool thread, takes ownership
+        void post(thread_data_base *task);
+        
+        size_t idle_count() const;
+        
+        /// Lets idle threads exit, tasks posted afterwards get short-lived threads
+        void close();
+        void reopen();
+        
+    private:
+        struct worker;
+        void wake(worker *w, thread_data_base *task);
+        void run(thread_data_base *task);
+        
+        scheduler_object &sched_;
+        mutable spinlock mtx_;
+        std::vector<worker *> idle_;
+        bool closed_=false;
+    };
+    
     struct scheduler_object : std::enable_shared_from_this<scheduler_object> {
         scheduler_object();
         thread_ptr_t make_thread(thread_data_base *entry);
@@ -40,6 +93,14 @@ namespace boost { namespace green_thread { namespace detail {
         boost::atomic<size_t> thread_count_;
         boost::atomic<bool> started_;
         std::unique_ptr<timer_t> check_timer;
+        async_pool pool_;
+        
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+        // Lock statistics buffers of worker threads, guarded by mtx_
+        std::vector<std::unique_ptr<lock_profile_buffer>> profile_buffers_;
+        // Tells apart schedulers reusing the same address
+        const uint64_t profile_serial_;
+#endif
         
         //static std::once_flag instance_inited_;
         //static std::shared_ptr<scheduler_object> the_instance_;
@@ -0,0 +1,103 @@
+//
+//  select.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/select.hpp>
+
+namespace boost { namespace green_thread {
+    namespace detail {
+        select_state::select_state()
+        : waiter_(nullptr)
+        , signaled_(false)
+        {}
+
+        void select_state::reset() {
+            boost::lock_guard<spinlock> lock(mtx_);
+            signaled_=false;
+        }
+
+        void select_state::signal() {
+            boost::lock_guard<spinlock> lock(mtx_);
+            signaled_=true;
+            if (waiter_) {
+                waiter_->notify();
+                waiter_=nullptr;
+            }
+        }
+
+        bool select_state::park(const time_point_t *deadline) {
+            waiter w;
+            {
+                boost::lock_guard<spinlock> lock(mtx_);
+                if (signaled_) return true;
+                if (deadline) {
+                    w.expires_at(*deadline);
+                }
+                waiter_=&w;
+            }
+            struct guard {
+                select_state *s_;
+                ~guard() {
+                    // The waiter must not be touched once this function returns
+                    boost::lock_guard<spinlock> lock(s_->mtx_);
+                    s_->waiter_=nullptr;
+                }
+            } g={this};
+            return w.wait();
+        }
+    }   // End of namespace boost::green_thread::detail
+
+    constexpr size_t selector::timeout;
+
+    selector::selector()
+    : state_(std::make_shared<detail::select_state>())
+    {}
+
+    selector::~selector() {}
+
+    size_t selector::add_case(std::unique_ptr<detail::select_case> c) {
+        cases_.push_back(std::move(c));
+        return cases_.size()-1;
+    }
+
+    size_t selector::try_select() {
+        const size_t n=cases_.size();
+        // Start from a different case every time so no source starves the others
+        const size_t first=next_++;
+        for (size_t k=0; k<n; k++) {
+            const size_t i=(first+k)%n;
+            if (cases_[i]->try_complete(ok_)) return i;
+        }
+        return timeout;
+    }
+
+    size_t selector::select_until(const detail::time_point_t *deadline) {
+        for (;;) {
+            state_->reset();
+            size_t i=try_select();
+            if (i!=timeout) return i;
+            struct unsubscriber {
+                std::vector<std::unique_ptr<detail::select_case>> &cases_;
+                size_t n_;
+                ~unsubscriber() {
+                    for (size_t i=0; i<n_; i++) cases_[i]->unsubscribe();
+                }
+            } g={cases_, 0};
+            for (auto &c : cases_) {
+                c->subscribe(*state_);
+                g.n_++;
+            }
+            if (!state_->park(deadline)) {
+                // Timed out, one last chance for sources fired meanwhile
+                return try_select();
+            }
+        }
+    }
+}}  // End of namespace boost::green_thread
@@ -0,0 +1,110 @@
+//
+//  semaphore.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <cassert>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/semaphore.hpp>
+
+namespace boost { namespace green_thread {
+    counting_semaphore::counting_semaphore(std::ptrdiff_t desired)
+    : count_(desired)
+    , waiters_(0)
+    {
+        assert(desired>=0);
+    }
+
+    bool counting_semaphore::try_take(std::ptrdiff_t n) noexcept {
+        std::ptrdiff_t c=count_.load();
+        while (c>=n) {
+            if (count_.compare_exchange_weak(c, c-n)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool counting_semaphore::try_acquire(std::ptrdiff_t n) noexcept {
+        assert(n>0);
+        // Don't jump the queue
+        return waiters_.load()==0 && try_take(n);
+    }
+
+    void counting_semaphore::acquire(std::ptrdiff_t n) {
+        if (try_acquire(n)) return;
+        acquire_slow(n, 0);
+    }
+
+    void counting_semaphore::release(std::ptrdiff_t update) {
+        assert(update>=0);
+        count_.fetch_add(update);
+        // Pairs with the waiter count increment in acquire_slow, either the
+        // acquirer sees the new count or we see the acquirer
+        if (waiters_.load()==0) return;
+        boost::lock_guard<detail::spinlock> lock(mtx_);
+        dispatch();
+    }
+
+    void counting_semaphore::dispatch() {
+        // Grant units to waiters in FIFO order, as many as the counter allows
+        while (!queue_.empty()) {
+            acquirer *w=static_cast<acquirer *>(queue_.front());
+            if (!try_take(w->n_)) break;
+            queue_.pop_front();
+            waiters_.fetch_sub(1);
+            if (!w->notify()) {
+                // Timed out, give the units back, the waiter cleans up under the lock
+                count_.fetch_add(w->n_);
+            }
+        }
+    }
+
+    bool counting_semaphore::acquire_slow(std::ptrdiff_t n, const detail::time_point_t *deadline) {
+        assert(n>0);
+        if (try_acquire(n)) return true;
+        acquirer w(n);
+        {
+            boost::lock_guard<detail::spinlock> lock(mtx_);
+            if (deadline) {
+                w.expires_at(*deadline);
+            }
+            waiters_.fetch_add(1);
+            queue_.push_back(&w);
+            // Units may have been released before we were queued
+            dispatch();
+        }
+        bool ret;
+        try {
+            ret=w.wait();
+        } catch(...) {
+            // Interrupted after resumed
+            if (w.notified()) {
+                release(n);
+            } else {
+                boost::lock_guard<detail::spinlock> lock(mtx_);
+                if (w.linked_) {
+                    queue_.erase(&w);
+                    waiters_.fetch_sub(1);
+                }
+                dispatch();
+            }
+            throw;
+        }
+        if (!ret) {
+            // Timed out, leave the queue, waiters behind may be satisfied now
+            boost::lock_guard<detail::spinlock> lock(mtx_);
+            if (w.linked_) {
+                queue_.erase(&w);
+                waiters_.fetch_sub(1);
+            }
+            dispatch();
+        }
+        return ret;
+    }
+}}  // End of namespace boost::green_thread
@@ -0,0 +1,193 @@
+//
+//  shared_mutex.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/thread/thread_only.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/thread_only.hpp>
+#include <boost/green_thread/shared_mutex.hpp>
+
+namespace boost { namespace green_thread {
+    namespace {
+        // Reader bias stays inhibited for N times of the time spent on revocation
+        const detail::duration_t::rep inhibit_multiplier=9;
+
+        inline detail::duration_t::rep now() {
+            return boost::chrono::steady_clock::now().time_since_epoch().count();
+        }
+
+        inline size_t slot_index(uintptr_t id, size_t count) {
+            // Thread ids are addresses of thread objects, drop alignment bits
+            uintptr_t h=id>>4;
+            h^=(h>>5)^(h>>11);
+            return h % count;
+        }
+    }
+
+    shared_mutex::shared_mutex()
+    : reader_bias_(true)
+    , inhibit_until_(0)
+    {
+        for (slot &s : slots_) {
+            s.reader_.store(0, boost::memory_order_relaxed);
+        }
+    }
+
+    bool shared_mutex::try_fast_lock_shared(uintptr_t id) {
+        // Foreign threads always take the underlying lock
+        if (id==not_a_thread || !reader_bias_.load(boost::memory_order_acquire)) {
+            return false;
+        }
+        slot &s=slots_[slot_index(id, slot_count)];
+        uintptr_t expected=0;
+        if (!s.reader_.compare_exchange_strong(expected, id)) {
+            // Slot collision, or this thread already holds a shared lock
+            return false;
+        }
+        if (reader_bias_.load()) {
+            // Published before any writer revoked the bias
+            return true;
+        }
+        // A writer is revoking the bias, unpublish and take the slow path
+        s.reader_.store(0);
+        boost::lock_guard<mutex> lock(revocation_mtx_);
+        revocation_cv_.notify_all();
+        return false;
+    }
+
+    void shared_mutex::after_slow_lock_shared() {
+        // Writers are excluded while we hold the underlying lock
+        if (!reader_bias_.load(boost::memory_order_relaxed)
+            && now()>=inhibit_until_.load(boost::memory_order_relaxed))
+        {
+            reader_bias_.store(true);
+        }
+    }
+
+    bool shared_mutex::revoke(const detail::time_point_t *deadline) {
+        reader_bias_.store(false);
+        const detail::duration_t::rep start=now();
+        if (this_thread::is_a_thread()) {
+            boost::unique_lock<mutex> lock(revocation_mtx_);
+            for (slot &s : slots_) {
+                while (s.reader_.load()!=0) {
+                    if (!deadline) {
+                        revocation_cv_.wait(lock);
+                    } else if (revocation_cv_.wait_until(lock, *deadline)==cv_status::timeout
+                               && s.reader_.load()!=0)
+                    {
+                        // Published readers are still there, restore the bias
+                        reader_bias_.store(true);
+                        return false;
+                    }
+                }
+            }
+        } else {
+            // Foreign thread cannot wait on the condition variable
+            for (slot &s : slots_) {
+                while (s.reader_.load()!=0) {
+                    if (deadline && boost::chrono::steady_clock::now()>=*deadline) {
+                        reader_bias_.store(true);
+                        return false;
+                    }
+                    boost::this_thread::yield();
+                }
+            }
+        }
+        const detail::duration_t::rep end=now();
+        inhibit_until_.store(end+(end-start)*inhibit_multiplier, boost::memory_order_relaxed);
+        return true;
+    }
+
+    void shared_mutex::lock() {
+        underlying_.lock();
+        if (reader_bias_.load(boost::memory_order_relaxed)) {
+            revoke(0);
+        }
+    }
+
+    bool shared_mutex::try_lock() {
+        if (!underlying_.try_lock()) {
+            return false;
+        }
+        if (!reader_bias_.load(boost::memory_order_relaxed)) {
+            return true;
+        }
+        // Cannot wait for published readers
+        const detail::time_point_t deadline=boost::chrono::steady_clock::now();
+        if (revoke(&deadline)) {
+            return true;
+        }
+        underlying_.unlock();
+        return false;
+    }
+
+    bool shared_mutex::try_lock_rel(detail::duration_t d) {
+        const detail::time_point_t deadline=boost::chrono::steady_clock::now()+d;
+        if (!underlying_.try_lock_until(deadline)) {
+            return false;
+        }
+        if (!reader_bias_.load(boost::memory_order_relaxed) || revoke(&deadline)) {
+            return true;
+        }
+        underlying_.unlock();
+        return false;
+    }
+
+    void shared_mutex::unlock() {
+        underlying_.unlock();
+    }
+
+    void shared_mutex::lock_shared() {
+        if (try_fast_lock_shared(this_thread::get_id())) {
+            return;
+        }
+        underlying_.lock_shared();
+        after_slow_lock_shared();
+    }
+
+    bool shared_mutex::try_lock_shared() {
+        if (try_fast_lock_shared(this_thread::get_id())) {
+            return true;
+        }
+        if (!underlying_.try_lock_shared()) {
+            return false;
+        }
+        after_slow_lock_shared();
+        return true;
+    }
+
+    bool shared_mutex::try_lock_shared_rel(detail::duration_t d) {
+        if (try_fast_lock_shared(this_thread::get_id())) {
+            return true;
+        }
+        if (!underlying_.try_lock_shared_for(d)) {
+            return false;
+        }
+        after_slow_lock_shared();
+        return true;
+    }
+
+    void shared_mutex::unlock_shared() {
+        const uintptr_t id=this_thread::get_id();
+        if (id!=not_a_thread) {
+            slot &s=slots_[slot_index(id, slot_count)];
+            if (s.reader_.load(boost::memory_order_relaxed)==id) {
+                s.reader_.store(0);
+                if (!reader_bias_.load()) {
+                    // A writer may be waiting for this slot
+                    boost::lock_guard<mutex> lock(revocation_mtx_);
+                    revocation_cv_.notify_all();
+                }
+                return;
+            }
+        }
+        underlying_.unlock_shared();
+    }
+}}  // End of namespace boost::green_thread
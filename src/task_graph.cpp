@@ -0,0 +1,203 @@
+//
+//  task_graph.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <algorithm>
+#include <ostream>
+#include <boost/atomic.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/green_thread/exceptions.hpp>
+#include <boost/green_thread/latch.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/future/async.hpp>
+#include <boost/green_thread/task_graph.hpp>
+
+namespace boost { namespace green_thread {
+    // Shared with the pool threads, the last one to count down may still
+    // be inside the latch when run() returns
+    struct task_graph::run_state {
+        explicit run_state(size_t n)
+        : pending_(new boost::atomic<size_t>[n])
+        , start_(n)
+        , end_(n)
+        , ran_(n, false)
+        , failed_(false)
+        , done_(n)
+        {}
+
+        std::unique_ptr<boost::atomic<size_t>[]> pending_;
+        detail::time_point_t started_;
+        // Each slot is only written by the thread running the node
+        std::vector<detail::time_point_t> start_;
+        std::vector<detail::time_point_t> end_;
+        std::vector<char> ran_;
+        boost::atomic<bool> failed_;
+        detail::spinlock error_mtx_;
+        std::exception_ptr error_;
+        latch done_;
+    };
+
+    task_graph::task_graph()
+    : running_(false)
+    {}
+
+    task_graph::~task_graph() {}
+
+    task_graph::node_id task_graph::add(std::function<void()> fn, const std::string &name) {
+        if (running_) BOOST_THROW_EXCEPTION(invalid_argument(boost::system::errc::operation_not_permitted));
+        nodes_.push_back(node{std::move(fn), name, std::vector<node_id>(), 0});
+        order_.clear();
+        return nodes_.size()-1;
+    }
+
+    void task_graph::precede(node_id before, node_id after) {
+        if (running_) BOOST_THROW_EXCEPTION(invalid_argument(boost::system::errc::operation_not_permitted));
+        if (before>=nodes_.size() || after>=nodes_.size() || before==after) {
+            BOOST_THROW_EXCEPTION(invalid_argument());
+        }
+        nodes_[before].successors_.push_back(after);
+        nodes_[after].predecessors_++;
+        order_.clear();
+    }
+
+    size_t task_graph::size() const {
+        return nodes_.size();
+    }
+
+    const task_graph::timing_report &task_graph::report() const {
+        return report_;
+    }
+
+    void task_graph::sort() {
+        // Kahn's algorithm, nodes left over are on a cycle
+        std::vector<size_t> in(nodes_.size());
+        std::vector<node_id> order;
+        order.reserve(nodes_.size());
+        for (node_id i=0; i<nodes_.size(); i++) {
+            in[i]=nodes_[i].predecessors_;
+            if (in[i]==0) order.push_back(i);
+        }
+        for (size_t k=0; k<order.size(); k++) {
+            for (node_id s : nodes_[order[k]].successors_) {
+                if (--in[s]==0) order.push_back(s);
+            }
+        }
+        if (order.size()!=nodes_.size()) {
+            BOOST_THROW_EXCEPTION(invalid_argument(boost::system::errc::invalid_argument, "task_graph has a cycle"));
+        }
+        order_.swap(order);
+    }
+
+    void task_graph::run() {
+        if (running_) BOOST_THROW_EXCEPTION(invalid_argument(boost::system::errc::operation_not_permitted));
+        if (order_.size()!=nodes_.size()) sort();
+        const size_t n=nodes_.size();
+        std::shared_ptr<run_state> s=std::make_shared<run_state>(n);
+        for (node_id i=0; i<n; i++) {
+            s->pending_[i].store(nodes_[i].predecessors_, boost::memory_order_relaxed);
+        }
+        running_=true;
+        s->started_=boost::chrono::steady_clock::now();
+        for (node_id i=0; i<n; i++) {
+            if (nodes_[i].predecessors_==0) {
+                detail::post_to_pool(detail::make_thread_data(&task_graph::execute, this, s, i));
+            }
+        }
+        s->done_.wait();
+        running_=false;
+        report_.wall_time=boost::chrono::steady_clock::now()-s->started_;
+        make_report(*s);
+        if (s->error_) std::rethrow_exception(s->error_);
+    }
+
+    void task_graph::execute(const std::shared_ptr<run_state> &s, node_id id) const {
+        for (;;) {
+            const node &nd=nodes_[id];
+            if (!s->failed_.load(boost::memory_order_relaxed)) {
+                s->start_[id]=boost::chrono::steady_clock::now();
+                std::exception_ptr error;
+                try {
+                    nd.fn_();
+                } catch(...) {
+                    error=std::current_exception();
+                }
+                s->end_[id]=boost::chrono::steady_clock::now();
+                s->ran_[id]=true;
+                if (error) {
+                    boost::lock_guard<detail::spinlock> lock(s->error_mtx_);
+                    if (!s->error_) s->error_=error;
+                    s->failed_.store(true, boost::memory_order_relaxed);
+                }
+            }
+            // Keeps one of the successors made ready for this thread
+            node_id next=id;
+            for (node_id succ : nd.successors_) {
+                if (s->pending_[succ].fetch_sub(1, boost::memory_order_acq_rel)==1) {
+                    if (next==id) {
+                        next=succ;
+                    } else {
+                        detail::post_to_pool(detail::make_thread_data(&task_graph::execute, this, s, succ));
+                    }
+                }
+            }
+            s->done_.count_down();
+            if (next==id) return;
+            id=next;
+        }
+    }
+
+    void task_graph::make_report(const run_state &s) {
+        const size_t n=nodes_.size();
+        report_.nodes.resize(n);
+        for (node_id i=0; i<n; i++) {
+            node_timing &t=report_.nodes[i];
+            t.name=nodes_[i].name_;
+            t.ran=s.ran_[i]!=0;
+            t.start=t.ran ? s.start_[i]-s.started_ : detail::duration_t::zero();
+            t.duration=t.ran ? s.end_[i]-s.start_[i] : detail::duration_t::zero();
+        }
+        // Longest chain by total duration, in topological order
+        std::vector<detail::duration_t> finish(n, detail::duration_t::zero());
+        std::vector<node_id> parent(n, n);
+        node_id last=n;
+        for (node_id v : order_) {
+            finish[v]+=report_.nodes[v].duration;
+            if (last==n || finish[v]>finish[last]) last=v;
+            for (node_id succ : nodes_[v].successors_) {
+                if (parent[succ]==n || finish[v]>finish[succ]) {
+                    finish[succ]=finish[v];
+                    parent[succ]=v;
+                }
+            }
+        }
+        report_.critical_path.clear();
+        report_.critical_path_time=detail::duration_t::zero();
+        if (last==n) return;
+        report_.critical_path_time=finish[last];
+        for (node_id v=last; v!=n; v=parent[v]) {
+            report_.critical_path.push_back(v);
+        }
+        std::reverse(report_.critical_path.begin(), report_.critical_path.end());
+    }
+
+    std::ostream &operator<<(std::ostream &os, const task_graph::timing_report &r) {
+        typedef boost::chrono::microseconds us;
+        os << "wall time: " << boost::chrono::duration_cast<us>(r.wall_time).count() << "us, "
+           << "critical path: " << boost::chrono::duration_cast<us>(r.critical_path_time).count() << "us\n";
+        for (task_graph::node_id v : r.critical_path) {
+            const task_graph::node_timing &t=r.nodes[v];
+            os << "  #" << v;
+            if (!t.name.empty()) os << " " << t.name;
+            os << ": start " << boost::chrono::duration_cast<us>(t.start).count() << "us, "
+               << "duration " << boost::chrono::duration_cast<us>(t.duration).count() << "us\n";
+        }
+        return os;
+    }
+}}  // End of namespace boost::green_thread
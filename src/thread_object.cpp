@@ -313,6 +313,17 @@ namespace boost { namespace green_thread { namespace detail {
         sleep_timer.expires_from_now(d);
         sleep_timer.async_wait(std::bind(&thread_object::activate, shared_from_this()));
 
+        // Interruption wakes up the thread early, the timer handler still
+        // resumes it exactly once
+        struct canceller : interrupt_hook {
+            explicit canceller(timer_t &t) : t_(t) {}
+            void on_interrupt() noexcept override {
+                boost::system::error_code ec;
+                t_.cancel(ec);
+            }
+            timer_t &t_;
+        } hook(sleep_timer);
+        scoped_interrupt_hook guard(hook);
         pause();
     }
     
@@ -325,6 +336,32 @@ namespace boost { namespace green_thread { namespace detail {
         boost::lock_guard<spinlock> lock(mtx_);
         if (interrupt_disable_level_==0) {
             interrupt_requested_=true;
+            for (interrupt_hook *h=interrupt_hooks_; h; h=h->next_) {
+                h->on_interrupt();
+            }
+        }
+    }
+    
+    void attach_interrupt_hook(interrupt_hook *h) {
+        if (auto cf=current_thread_object()) {
+            boost::lock_guard<spinlock> lock(cf->mtx_);
+            h->next_=cf->interrupt_hooks_;
+            cf->interrupt_hooks_=h;
+            if (cf->interrupt_disable_level_==0 && cf->interrupt_requested_) {
+                h->on_interrupt();
+            }
+        }
+    }
+    
+    void detach_interrupt_hook(interrupt_hook *h) {
+        if (auto cf=current_thread_object()) {
+            boost::lock_guard<spinlock> lock(cf->mtx_);
+            for (interrupt_hook **p=&cf->interrupt_hooks_; *p; p=&(*p)->next_) {
+                if (*p==h) {
+                    *p=h->next_;
+                    break;
+                }
+            }
         }
     }
     
@@ -493,10 +530,7 @@ namespace boost { namespace green_thread {
         if (!impl_) {
             BOOST_THROW_EXCEPTION(NOT_A_THREAD);
         }
-        boost::lock_guard<detail::spinlock> lock(impl_->mtx_);
-        if (impl_->interrupt_disable_level_==0) {
-            impl_->interrupt_requested_=true;
-        }
+        impl_->interrupt();
     }
     
     namespace this_thread {
@@ -592,6 +626,27 @@ namespace boost { namespace green_thread {
             }
         }
         
+        interruption_callback::interruption_callback(std::function<void()> fn)
+        : fn_(std::move(fn))
+        {
+            if (!current_thread_object()) {
+                BOOST_THROW_EXCEPTION(NOT_A_THREAD);
+            }
+            green_thread::detail::attach_interrupt_hook(this);
+        }
+        
+        interruption_callback::~interruption_callback() {
+            green_thread::detail::detach_interrupt_hook(this);
+        }
+        
+        void interruption_callback::on_interrupt() noexcept {
+            try {
+                fn_();
+            } catch(...) {
+                // Nothing can be done with it on the interrupting side
+            }
+        }
+        
         bool interruption_enabled() noexcept {
             if (auto cf=current_thread_object()) {
                 boost::lock_guard<green_thread::detail::spinlock> lock(cf->mtx_);
@@ -603,7 +658,7 @@ namespace boost { namespace green_thread {
         bool interruption_requested() noexcept {
             if (auto cf=current_thread_object()) {
                 boost::lock_guard<green_thread::detail::spinlock> lock(cf->mtx_);
-                return cf->interrupt_requested_==0;
+                return cf->interrupt_requested_;
             }
             return false;
         }
@@ -27,6 +27,7 @@
 #include <boost/green_thread/detail/thread_base.hpp>
 #include <boost/green_thread/detail/thread_data.hpp>
 #include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/detail/interrupt_hook.hpp>
 
 #ifdef __APPLE_CC__
 // Clang on OS X doesn't support thread_local
@@ -139,6 +140,15 @@ namespace boost { namespace green_thread { namespace detail {
         void interrupt();
         int interrupt_disable_level_=0;
         bool interrupt_requested_=false;
+        // Hooks run on interruption, protected by mtx_
+        interrupt_hook *interrupt_hooks_=nullptr;
+        
+        // Nesting of inline future continuations
+        int continuation_depth_=0;
+        
+        // Work stealing pool this thread is a worker of, and its index there
+        const void *ws_pool_=nullptr;
+        size_t ws_index_=0;
     };
     
     template<typename Lockable>
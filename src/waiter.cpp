@@ -0,0 +1,136 @@
+//
+//  waiter.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/green_thread/detail/interrupt_hook.hpp>
+#include <boost/green_thread/detail/waiter.hpp>
+#include "thread_object.hpp"
+
+namespace boost { namespace green_thread { namespace detail {
+    // Foreign threads block on a native event
+    struct waiter::foreign_event {
+        boost::mutex mtx_;
+        boost::condition_variable cv_;
+    };
+
+    struct waiter::interrupter : interrupt_hook {
+        explicit interrupter(waiter &w) : w_(w) {}
+        void on_interrupt() noexcept override { w_.interrupt(); }
+        waiter &w_;
+    };
+
+    waiter::waiter()
+    : state_(WAITING)
+    {
+        if (auto cf=current_thread_object()) {
+            thread_=cf->shared_from_this();
+        } else {
+            event_.reset(new foreign_event);
+        }
+    }
+
+    waiter::~waiter() {}
+
+    void waiter::expires_at(time_point_t t) {
+        if (thread_) {
+            timer_.reset(new timer_t(thread_->get_io_service()));
+            timer_->expires_at(t);
+            timer_->async_wait(thread_->get_thread_strand().wrap(std::bind(&waiter::timeout_handler,
+                                                                           this,
+                                                                           std::placeholders::_1)));
+        } else {
+            deadline_=t;
+            has_deadline_=true;
+        }
+    }
+
+    void waiter::timeout_handler(boost::system::error_code /*ec*/) {
+        // Expired or canceled, the state tells which side won
+        int expected=WAITING;
+        if (!state_.compare_exchange_strong(expected, TIMEOUT)) {
+            // Notified or interrupted, wait for the other side to finish with the timer
+            while (state_.load()==NOTIFYING || state_.load()==INTERRUPTING) {}
+        }
+        // The timer handler always resumes the thread if there is a timer
+        thread_->resume();
+    }
+
+    bool waiter::wait(bool interruptible) {
+        if (thread_) {
+            if (!interruptible) {
+                // Will be resumed by notify() or the timer handler
+                thread_->pause();
+                return notified();
+            }
+            // Will be resumed by notify(), the timer handler or an interruption
+            interrupter hook(*this);
+            scoped_interrupt_hook guard(hook);
+            thread_->pause();
+            return notified();
+        }
+        boost::unique_lock<boost::mutex> lock(event_->mtx_);
+        while (state_.load()!=NOTIFIED) {
+            if (!has_deadline_) {
+                event_->cv_.wait(lock);
+            } else if (event_->cv_.wait_until(lock, deadline_)==boost::cv_status::timeout) {
+                int expected=WAITING;
+                if (state_.compare_exchange_strong(expected, TIMEOUT)) {
+                    return false;
+                }
+                // A notifier is in progress
+            }
+        }
+        return true;
+    }
+
+    void waiter::interrupt() {
+        // Gives up waiting like a timeout, pause() throws once resumed
+        int expected=WAITING;
+        if (!state_.compare_exchange_strong(expected, INTERRUPTING)) {
+            return;
+        }
+        if (timer_) {
+            // The timer handler will resume the thread
+            boost::system::error_code ec;
+            timer_->cancel(ec);
+            state_.store(TIMEOUT);
+        } else {
+            thread_ptr_t t(thread_);
+            state_.store(TIMEOUT);
+            t->resume();
+        }
+    }
+
+    bool waiter::notify() {
+        int expected=WAITING;
+        if (!state_.compare_exchange_strong(expected, NOTIFYING)) {
+            return false;
+        }
+        if (thread_) {
+            if (timer_) {
+                // Cancel the timer, the timer handler will resume the thread
+                timer_->cancel();
+                state_.store(NOTIFIED);
+            } else {
+                // The waiter may be gone as soon as the thread is resumed
+                thread_ptr_t t(thread_);
+                state_.store(NOTIFIED);
+                t->resume();
+            }
+        } else {
+            boost::lock_guard<boost::mutex> lock(event_->mtx_);
+            state_.store(NOTIFIED);
+            event_->cv_.notify_one();
+        }
+        return true;
+    }
+}}} // End of namespace boost::green_thread::detail
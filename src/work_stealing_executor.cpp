@@ -0,0 +1,165 @@
+//
+//  work_stealing_executor.cpp
+//  Boost.GreenThread
+//
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// Copyright (c) 2015 Chen Xu
+//
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/green_thread/detail/parking_lot.hpp>
+#include <boost/green_thread/detail/spinlock.hpp>
+#include <boost/green_thread/future/work_stealing_executor.hpp>
+#include "thread_object.hpp"
+
+namespace boost { namespace green_thread { namespace detail {
+    struct work_stealing_pool {
+        struct worker {
+            spinlock mtx_;
+            std::deque<thread_data_base *> tasks_;
+            // Queues of different workers don't share cache lines
+            char padding_[BOOST_GREEN_THREAD_CACHELINE_SIZE];
+        };
+
+        // Workers sleep while there is nothing to take
+        struct sleeper : park_handler {
+            explicit sleeper(work_stealing_pool &p) : p_(p) {}
+            bool validate() override
+            { return p_.queued_.load()==0 && !p_.closed_.load(); }
+            work_stealing_pool &p_;
+        };
+
+        explicit work_stealing_pool(size_t n)
+        : workers_(new worker[n])
+        , size_(n)
+        , queued_(0)
+        , sleeping_(0)
+        , next_(0)
+        , closed_(false)
+        {}
+
+        ~work_stealing_pool() {
+            for (size_t i=0; i<size_; i++) {
+                for (thread_data_base *t : workers_[i].tasks_) delete t;
+            }
+        }
+
+        void start() {
+            for (size_t i=0; i<size_; i++) {
+                threads_.push_back(thread(&work_stealing_pool::run, this, i));
+            }
+        }
+
+        void stop() {
+            closed_.store(true);
+            unpark_all(this);
+            for (thread &t : threads_) t.join();
+        }
+
+        /// Worker of the calling thread, null if it isn't one of ours
+        worker *current_worker() {
+            thread_object *cf=current_thread_object();
+            if (!cf || cf->ws_pool_!=this) return nullptr;
+            return &workers_[cf->ws_index_];
+        }
+
+        void push(thread_data_base *task) {
+            worker *w=current_worker();
+            if (!w) w=&workers_[next_.fetch_add(1, boost::memory_order_relaxed)%size_];
+            // Counted first so the count never goes below the queued tasks
+            queued_.fetch_add(1);
+            {
+                boost::lock_guard<spinlock> lock(w->mtx_);
+                w->tasks_.push_back(task);
+            }
+            if (sleeping_.load()>0) unpark_one(this);
+        }
+
+        thread_data_base *pop(size_t i) {
+            // Newest of our own first, it is likely still in the cache
+            {
+                worker &w=workers_[i];
+                boost::lock_guard<spinlock> lock(w.mtx_);
+                if (!w.tasks_.empty()) {
+                    thread_data_base *t=w.tasks_.back();
+                    w.tasks_.pop_back();
+                    return t;
+                }
+            }
+            // Then the oldest of the others
+            for (size_t k=1; k<size_; k++) {
+                worker &w=workers_[(i+k)%size_];
+                boost::lock_guard<spinlock> lock(w.mtx_);
+                if (!w.tasks_.empty()) {
+                    thread_data_base *t=w.tasks_.front();
+                    w.tasks_.pop_front();
+                    return t;
+                }
+            }
+            return nullptr;
+        }
+
+        void run(size_t i) {
+            thread_object *cf=current_thread_object();
+            cf->ws_pool_=this;
+            cf->ws_index_=i;
+            sleeper s(*this);
+            for (;;) {
+                if (thread_data_base *t=pop(i)) {
+                    queued_.fetch_sub(1);
+                    std::unique_ptr<thread_data_base> task(t);
+                    try {
+                        task->run();
+                    } catch(...) {
+                        // Only functions given to post() throw, nobody
+                        // waits for them, the worker carries on
+                    }
+                    continue;
+                }
+                // A task is being pushed
+                if (queued_.load()>0) continue;
+                if (closed_.load()) break;
+                sleeping_.fetch_add(1);
+                park(this, s);
+                sleeping_.fetch_sub(1);
+            }
+            cf->ws_pool_=nullptr;
+        }
+
+        std::unique_ptr<worker[]> workers_;
+        const size_t size_;
+        std::vector<thread> threads_;
+        // Tasks pushed and not taken yet, across all queues
+        boost::atomic<size_t> queued_;
+        boost::atomic<size_t> sleeping_;
+        boost::atomic<size_t> next_;
+        boost::atomic<bool> closed_;
+    };
+}}} // End of namespace boost::green_thread::detail
+
+namespace boost { namespace green_thread {
+    work_stealing_executor::work_stealing_executor(size_t pool_size) {
+        if (pool_size==0) pool_size=std::min(get_scheduler().worker_pool_size(),
+                                             size_t(boost::thread::hardware_concurrency()));
+        impl_.reset(new detail::work_stealing_pool(std::max(pool_size, size_t(1))));
+        impl_->start();
+    }
+
+    work_stealing_executor::~work_stealing_executor() {
+        impl_->stop();
+    }
+
+    size_t work_stealing_executor::size() const {
+        return impl_->size_;
+    }
+
+    void work_stealing_executor::push(detail::thread_data_base *task) {
+        impl_->push(task);
+    }
+}}  // End of namespace boost::green_thread
@@ -0,0 +1,180 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/algorithm.hpp>
+#include <boost/green_thread/task_graph.hpp>
+
+using namespace boost::green_thread;
+
+BOOST_AUTO_TEST_CASE(test_parallel_for) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        std::vector<int> v(10000, 1);
+        parallel_for(v.begin(), v.end(), [](int &x){ x*=3; });
+        BOOST_CHECK(std::count(v.begin(), v.end(), 3)==10000);
+
+        // Indices, with a given grain
+        std::vector<boost::atomic<int>> hits(1000);
+        for (auto &h : hits) h=0;
+        parallel_for(0, 1000, [&](int i){ hits[i]++; }, 7);
+        BOOST_CHECK(std::all_of(hits.begin(), hits.end(), [](const boost::atomic<int> &h){ return h==1; }));
+
+        // Empty ranges and fewer elements than workers
+        parallel_for(v.begin(), v.begin(), [](int &){ BOOST_ERROR("called on empty range"); });
+        int one=0;
+        parallel_for(0, 1, [&](int){ one++; });
+        BOOST_CHECK(one==1);
+
+        BOOST_CHECK_THROW(parallel_for(0, 1000, [](int i){ if (i==500) throw std::runtime_error("x"); }),
+                          std::runtime_error);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_transform_reduce) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        std::vector<int> v(10000);
+        std::iota(v.begin(), v.end(), 0);
+        std::vector<long> out(v.size());
+        BOOST_CHECK(parallel_transform(v.begin(), v.end(), out.begin(), [](int x){ return long(x)*x; })==out.end());
+        BOOST_CHECK(out[9999]==9999L*9999);
+
+        BOOST_CHECK(parallel_reduce(v.begin(), v.end(), 0L)==9999L*10000/2);
+        BOOST_CHECK(parallel_transform_reduce(v.begin(), v.end(), 0L, std::plus<long>(), [](int x){ return long(x)*x; })
+                    ==std::accumulate(out.begin(), out.end(), 0L));
+        BOOST_CHECK(parallel_reduce(v.begin(), v.begin(), 42)==42);
+
+        // Not commutative, order is kept
+        std::vector<std::string> s(500);
+        for (size_t i=0; i<s.size(); i++) s[i]=std::to_string(i%10);
+        std::string joined=std::accumulate(s.begin(), s.end(), std::string(">"));
+        BOOST_CHECK(parallel_reduce(s.begin(), s.end(), std::string(">"))==joined);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_sort) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        std::mt19937 rng(42);
+        std::vector<int> v(100000);
+        for (auto &x : v) x=rng()%1000;
+        std::vector<int> expected(v);
+        std::sort(expected.begin(), expected.end());
+        std::vector<int> w(v);
+        parallel_sort(v.begin(), v.end());
+        BOOST_CHECK(v==expected);
+        parallel_sort(w.begin(), w.end(), std::greater<int>(), 100);
+        BOOST_CHECK(std::equal(w.begin(), w.end(), expected.rbegin()));
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_scan) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        std::vector<long> v(10001);
+        std::iota(v.begin(), v.end(), 1);
+        std::vector<long> expected(v.size());
+        std::partial_sum(v.begin(), v.end(), expected.begin());
+        std::vector<long> out(v.size());
+        BOOST_CHECK(parallel_scan(v.begin(), v.end(), out.begin())==out.end());
+        BOOST_CHECK(out==expected);
+        // In place, with small pieces
+        parallel_scan(v.begin(), v.end(), v.begin(), std::plus<long>(), 13);
+        BOOST_CHECK(v==expected);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_task_graph) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        // Diamond, with a slow branch
+        boost::atomic<int> step(0);
+        std::vector<int> seen(4, -1);
+        task_graph g;
+        task_graph::node_id a=g.add([&](){ seen[0]=step++; }, "a");
+        task_graph::node_id b=g.add([&](){ this_thread::sleep_for(boost::chrono::milliseconds(20)); seen[1]=step++; }, "b");
+        task_graph::node_id c=g.add([&](){ seen[2]=step++; }, "c");
+        task_graph::node_id d=g.add([&](){ seen[3]=step++; }, "d");
+        g.precede(a, b);
+        g.precede(a, c);
+        g.precede(b, d);
+        g.precede(c, d);
+        BOOST_CHECK(g.size()==4);
+        // Reusable
+        for (int run=0; run<2; run++) {
+            step=0;
+            g.run();
+            BOOST_CHECK(seen[0]==0);
+            BOOST_CHECK(seen[1]>0 && seen[2]>0);
+            BOOST_CHECK(seen[3]==3);
+        }
+        const task_graph::timing_report &r=g.report();
+        BOOST_CHECK(r.critical_path==std::vector<task_graph::node_id>({a, b, d}));
+        BOOST_CHECK(r.critical_path_time>=boost::chrono::milliseconds(20));
+        BOOST_CHECK(r.wall_time>=r.critical_path_time);
+        BOOST_CHECK(r.nodes[d].start>=r.nodes[b].start+r.nodes[b].duration);
+
+        // Wide fan-out and fan-in
+        task_graph w;
+        boost::atomic<int> sum(0);
+        task_graph::node_id root=w.add([](){});
+        task_graph::node_id sink=w.add([&](){ BOOST_CHECK(sum==100); });
+        for (int i=0; i<100; i++) {
+            task_graph::node_id n=w.add([&sum](){ sum++; });
+            w.precede(root, n);
+            w.precede(n, sink);
+        }
+        w.run();
+        BOOST_CHECK(sum==100);
+
+        // The successors of a failed node are skipped
+        task_graph f;
+        bool skipped=true;
+        task_graph::node_id x=f.add([](){ throw std::runtime_error("x"); });
+        task_graph::node_id y=f.add([&](){ skipped=false; });
+        f.precede(x, y);
+        BOOST_CHECK_THROW(f.run(), std::runtime_error);
+        BOOST_CHECK(skipped);
+        BOOST_CHECK(f.report().nodes[x].ran);
+        BOOST_CHECK(!f.report().nodes[y].ran);
+
+        // Cycles and bad edges
+        f.precede(y, x);
+        BOOST_CHECK_THROW(f.run(), invalid_argument);
+        BOOST_CHECK_THROW(f.precede(x, x), invalid_argument);
+        BOOST_CHECK_THROW(f.precede(x, 5), invalid_argument);
+
+        // Not while running
+        task_graph busy;
+        boost::system::error_code busy_ec;
+        busy.add([&](){
+            try {
+                busy.add([](){});
+            } catch(const invalid_argument &e) {
+                busy_ec=e.code();
+            }
+        });
+        busy.run();
+        BOOST_CHECK(busy_ec==boost::system::errc::operation_not_permitted);
+        BOOST_CHECK(busy.size()==1);
+
+        task_graph empty;
+        empty.run();
+        BOOST_CHECK(empty.report().critical_path.empty());
+    });
+}
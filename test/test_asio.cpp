@@ -43,3 +43,27 @@ BOOST_AUTO_TEST_CASE(asio_with_future) {
     });
     BOOST_REQUIRE(status==future_status::timeout);
 }
+
+BOOST_AUTO_TEST_CASE(asio_cancel_on_interrupt) {
+    bool interrupted=false;
+    boost::chrono::steady_clock::duration elapsed;
+    greenify_with_sched(scheduler(), [&](){
+        auto start=boost::chrono::steady_clock::now();
+        thread f([&interrupted](){
+            my_timer_t timer(asio::get_io_service());
+            timer.expires_from_now(boost::chrono::seconds(3));
+            try {
+                asio::cancel_on_interrupt<my_timer_t> guard(timer);
+                timer.async_wait(asio::yield);
+            } catch(const thread_interrupted &) {
+                interrupted=true;
+            }
+        });
+        this_thread::sleep_for(boost::chrono::milliseconds(100));
+        f.interrupt();
+        f.join();
+        elapsed=boost::chrono::steady_clock::now()-start;
+    });
+    BOOST_REQUIRE(interrupted);
+    BOOST_REQUIRE(elapsed<boost::chrono::seconds(3));
+}
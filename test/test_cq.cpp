@@ -1,6 +1,7 @@
 #define BOOST_TEST_MAIN
 #include <boost/test/unit_test.hpp>
 
+#include <boost/thread/thread.hpp>
 #include <boost/green_thread.hpp>
 #define BOOST_DONT_GREENIFY_STD_STREAM
 #define BOOST_DONT_GREENIFY_MAIN
@@ -44,3 +45,694 @@ BOOST_AUTO_TEST_CASE(asio_with_yield) {
     });
     BOOST_REQUIRE(sum==result);
 }
+
+BOOST_AUTO_TEST_CASE(ring_queue) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Small ring, producers and consumers park on full and empty
+        concurrent_queue<int, mpmc_ring<int>> q(8);
+        BOOST_CHECK_EQUAL(q.capacity(), 8);
+        boost::atomic<long> total(0);
+        barrier done(10);
+        thread_group threads;
+        for (int n=0; n<10; n++) {
+            threads.create_thread([&](){
+                for (size_t i=1; i<=max_num; i++) {
+                    q.push(i);
+                }
+                if (done.wait()) q.close();
+            });
+        }
+        for (int n=0; n<4; n++) {
+            threads.create_thread([&](){
+                long s=0;
+                for (int popped : q) {
+                    s+=popped;
+                }
+                total+=s;
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(total, max_num*(max_num+1)/2*10);
+        BOOST_CHECK(!q.push(1));
+        
+        // Closing races with producers, every successful push is popped
+        for (int round=0; round<50; round++) {
+            concurrent_queue<int, mpmc_ring<int>> r(16);
+            boost::atomic<long> pushed(0);
+            boost::atomic<long> popped(0);
+            thread_group racers;
+            for (int n=0; n<4; n++) {
+                racers.create_thread([&](){
+                    while (r.push(1)) pushed++;
+                });
+            }
+            for (int n=0; n<2; n++) {
+                racers.create_thread([&](){
+                    for (int x : r) popped+=x;
+                });
+            }
+            this_thread::sleep_for(boost::chrono::microseconds(100*(round%5)));
+            r.close();
+            racers.join_all();
+            BOOST_CHECK_EQUAL(pushed, popped);
+        }
+        
+        // Timed operations
+        concurrent_queue<int, mpmc_ring<int>> t(2);
+        int v=0;
+        BOOST_CHECK(!t.try_pop_for(v, boost::chrono::milliseconds(10)));
+        BOOST_CHECK(t.try_push(1));
+        BOOST_CHECK(t.try_push(2));
+        BOOST_CHECK(!t.try_push(3));
+        BOOST_CHECK(!t.try_push_for(3, boost::chrono::milliseconds(10)));
+        thread consumer([&](){
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+            int x;
+            t.pop(x);
+        });
+        BOOST_CHECK(t.try_push_for(3, boost::chrono::seconds(5)));
+        consumer.join();
+        std::vector<int> out;
+        t.pop_some(std::back_inserter(out));
+        BOOST_CHECK(out==std::vector<int>({2, 3}));
+    });
+}
+
+template<typename Queue>
+void bulk_ops() {
+    // Producers push in batches, consumers drain in batches
+    Queue q(64);
+    const int producers=4;
+    const int batches=50;
+    boost::atomic<long> total(0);
+    boost::atomic<size_t> max_batch(0);
+    barrier done(producers);
+    thread_group threads;
+    for (int n=0; n<producers; n++) {
+        threads.create_thread([&](){
+            std::vector<int> batch;
+            for (size_t i=1; i<=max_num; i++) batch.push_back(i);
+            for (int b=0; b<batches; b++) {
+                BOOST_CHECK_EQUAL(q.push_bulk(batch), max_num);
+            }
+            if (done.wait()) q.close();
+        });
+    }
+    for (int n=0; n<3; n++) {
+        threads.create_thread([&](){
+            std::vector<int> out;
+            long s=0;
+            for (;;) {
+                out.clear();
+                q.pop_bulk(std::back_inserter(out), 16);
+                if (out.empty()) break;
+                size_t m=max_batch.load();
+                while (out.size()>m && !max_batch.compare_exchange_weak(m, out.size())) {}
+                for (int v : out) s+=v;
+            }
+            total+=s;
+        });
+    }
+    threads.join_all();
+    BOOST_CHECK_EQUAL(total, max_num*(max_num+1)/2*producers*batches);
+    BOOST_CHECK(max_batch<=16);
+    BOOST_CHECK_EQUAL(q.push_bulk(std::vector<int>({1, 2})), 0);
+    
+    // Timed bulk pop
+    Queue t(8);
+    std::vector<int> out;
+    auto start=boost::chrono::steady_clock::now();
+    t.pop_bulk(std::back_inserter(out), 4, boost::chrono::milliseconds(10));
+    BOOST_CHECK(out.empty());
+    BOOST_CHECK(boost::chrono::steady_clock::now()-start>=boost::chrono::milliseconds(10));
+    thread producer([&](){
+        this_thread::sleep_for(boost::chrono::milliseconds(10));
+        t.push_bulk(std::vector<int>({1, 2, 3, 4, 5, 6}));
+    });
+    while (out.size()<6) {
+        t.pop_bulk(std::back_inserter(out), 4, boost::chrono::seconds(5));
+    }
+    producer.join();
+    BOOST_CHECK(out==std::vector<int>({1, 2, 3, 4, 5, 6}));
+    
+    // Non-blocking drain
+    int items[]={7, 8, 9};
+    BOOST_CHECK(t.push_some(std::begin(items), std::end(items))==std::end(items));
+    out.clear();
+    t.pop_some(std::back_inserter(out), 2);
+    BOOST_CHECK(out==std::vector<int>({7, 8}));
+    t.pop_some(std::back_inserter(out));
+    BOOST_CHECK(out==std::vector<int>({7, 8, 9}));
+    BOOST_CHECK(t.empty());
+}
+
+BOOST_AUTO_TEST_CASE(bulk_queue) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        bulk_ops<concurrent_queue<int>>();
+        bulk_ops<concurrent_queue<int, mpmc_ring<int>>>();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(priority_queue_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Urgent messages jump ahead, equal priorities keep their order
+        typedef std::pair<int, int> msg;
+        struct by_priority {
+            bool operator()(const msg &a, const msg &b) const { return a.first<b.first; }
+        };
+        concurrent_priority_queue<msg, by_priority> q(8);
+        for (int i=0; i<3; i++) q.push(msg(0, i));
+        q.push(msg(1, 0));
+        q.push(msg(2, 0));
+        q.push(msg(1, 1));
+        msg m;
+        BOOST_CHECK(q.pop(m) && m==msg(2, 0));
+        BOOST_CHECK(q.pop(m) && m==msg(1, 0));
+        BOOST_CHECK(q.pop(m) && m==msg(1, 1));
+        std::vector<msg> out;
+        q.pop_bulk(std::back_inserter(out), 8);
+        BOOST_CHECK(out==std::vector<msg>({msg(0, 0), msg(0, 1), msg(0, 2)}));
+        
+        // Timed pop, bounded capacity
+        BOOST_CHECK(!q.try_pop_for(m, boost::chrono::milliseconds(10)));
+        for (int i=0; i<8; i++) BOOST_CHECK(q.try_push(msg(i%3, i)));
+        BOOST_CHECK(!q.try_push(msg(0, 0)));
+        
+        // Producers and consumers, close drains the rest
+        concurrent_priority_queue<int> pq(16);
+        boost::atomic<long> total(0);
+        barrier done(4);
+        thread_group threads;
+        for (int n=0; n<4; n++) {
+            threads.create_thread([&](){
+                for (size_t i=1; i<=max_num; i++) pq.push(i);
+                if (done.wait()) pq.close();
+            });
+        }
+        for (int n=0; n<2; n++) {
+            threads.create_thread([&](){
+                long s=0;
+                for (int v : pq) s+=v;
+                total+=s;
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(total, max_num*(max_num+1)/2*4);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(spill_queue_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Keeps the order across memory, segment files and the open segment
+        spill_options opts;
+        opts.memory_limit=16;
+        opts.segment_size=64*sizeof(int);
+        // Tiny segments come faster than the disk takes them
+        opts.max_unwritten=1000;
+        {
+            spill_buffer<int> b(opts);
+            for (int round=0; round<4; round++) {
+                for (int i=0; i<1000; i++) b.push(i);
+                for (int i=0; i<1000; i++) {
+                    BOOST_CHECK_EQUAL(b.front(), i);
+                    b.pop();
+                }
+                BOOST_CHECK(b.empty());
+            }
+            // Files of consumed segments are reused
+            BOOST_CHECK(b.files_created()<4*1000/64);
+        }
+        {
+            // Every segment on disk first, the consumer waits for the reads
+            spill_buffer<int> b(opts);
+            for (int i=0; i<1000; i++) b.push(i);
+            for (int i=0; i<200 && b.segments_written()<(1000-16)/64; i++) {
+                this_thread::sleep_for(boost::chrono::milliseconds(5));
+            }
+            BOOST_CHECK_EQUAL(b.segments_written(), (1000-16)/64);
+            bool ordered=true;
+            for (int i=0; i<1000; i++) {
+                ordered=ordered && b.front()==i;
+                b.pop();
+            }
+            BOOST_CHECK(ordered);
+        }
+        
+        spill_buffer<std::string> sb(opts);
+        for (int i=0; i<100; i++) sb.push(std::string(i, 'x'));
+        for (size_t i=0; i<100; i++) {
+            BOOST_CHECK_EQUAL(sb.front().size(), i);
+            sb.pop();
+        }
+        
+        {
+            // Segments the disk can't take stay in memory up to the limit
+            spill_options bad=opts;
+            bad.path_prefix="/nonexistent-directory/spill_";
+            bad.max_unwritten=4;
+            spill_buffer<int> b(bad);
+            size_t pushed=0;
+            try {
+                for ( ; pushed<100000; pushed++) b.push(int(pushed));
+            } catch(const thread_resource_error &e) {
+                BOOST_CHECK(e.code()==boost::system::errc::no_buffer_space);
+            }
+            BOOST_CHECK(pushed<=16+(4+1)*64);
+            BOOST_CHECK(pushed>=16+4*64);
+            for (size_t i=0; i<pushed; i++) {
+                BOOST_CHECK_EQUAL(b.front(), int(i));
+                b.pop();
+            }
+        }
+        
+        // Producers never wait for consumers on an unbounded queue with
+        // bounded memory, all of them are done before the consumers start
+        spilling_queue<int> q(spilling_queue<int>::size_type(-1), true, opts);
+        boost::atomic<long> total(0);
+        barrier done(4);
+        thread_group threads;
+        for (int n=0; n<4; n++) {
+            threads.create_thread([&](){
+                for (size_t i=1; i<=max_num*10; i++) q.push(i);
+                if (done.wait()) q.close();
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(q.size(), size_t(max_num*10*4));
+        for (int n=0; n<2; n++) {
+            threads.create_thread([&](){
+                long s=0;
+                for (int v : q) s+=v;
+                total+=s;
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(total, max_num*10*(max_num*10+1)/2*4);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(select_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Consume two queues in one thread until both are closed
+        concurrent_queue<int> q1(4), q2(4);
+        thread_group threads;
+        threads.create_thread([&](){
+            for (size_t i=1; i<=max_num; i++) q1.push(i);
+            q1.close();
+        });
+        threads.create_thread([&](){
+            for (size_t i=1; i<=max_num; i++) q2.push(i*2);
+            q2.close();
+        });
+        long s1=0, s2=0;
+        int v1=0, v2=0;
+        selector sel;
+        const size_t c1=sel.on_pop(q1, v1);
+        const size_t c2=sel.on_pop(q2, v2);
+        bool open1=true, open2=true;
+        while (open1 || open2) {
+            size_t i=sel.wait();
+            if (i==c1) {
+                if (sel.ok()) s1+=v1; else open1=false;
+            } else if (i==c2) {
+                if (sel.ok()) s2+=v2; else open2=false;
+            }
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(s1, max_num*(max_num+1)/2);
+        BOOST_CHECK_EQUAL(s2, max_num*(max_num+1));
+        
+        // Timeout, then push into whichever queue has room first
+        concurrent_queue<int> full1(1), full2(1);
+        full1.push(0);
+        full2.push(0);
+        selector pusher;
+        const size_t p1=pusher.on_push(full1, 1);
+        const size_t p2=pusher.on_push(full2, 2);
+        BOOST_CHECK_EQUAL(pusher.try_select(), selector::timeout);
+        auto start=boost::chrono::steady_clock::now();
+        BOOST_CHECK_EQUAL(pusher.wait_for(boost::chrono::milliseconds(10)), selector::timeout);
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start>=boost::chrono::milliseconds(10));
+        thread consumer([&](){
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+            int x;
+            full2.pop(x);
+        });
+        BOOST_CHECK_EQUAL(pusher.wait_for(boost::chrono::seconds(5)), p2);
+        BOOST_CHECK(pusher.ok());
+        consumer.join();
+        int x=0;
+        full2.pop(x);
+        BOOST_CHECK_EQUAL(x, 2);
+        full2.push(0);
+        full1.close();
+        BOOST_CHECK_EQUAL(pusher.wait(), p1);
+        BOOST_CHECK(!pusher.ok());
+        
+        // Stop signal from a future
+        concurrent_queue<int> idle;
+        promise<void> stop;
+        future<void> stopped=stop.get_future();
+        selector waiter;
+        int unused;
+        waiter.on_pop(idle, unused);
+        const size_t s=waiter.on_ready(stopped);
+        thread stopper([&](){
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+            stop.set_value();
+        });
+        BOOST_CHECK_EQUAL(waiter.wait(), s);
+        stopper.join();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(spsc_channel_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Streaming through a small channel
+        const int n=100000;
+        spsc_channel<int> c(16);
+        BOOST_CHECK_EQUAL(c.capacity(), 16);
+        thread producer([&](){
+            for (int i=1; i<=n; i++) {
+                c.push(i);
+            }
+            c.close();
+        });
+        long long s=0;
+        int expected=1;
+        bool ordered=true;
+        for (int popped : c) {
+            ordered=ordered && (popped==expected++);
+            s+=popped;
+        }
+        producer.join();
+        BOOST_CHECK(ordered);
+        BOOST_CHECK_EQUAL(s, (long long)n*(n+1)/2);
+        BOOST_CHECK(!c.push(1));
+        
+        // Foreign producer, green consumer
+        spsc_channel<int> f(4);
+        boost::thread foreign([&](){
+            for (int i=0; i<1000; i++) {
+                f.push(i);
+            }
+            f.close();
+        });
+        int count=0;
+        int v;
+        while (f.pop(v)) count++;
+        foreign.join();
+        BOOST_CHECK_EQUAL(count, 1000);
+        
+        // Timed operations
+        spsc_channel<int> t(2);
+        BOOST_CHECK(!t.try_pop_for(v, boost::chrono::milliseconds(10)));
+        BOOST_CHECK(t.try_push(1));
+        BOOST_CHECK(t.try_push(2));
+        BOOST_CHECK(!t.try_push_for(3, boost::chrono::milliseconds(10)));
+        BOOST_CHECK(t.try_pop(v) && v==1);
+        BOOST_CHECK(t.try_push_for(3, boost::chrono::milliseconds(10)));
+        BOOST_CHECK_EQUAL(t.size(), 2);
+    });
+}
+
+struct message : mailbox_node {
+    explicit message(int v) : value(v) {}
+    int value;
+};
+
+BOOST_AUTO_TEST_CASE(mailbox_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Many green senders and a foreign one, one receiver
+        mailbox<message> mb;
+        const int senders=20;
+        thread_group threads;
+        for (int n=0; n<senders; n++) {
+            threads.create_thread([&](){
+                for (size_t i=1; i<=max_num; i++) {
+                    mb.push(std::unique_ptr<message>(new message(i)));
+                    if (i%10==0) this_thread::yield();
+                }
+            });
+        }
+        boost::thread foreign([&](){
+            for (size_t i=1; i<=max_num; i++) {
+                mb.push(std::unique_ptr<message>(new message(i)));
+            }
+        });
+        long s=0;
+        for (size_t n=0; n<(senders+1)*max_num; n++) {
+            std::unique_ptr<message> m=mb.pop();
+            BOOST_REQUIRE(m);
+            s+=m->value;
+        }
+        threads.join_all();
+        foreign.join();
+        BOOST_CHECK_EQUAL(s, max_num*(max_num+1)/2*(senders+1));
+        BOOST_CHECK(mb.empty());
+        BOOST_CHECK(!mb.try_pop());
+        
+        // Timed receive
+        auto start=boost::chrono::steady_clock::now();
+        BOOST_CHECK(!mb.try_pop_for(boost::chrono::milliseconds(10)));
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start>=boost::chrono::milliseconds(10));
+        thread sender([&](){
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+            mb.push(std::unique_ptr<message>(new message(42)));
+        });
+        std::unique_ptr<message> m=mb.try_pop_for(boost::chrono::seconds(5));
+        BOOST_CHECK(m && m->value==42);
+        sender.join();
+        
+        // Messages sent before closing are still received
+        mb.push(std::unique_ptr<message>(new message(1)));
+        mb.close();
+        BOOST_CHECK(!mb.push(std::unique_ptr<message>(new message(2))));
+        m=mb.pop();
+        BOOST_CHECK(m && m->value==1);
+        BOOST_CHECK(!mb.pop());
+        
+        // Closing while sending, every accepted message is received
+        for (int round=0; round<50; round++) {
+            mailbox<message> racing;
+            boost::atomic<long> accepted(0);
+            thread_group racers;
+            for (int n=0; n<4; n++) {
+                racers.create_thread([&](){
+                    for (size_t i=1; i<=max_num; i++) {
+                        if (!racing.push(std::unique_ptr<message>(new message(i)))) break;
+                        accepted++;
+                        if (i%10==0) this_thread::yield();
+                    }
+                });
+            }
+            boost::thread foreign_racer([&](){
+                for (size_t i=1; i<=max_num; i++) {
+                    if (!racing.push(std::unique_ptr<message>(new message(i)))) break;
+                    accepted++;
+                }
+            });
+            this_thread::yield();
+            racing.close();
+            long received=0;
+            while (racing.pop()) received++;
+            racers.join_all();
+            foreign_racer.join();
+            BOOST_CHECK_EQUAL(received, accepted.load());
+            BOOST_CHECK(!racing.try_pop());
+        }
+        
+        // Leftovers are deleted with the mailbox
+        mailbox<message> left;
+        left.push(std::unique_ptr<message>(new message(1)));
+        left.push(std::unique_ptr<message>(new message(2)));
+    });
+}
+
+BOOST_AUTO_TEST_CASE(broadcast_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Every subscriber sees every message in order, the publisher waits for the slowest
+        const int n=10000;
+        broadcast_channel<int> c(16);
+        BOOST_CHECK_EQUAL(c.capacity(), 16);
+        boost::atomic<int> ready(0);
+        boost::atomic<long> total(0);
+        boost::atomic<bool> ordered(true);
+        thread_group threads;
+        for (int k=0; k<8; k++) {
+            threads.create_thread([&, k](){
+                broadcast_channel<int>::subscriber sub(c);
+                ++ready;
+                int v, expected=1;
+                long s=0;
+                while (sub.receive(v)) {
+                    if (v!=expected++) ordered=false;
+                    s+=v;
+                    if (k==0 && v%100==0) this_thread::sleep_for(boost::chrono::milliseconds(1));
+                }
+                BOOST_CHECK_EQUAL(sub.dropped(), 0);
+                total+=s;
+            });
+        }
+        while (ready<8) this_thread::yield();
+        std::vector<int> batch;
+        for (int i=1; i<=n; i++) {
+            batch.push_back(i);
+            if (batch.size()==10) {
+                BOOST_CHECK_EQUAL(c.publish_bulk(batch.begin(), batch.end()), 10);
+                batch.clear();
+            }
+        }
+        c.close();
+        threads.join_all();
+        BOOST_CHECK(ordered);
+        BOOST_CHECK_EQUAL(total, (long)n*(n+1)/2*8);
+        BOOST_CHECK(!c.publish(1));
+        
+        // A slow subscriber drops or gets disconnected instead of blocking the publisher
+        broadcast_channel<int> lossy(4, overflow_policy::drop);
+        broadcast_channel<int>::subscriber slow(lossy);
+        for (int i=0; i<10; i++) BOOST_CHECK(lossy.publish(i));
+        int v;
+        BOOST_CHECK(slow.try_receive(v));
+        BOOST_CHECK_EQUAL(v, 6);
+        BOOST_CHECK_EQUAL(slow.dropped(), 6);
+        
+        broadcast_channel<int> strict(4, overflow_policy::disconnect);
+        broadcast_channel<int>::subscriber gone(strict);
+        for (int i=0; i<10; i++) BOOST_CHECK(strict.publish(i));
+        BOOST_CHECK(!gone.try_receive(v));
+        BOOST_CHECK(!gone.is_connected());
+        
+        // Timed receive, foreign publisher
+        auto start=boost::chrono::steady_clock::now();
+        BOOST_CHECK(!slow.try_receive_for(v, boost::chrono::milliseconds(10)) || v!=6);
+        broadcast_channel<int>::subscriber fresh(lossy);
+        BOOST_CHECK(!fresh.try_receive_for(v, boost::chrono::milliseconds(10)));
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start>=boost::chrono::milliseconds(10));
+        boost::thread foreign([&](){
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+            lossy.publish(42);
+        });
+        BOOST_CHECK(fresh.try_receive_for(v, boost::chrono::seconds(5)));
+        BOOST_CHECK_EQUAL(v, 42);
+        foreign.join();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(pipeline_test) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Parallel stages, restored to the input order
+        const int n=10000;
+        std::vector<int> out;
+        auto p=pipeline<int>(4, 16)
+            .stage("square", [](int x){
+                if (x%7==0) this_thread::yield();
+                return long(x)*x;
+            }, 4, true)
+            .stage("text", [](long x){ return std::to_string(x); }, 3, true)
+            .stage("parse", [&](std::string s){ out.push_back(std::stoi(s)); });
+        p.start();
+        for (int i=0; i<n; i++) BOOST_CHECK(p.push(i%100));
+        p.close();
+        p.wait();
+        BOOST_REQUIRE(out.size()==n);
+        bool ordered=true;
+        for (int i=0; i<n; i++) ordered=ordered && out[i]==(i%100)*(i%100);
+        BOOST_CHECK(ordered);
+        std::vector<pipeline_stage_stats> stats=p.stats();
+        BOOST_REQUIRE(stats.size()==3);
+        BOOST_CHECK(stats[0].name=="square" && stats[0].parallelism==4);
+        for (auto &s : stats) BOOST_CHECK(s.items==n);
+        BOOST_CHECK(p.bottleneck()<3);
+        
+        // Unordered, popped from the last stage
+        auto q=pipeline<int>(2, 8).stage("double", [](int x){ return 2*x; }, 4);
+        q.start();
+        thread producer([&](){
+            for (int i=1; i<=n; i++) q.push(i);
+            q.close();
+        });
+        long long s=0;
+        int count=0;
+        int v;
+        while (q.pop(v)) {
+            s+=v;
+            count++;
+        }
+        producer.join();
+        q.wait();
+        BOOST_CHECK_EQUAL(count, n);
+        BOOST_CHECK_EQUAL(s, (long long)n*(n+1));
+        
+        // Backpressure, a slow sink holds the producer back
+        boost::atomic<int> consumed(0);
+        auto b=pipeline<int>(1, 1)
+            .stage("slow", [&](int){
+                this_thread::sleep_for(boost::chrono::milliseconds(1));
+                consumed++;
+            });
+        b.start();
+        for (int i=0; i<20; i++) b.push(i);
+        // At most one batch in each channel, one in the sink, one in push
+        BOOST_CHECK(consumed>=20-3);
+        b.close();
+        b.wait();
+        BOOST_CHECK(consumed==20);
+        BOOST_CHECK(b.stats()[0].busy>=boost::chrono::milliseconds(20));
+        
+        // A slow first item holds the producer back at the ordered stage
+        boost::atomic<int> finished(0);
+        int ahead=-1;
+        std::vector<int> in_order;
+        auto w=pipeline<int>(2, 4)
+            .stage("order", [&](int x){
+                if (x==0) {
+                    this_thread::sleep_for(boost::chrono::milliseconds(50));
+                    ahead=finished;
+                }
+                finished++;
+                return x;
+            }, 4, true)
+            .stage("collect", [&](int x){ in_order.push_back(x); });
+        w.start();
+        for (int i=0; i<100; i++) w.push(i);
+        w.close();
+        w.wait();
+        // 2 batches of 4 items in the window, item 0 among them
+        BOOST_CHECK(ahead>=0 && ahead<2*4);
+        BOOST_REQUIRE(in_order.size()==100);
+        for (int i=0; i<100; i++) BOOST_CHECK_EQUAL(in_order[i], i);
+        
+        // The first exception stops the pipeline and is rethrown
+        auto f=pipeline<int>(2, 4)
+            .stage("fail", [](int x){
+                if (x==500) throw std::runtime_error("x");
+                return x;
+            }, 2)
+            .stage("sink", [](int){});
+        f.start();
+        bool stopped=false;
+        for (int i=0; i<100000 && !stopped; i++) stopped=!f.push(i);
+        f.close();
+        BOOST_CHECK(stopped);
+        BOOST_CHECK_THROW(f.wait(), std::runtime_error);
+    });
+}
@@ -3,6 +3,7 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/chrono/system_clocks.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/green_thread.hpp>
 #define BOOST_DONT_GREENIFY_STD_STREAM
 #define BOOST_DONT_GREENIFY_MAIN
@@ -66,6 +67,54 @@ BOOST_AUTO_TEST_CASE(test_async) {
     BOOST_REQUIRE(n1==n2);
 }
 
+struct throwing_move {
+    explicit throwing_move(bool fail) : fail_(fail) {}
+    throwing_move(throwing_move &&other) : fail_(other.fail_) {
+        if (fail_) throw std::runtime_error("move");
+    }
+    int operator()() const { return 5; }
+    bool fail_;
+};
+
+BOOST_AUTO_TEST_CASE(test_async_launch) {
+    greenify_with_sched(scheduler(), [&](){
+        get_scheduler().add_worker_thread(3);
+        // Deferred runs on get, not before
+        bool ran=false;
+        future<int> f=async(launch::deferred, [&](){ ran=true; return 1; });
+        BOOST_CHECK(f.wait_for(boost::chrono::milliseconds(10))==future_status::deferred);
+        BOOST_CHECK(!ran);
+        BOOST_CHECK(f.get()==1);
+        BOOST_CHECK(ran);
+        // A continuation needs the result, so it runs the deferred function
+        BOOST_CHECK(async(launch::deferred, f1, 21).then([](future<int> &f){ return f.get()+1; }).get()==43);
+        // A function failing to move into the state leaves nothing behind
+        BOOST_CHECK_THROW(async(launch::deferred, throwing_move(true)), std::runtime_error);
+        BOOST_CHECK(async(launch::deferred, throwing_move(false)).get()==5);
+
+        // Inline runs before returning
+        ran=false;
+        future<int> g=async(launch::inline_if_ready, [&](){ ran=true; return 2; });
+        BOOST_CHECK(ran);
+        BOOST_CHECK(g.wait_for(boost::chrono::seconds(0))==future_status::ready);
+        BOOST_CHECK(g.get()==2);
+
+        BOOST_CHECK(async(launch::new_thread, f2(100), 1, 2).get()==103);
+        BOOST_CHECK_THROW(async(launch::pool, [](){ throw std::runtime_error("x"); }).get(), std::runtime_error);
+
+        // Pool threads are reused once they are done
+        std::vector<future<int>> fs;
+        for (int i=0; i<1000; i++) {
+            fs.push_back(async(launch::pool, [](int x){ return x*2; }, i));
+        }
+        int sum=0;
+        for (auto &f : fs) sum+=f.get();
+        BOOST_CHECK(sum==999*1000);
+        // Blocking pool tasks don't hold the others back
+        BOOST_CHECK(async(launch::pool, f2(100), async(launch::pool, f1, 42).get(), async(launch::pool, f1, 24).get()).get()==f2(100)(f1(42), f1(24)));
+    });
+}
+
 BOOST_AUTO_TEST_CASE(test_async_executor) {
     int n1=0;
     int n2=1;
@@ -77,6 +126,36 @@ BOOST_AUTO_TEST_CASE(test_async_executor) {
     BOOST_REQUIRE(n1==n2);
 }
 
+BOOST_AUTO_TEST_CASE(test_work_stealing_executor) {
+    greenify_with_sched(scheduler(), [&](){
+        get_scheduler().add_worker_thread(3);
+        work_stealing_executor ex(4);
+        BOOST_CHECK(ex.size()==4);
+        // Any result type
+        BOOST_CHECK(ex.submit(f2(100), ex.submit(f1, 42).get(), ex(f1, 24).get()).get()==f2(100)(f1(42), f1(24)));
+        BOOST_CHECK(ex.submit([](){ return std::string("abc"); }).get()=="abc");
+        BOOST_CHECK_THROW(ex.submit([](){ throw std::runtime_error("x"); }).get(), std::runtime_error);
+        // A throwing function without a future doesn't stop its worker
+        for (int i=0; i<8; i++) ex.post([](){ throw std::runtime_error("x"); });
+        BOOST_CHECK(ex.submit([](){ return 3; }).get()==3);
+        // Tasks spawning tasks, the children go to the local queue and get stolen
+        boost::atomic<int> leaves(0);
+        promise<void> done;
+        std::function<void(int)> split=[&](int depth){
+            if (depth==0) {
+                if (++leaves==1024) done.set_value();
+                return;
+            }
+            ex.submit(split, depth-1);
+            ex.submit(split, depth-1);
+        };
+        ex.submit(split, 10);
+        done.get_future().get();
+        BOOST_CHECK(leaves==1024);
+        BOOST_CHECK(ex.submit([](){ return 1; }).then(ex, [](future<int> &f){ return f.get()+1; }).get()==2);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(test_async_function) {
     int n1=0;
     int n2=1;
@@ -276,6 +355,179 @@ BOOST_AUTO_TEST_CASE(test_async_wait_for_all1) {
     BOOST_REQUIRE(dur>=boost::chrono::milliseconds(100*c));
 }
 
+BOOST_AUTO_TEST_CASE(test_when_all) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        std::vector<promise<int>> pv(1000);
+        std::vector<future<int>> fv;
+        for (auto &p : pv) fv.push_back(p.get_future());
+        // Some of them are ready before the call
+        for (size_t i=0; i<pv.size(); i+=2) pv[i].set_value(int(i));
+        future<std::vector<int>> all=when_all(fv.begin(), fv.end());
+        BOOST_CHECK(!fv[0].valid());
+        BOOST_CHECK(all.wait_for(boost::chrono::milliseconds(10))==future_status::timeout);
+        thread_group threads;
+        for (size_t t=0; t<4; t++) {
+            threads.create_thread([&pv, t](){
+                for (size_t i=1+2*t; i<pv.size(); i+=8) pv[i].set_value(int(i));
+            });
+        }
+        std::vector<int> v=all.get();
+        threads.join_all();
+        BOOST_REQUIRE_EQUAL(v.size(), 1000u);
+        for (size_t i=0; i<v.size(); i++) BOOST_CHECK_EQUAL(v[i], int(i));
+
+        // The first exception in the range wins
+        std::vector<future<void>> fv2;
+        fv2.push_back(make_ready_future());
+        fv2.push_back(async([](){ throw std::runtime_error("1"); }));
+        fv2.push_back(async([](){ throw std::logic_error("2"); }));
+        future<void> all2=when_all(fv2.begin(), fv2.end());
+        BOOST_CHECK_THROW(all2.get(), std::runtime_error);
+
+        std::vector<future<int>> empty;
+        BOOST_CHECK(when_all(empty.begin(), empty.end()).get().empty());
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_when_any) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        std::vector<future<int>> fv;
+        fv.push_back(async([](){
+            this_thread::sleep_for(boost::chrono::milliseconds(300));
+            return 0;
+        }));
+        fv.push_back(async([]()->int{ throw std::runtime_error("failed"); }));
+        fv.push_back(async([](){
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            return 2;
+        }));
+        // Failures are skipped
+        when_any_result<int> r=when_any(fv.begin(), fv.end()).get();
+        BOOST_CHECK_EQUAL(r.index, 2u);
+        BOOST_CHECK_EQUAL(r.value, 2);
+
+        std::vector<future<void>> fv2;
+        fv2.push_back(async([](){ throw std::runtime_error("1"); }));
+        fv2.push_back(async([](){ throw std::runtime_error("2"); }));
+        future<size_t> any2=when_any(fv2.begin(), fv2.end());
+        BOOST_CHECK_THROW(any2.get(), std::runtime_error);
+
+        std::vector<future<int>> empty;
+        BOOST_CHECK_THROW(when_any(empty.begin(), empty.end()), invalid_argument);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_race) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        boost::atomic<int> interrupted(0);
+        auto start=boost::chrono::steady_clock::now();
+        future<int> f=race([&interrupted](){
+            try {
+                this_thread::sleep_for(boost::chrono::seconds(3));
+            } catch(const thread_interrupted &) {
+                interrupted++;
+                throw;
+            }
+            return 1;
+        }, [](){
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            return 2;
+        }, []()->int{
+            throw std::runtime_error("failed");
+        });
+        BOOST_CHECK_EQUAL(f.get(), 2);
+        // The loser is woken up by the interruption
+        for (int i=0; i<100 && interrupted==0; i++) {
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+        }
+        BOOST_CHECK_EQUAL(interrupted, 1);
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start<boost::chrono::seconds(2));
+
+        future<void> all_failed=race([](){ throw std::runtime_error("1"); },
+                                     [](){ throw std::runtime_error("2"); });
+        BOOST_CHECK_THROW(all_failed.get(), std::runtime_error);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_hedge) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        boost::atomic<int> started(0);
+        // The first one answers in time, the second is never started
+        future<int> f1=hedge(boost::chrono::milliseconds(200), [&started](){
+            started++;
+            this_thread::sleep_for(boost::chrono::milliseconds(20));
+            return 1;
+        }, [&started](){
+            started++;
+            return 2;
+        });
+        BOOST_CHECK_EQUAL(f1.get(), 1);
+        this_thread::sleep_for(boost::chrono::milliseconds(300));
+        BOOST_CHECK_EQUAL(started, 1);
+
+        // The first one is slow, the hedged request wins
+        future<int> f2=hedge(boost::chrono::milliseconds(50), [](){
+            // Sleeps until interrupted
+            this_thread::sleep_for(boost::chrono::seconds(10));
+            return 1;
+        }, [](){
+            return 2;
+        });
+        BOOST_CHECK_EQUAL(f2.get(), 2);
+
+        // A failure starts the next one right away
+        auto start=boost::chrono::steady_clock::now();
+        future<int> f3=hedge(boost::chrono::seconds(5), []()->int{
+            throw std::runtime_error("failed");
+        }, [](){
+            return 3;
+        });
+        BOOST_CHECK_EQUAL(f3.get(), 3);
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start<boost::chrono::seconds(1));
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_promise_race) {
+    greenify_with_sched(scheduler(), [&](){
+        get_scheduler().add_worker_thread(3);
+        
+        // The result can only be stored once, a broken promise is an exception
+        promise<int> p;
+        future<int> f=p.get_future();
+        p.set_value(1);
+        BOOST_CHECK_THROW(p.set_value(2), promise_already_satisfied);
+        BOOST_CHECK_EQUAL(f.get(), 1);
+        future<void> broken;
+        {
+            promise<void> p2;
+            broken=p2.get_future();
+        }
+        BOOST_CHECK_THROW(broken.get(), broken_promise);
+        
+        // Waiters, timed waiters and callbacks racing with the promise
+        constexpr int pairs=1000;
+        boost::atomic<int> called(0), got(0);
+        thread_group threads;
+        for (int i=0; i<pairs; i++) {
+            std::shared_ptr<promise<int>> pi=std::make_shared<promise<int>>();
+            shared_future<int> sf=pi->get_future().share();
+            threads.create_thread([sf, &got](){
+                sf.wait_for(boost::chrono::microseconds(50));
+                got+=sf.get();
+            });
+            sf.then([&called](shared_future<int> &){ called++; });
+            threads.create_thread([pi](){ pi->set_value(1); });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(called, pairs);
+        BOOST_CHECK_EQUAL(got, pairs);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(test_then1) {
     std::string s;
     greenify_with_sched(scheduler(), [&](){
@@ -324,6 +576,75 @@ BOOST_AUTO_TEST_CASE(test_then4) {
     BOOST_REQUIRE(n==100);
 }
 
+BOOST_AUTO_TEST_CASE(test_then_executor) {
+    greenify_with_sched(scheduler(), [&](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Inline, runs on the completing thread before set_value returns
+        promise<int> p;
+        thread::id completer=not_a_thread;
+        auto f1=p.get_future().then(inline_executor(), [&](future<int> &f){
+            completer=this_thread::get_id();
+            return f.get()+1;
+        });
+        p.set_value(1);
+        BOOST_CHECK_EQUAL(completer, this_thread::get_id());
+        BOOST_CHECK_EQUAL(f1.get(), 2);
+        
+        // Continuations in threads may block
+        auto f2=async([](){ return 10; })
+            .then(thread_executor(), [](future<int> &f){
+                this_thread::sleep_for(boost::chrono::milliseconds(10));
+                return f.get()*2;
+            })
+            .then(strand_executor(), [](future<int> &f){ return f.get()+1; });
+        BOOST_CHECK_EQUAL(f2.get(), 21);
+        
+        // Completed by a foreign thread, still runs on this scheduler
+        promise<int> p1;
+        boost::asio::io_service *ios=nullptr;
+        auto f4=p1.get_future().then(thread_executor(), [&](future<int> &f){
+            ios=&get_scheduler().get_io_service();
+            return f.get();
+        });
+        boost::thread([&](){ p1.set_value(4); }).join();
+        BOOST_CHECK_EQUAL(f4.get(), 4);
+        BOOST_CHECK(ios==&get_scheduler().get_io_service());
+        
+        // Executors passed as lvalues are copied, they may go away first
+        promise<int> p3;
+        future<int> f5;
+        {
+            thread_executor ex;
+            strand_executor sex;
+            f5=p3.get_future()
+                .then(ex, [](future<int> &f){ return f.get()+1; })
+                .then(sex, [](future<int> &f){ return f.get()+1; });
+        }
+        p3.set_value(1);
+        BOOST_CHECK_EQUAL(f5.get(), 3);
+        
+        // Foreign thread pool, exceptions reach the next future
+        foreign_thread_pool pool(2);
+        auto f3=async([](){ return 5; })
+            .then(pool, [](future<int> &f)->int{
+                if (f.get()==5) throw std::runtime_error("five");
+                return 0;
+            });
+        BOOST_CHECK_THROW(f3.get(), std::runtime_error);
+        
+        // Long chains don't need a thread per step
+        promise<int> p2;
+        shared_future<int> sf=p2.get_future().share();
+        future<int> last=sf.then([](shared_future<int> &f){ return f.get(); });
+        for (int i=0; i<1000; i++) {
+            last=last.then([](future<int> &f){ return f.get()+1; });
+        }
+        p2.set_value(0);
+        BOOST_CHECK_EQUAL(last.get(), 1000);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(test_packaged_task1) {
     int n=0;
     greenify_with_sched(scheduler(), [&](){
@@ -348,6 +669,56 @@ BOOST_AUTO_TEST_CASE(test_packaged_task2) {
     BOOST_REQUIRE(x==1);
 }
 
+BOOST_AUTO_TEST_CASE(test_packaged_task3) {
+    int n=0;
+    greenify_with_sched(scheduler(), [&](){
+        packaged_task<int(int)> pt(std::allocator_arg, std::allocator<int>(), [](int x){ return x+1; });
+        auto f=pt.get_future();
+        pt(41);
+        n=f.get();
+    });
+    BOOST_REQUIRE(n==42);
+}
+
+BOOST_AUTO_TEST_CASE(test_packaged_task_reset) {
+    int n=0;
+    greenify_with_sched(scheduler(), [&](){
+        packaged_task<int(int)> pt([](int x){ return x*2; });
+        // Continuations of a result which will never come see broken_promise
+        auto c=pt.get_future().then([](future<int> &f){ return f.get(); });
+        pt.reset();
+        BOOST_CHECK_THROW(c.get(), broken_promise);
+        auto f=pt.get_future();
+        pt(21);
+        n=f.get();
+    });
+    BOOST_REQUIRE(n==42);
+}
+
+BOOST_AUTO_TEST_CASE(test_pool_allocator) {
+    greenify_with_sched(scheduler(), [](){
+        pool_allocator<char> alloc;
+        // A freed block is handed out again for the same size class
+        char *p=alloc.allocate(100);
+        alloc.deallocate(p, 100);
+        char *q=alloc.allocate(120);
+        BOOST_CHECK(p==q);
+        alloc.deallocate(q, 120);
+        // Large blocks don't go through the pools
+        char *r=alloc.allocate(1<<20);
+        alloc.deallocate(r, 1<<20);
+
+        get_scheduler().add_worker_thread(3);
+        std::vector<future<int>> fv;
+        for (int i=0; i<100; i++) {
+            fv.push_back(async([i](){ return i; }));
+        }
+        int sum=0;
+        for (auto &f : fv) sum+=f.get();
+        BOOST_CHECK_EQUAL(sum, 4950);
+    });
+}
+
 int thr_func(int x) {
     boost::this_thread::sleep_for(boost::chrono::seconds(1));
     return x*10;
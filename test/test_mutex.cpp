@@ -2,10 +2,13 @@
 #include <boost/test/unit_test.hpp>
 
 #include <boost/random.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/chrono/system_clocks.hpp>
 #define BOOST_DONT_GREENIFY_STD_STREAM
 #define BOOST_DONT_GREENIFY_MAIN
 #include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/lock_profile.hpp>
 
 using namespace boost::green_thread;
 mutex m;
@@ -99,3 +102,231 @@ BOOST_AUTO_TEST_CASE(test_mutex) {
         threads.join_all();
     });
 }
+
+BOOST_AUTO_TEST_CASE(test_mutex_interrupted_waiter) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        // The interrupted waiter is handed the mutex and passes it on
+        for (int waiters : {1, 2}) {
+            mutex im;
+            boost::unique_lock<mutex> lock(im);
+            boost::atomic<int> interrupted(0);
+            boost::atomic<int> locked(0);
+            thread t([&](){
+                try {
+                    boost::lock_guard<mutex> guard(im);
+                    locked++;
+                } catch(const thread_interrupted &) {
+                    interrupted++;
+                }
+            });
+            this_thread::sleep_for(boost::chrono::milliseconds(20));
+            thread u;
+            if (waiters==2) {
+                u=thread([&](){
+                    boost::lock_guard<mutex> guard(im);
+                    locked++;
+                });
+                this_thread::sleep_for(boost::chrono::milliseconds(20));
+            }
+            t.interrupt();
+            lock.unlock();
+            t.join();
+            if (u.joinable()) u.join();
+            BOOST_CHECK_EQUAL(interrupted, 1);
+            BOOST_CHECK_EQUAL(locked, waiters-1);
+            BOOST_CHECK(im.try_lock());
+            im.unlock();
+        }
+    });
+}
+
+void barging_f(mutex &bm, size_t &counter) {
+    for (int i=0; i<100; i++) {
+        boost::unique_lock<mutex> lock(bm);
+        ++counter;
+        if (i%10==0) this_thread::yield();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_barging_mutex) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        // Zero starvation threshold degrades to handoff whenever somebody waits
+        const boost::chrono::microseconds thresholds[]={
+            boost::chrono::microseconds(0),
+            boost::chrono::microseconds(100),
+            boost::chrono::microseconds(1000000),
+        };
+        for (auto threshold : thresholds) {
+            mutex bm(lock_policy::barging, threshold);
+            size_t counter=0;
+            thread_group threads;
+            for (int i=0; i<20; i++) {
+                threads.create_thread(std::bind(barging_f, std::ref(bm), std::ref(counter)));
+            }
+            threads.join_all();
+            BOOST_CHECK_EQUAL(counter, 2000);
+        }
+        
+        recursive_mutex rbm(lock_policy::barging);
+        size_t rcounter=0;
+        thread_group threads;
+        for (int i=0; i<20; i++) {
+            threads.create_thread([&](){
+                for (int i=0; i<100; i++) {
+                    boost::unique_lock<recursive_mutex> lock(rbm);
+                    boost::unique_lock<recursive_mutex> lock1(rbm);
+                    ++rcounter;
+                    this_thread::yield();
+                }
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(rcounter, 2000);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_mutex) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        shared_mutex sm;
+        size_t a=0, b=0;
+        boost::atomic<size_t> reads(0);
+        thread_group threads;
+        for (int i=0; i<10; i++) {
+            threads.create_thread([&](){
+                for (int j=0; j<1000; j++) {
+                    shared_lock<shared_mutex> lock(sm);
+                    BOOST_CHECK_EQUAL(a, b);
+                    if (j%100==0) this_thread::yield();
+                    ++reads;
+                }
+            });
+        }
+        for (int i=0; i<2; i++) {
+            threads.create_thread([&](){
+                for (int j=0; j<100; j++) {
+                    boost::lock_guard<shared_mutex> lock(sm);
+                    ++a;
+                    this_thread::yield();
+                    ++b;
+                }
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(a, 200);
+        BOOST_CHECK_EQUAL(b, 200);
+        BOOST_CHECK_EQUAL(reads, 10000);
+        
+        // Writer times out while a reader holds the lock
+        {
+            shared_lock<shared_mutex> lock(sm);
+            thread t([&](){
+                BOOST_CHECK(!sm.try_lock());
+                BOOST_CHECK(!sm.try_lock_for(boost::chrono::milliseconds(10)));
+                BOOST_CHECK(sm.try_lock_shared_for(boost::chrono::milliseconds(10)));
+                sm.unlock_shared();
+            });
+            t.join();
+        }
+        BOOST_CHECK(sm.try_lock());
+        thread t([&](){
+            BOOST_CHECK(!sm.try_lock_shared_for(boost::chrono::milliseconds(10)));
+        });
+        t.join();
+        sm.unlock();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_hybrid_mutex) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        const lock_policy policies[]={ lock_policy::barging, lock_policy::handoff };
+        for (auto policy : policies) {
+            // Green threads and foreign threads contend on the same mutex
+            hybrid_mutex hm(policy);
+            size_t counter=0;
+            auto f=[&](){
+                for (int i=0; i<1000; i++) {
+                    boost::unique_lock<hybrid_mutex> lock(hm);
+                    ++counter;
+                }
+            };
+            std::vector<std::unique_ptr<boost::thread>> foreign;
+            for (int i=0; i<2; i++) {
+                foreign.emplace_back(new boost::thread(f));
+            }
+            thread_group threads;
+            for (int i=0; i<20; i++) {
+                threads.create_thread(f);
+            }
+            threads.join_all();
+            for (auto &t : foreign) {
+                t->join();
+            }
+            BOOST_CHECK_EQUAL(counter, 22000);
+        }
+        
+        // Timed lock, held by a foreign thread
+        hybrid_mutex hm;
+        boost::atomic<bool> locked(false);
+        boost::thread t([&](){
+            hm.lock();
+            locked=true;
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+            hm.unlock();
+        });
+        while (!locked) this_thread::yield();
+        BOOST_CHECK(!hm.try_lock());
+        BOOST_CHECK(!hm.try_lock_for(boost::chrono::milliseconds(10)));
+        BOOST_CHECK(hm.try_lock_for(boost::chrono::seconds(5)));
+        hm.unlock();
+        t.join();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_lock_profile) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+        
+        mutex hot;
+        mutex cold;
+        set_lock_name(&hot, "hot");
+        {
+            thread_group threads;
+            for (int i=0; i<10; i++) {
+                threads.create_thread([&](){
+                    for (int j=0; j<10; j++) {
+                        boost::unique_lock<mutex> lock(hot);
+                        this_thread::sleep_for(boost::chrono::microseconds(100));
+                    }
+                });
+            }
+            threads.join_all();
+        }
+        {
+            boost::unique_lock<mutex> lock(cold);
+        }
+        
+        std::vector<lock_profile_entry> profile=get_scheduler().lock_profile(1);
+#if defined(BOOST_GREEN_THREAD_LOCK_PROFILING)
+        BOOST_REQUIRE_EQUAL(profile.size(), 1);
+        BOOST_CHECK_EQUAL(profile[0].lock, &hot);
+        BOOST_CHECK_EQUAL(profile[0].name, "hot");
+        BOOST_CHECK_EQUAL(profile[0].acquisitions, 100);
+        BOOST_CHECK(profile[0].contentions>0);
+        BOOST_CHECK(profile[0].max_wait>=boost::chrono::microseconds(100));
+        BOOST_CHECK(profile[0].max_hold>=boost::chrono::microseconds(100));
+        get_scheduler().reset_lock_profile();
+        BOOST_CHECK(get_scheduler().lock_profile().empty());
+#else
+        BOOST_CHECK(profile.empty());
+#endif
+        set_lock_name(&hot, "");
+    });
+}
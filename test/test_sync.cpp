@@ -0,0 +1,278 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#define BOOST_DONT_GREENIFY_STD_STREAM
+#define BOOST_DONT_GREENIFY_MAIN
+#include <boost/green_thread/greenify.hpp>
+#include <boost/green_thread/semaphore.hpp>
+#include <boost/green_thread/latch.hpp>
+#include <boost/green_thread/barrier.hpp>
+#include <boost/green_thread/atomic_wait.hpp>
+
+using namespace boost::green_thread;
+
+BOOST_AUTO_TEST_CASE(test_semaphore) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        // At most 4 threads in the critical section
+        counting_semaphore sem(4);
+        boost::atomic<int> in_flight(0);
+        boost::atomic<int> max_in_flight(0);
+        {
+            thread_group threads;
+            for (int i=0; i<50; i++) {
+                threads.create_thread([&](){
+                    for (int j=0; j<10; j++) {
+                        sem.acquire();
+                        int n=++in_flight;
+                        int m=max_in_flight.load();
+                        while (n>m && !max_in_flight.compare_exchange_weak(m, n)) {}
+                        this_thread::yield();
+                        --in_flight;
+                        sem.release();
+                    }
+                });
+            }
+            threads.join_all();
+        }
+        BOOST_CHECK(max_in_flight<=4);
+        BOOST_CHECK_EQUAL(sem.available(), 4);
+
+        // One release wakes all waiters it can satisfy
+        counting_semaphore batch(0);
+        boost::atomic<int> acquired(0);
+        {
+            thread_group threads;
+            for (int i=0; i<3; i++) {
+                threads.create_thread([&](){
+                    batch.acquire(3);
+                    ++acquired;
+                });
+            }
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            BOOST_CHECK_EQUAL(acquired, 0);
+            batch.release(8);
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            BOOST_CHECK_EQUAL(acquired, 2);
+            batch.release(1);
+            threads.join_all();
+        }
+        BOOST_CHECK_EQUAL(acquired, 3);
+        BOOST_CHECK_EQUAL(batch.available(), 0);
+
+        // Timed acquire
+        auto start=boost::chrono::steady_clock::now();
+        BOOST_CHECK(!batch.try_acquire_for(boost::chrono::milliseconds(10)));
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start>=boost::chrono::milliseconds(10));
+        thread t([&](){
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+            batch.release(2);
+        });
+        BOOST_CHECK(batch.try_acquire_until(boost::chrono::steady_clock::now()+boost::chrono::seconds(5), 2));
+        t.join();
+        BOOST_CHECK_EQUAL(batch.available(), 0);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_semaphore_foreign_thread) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        counting_semaphore to_foreign(0);
+        counting_semaphore to_green(0);
+        boost::thread foreign([&](){
+            for (int i=0; i<100; i++) {
+                to_foreign.acquire();
+                to_green.release();
+            }
+            BOOST_CHECK(!to_foreign.try_acquire_for(boost::chrono::milliseconds(10)));
+        });
+        for (int i=0; i<100; i++) {
+            to_foreign.release();
+            to_green.acquire();
+        }
+        foreign.join();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_latch) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        latch done(10);
+        latch go(1);
+        boost::atomic<int> started(0);
+        boost::atomic<int> passed(0);
+        {
+            thread_group threads;
+            for (int i=0; i<10; i++) {
+                threads.create_thread([&](){
+                    ++started;
+                    go.wait();
+                    ++passed;
+                    done.count_down();
+                });
+            }
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            BOOST_CHECK_EQUAL(started, 10);
+            BOOST_CHECK_EQUAL(passed, 0);
+            BOOST_CHECK(!go.try_wait());
+            go.count_down();
+            done.wait();
+            BOOST_CHECK_EQUAL(passed, 10);
+            BOOST_CHECK(done.try_wait());
+            threads.join_all();
+        }
+
+        // Mixed with a foreign thread
+        latch meet(2);
+        boost::thread foreign([&](){
+            meet.arrive_and_wait();
+        });
+        meet.arrive_and_wait();
+        foreign.join();
+        latch zero(0);
+        zero.wait();
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_barrier_phases) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        const int n=40;
+        const int phases=20;
+        for (int mode=0; mode<2; mode++) {
+            boost::atomic<int> completions(0);
+            boost::atomic<int> arrived(0);
+            boost::atomic<bool> ok(true);
+            auto completion=[&](){ ++completions; };
+            std::unique_ptr<barrier> b(mode==0
+                                       ? new barrier(n, completion)
+                                       : new barrier(n, combining_tree(4), completion));
+            boost::atomic<int> last_count(0);
+            thread_group threads;
+            for (int i=0; i<n; i++) {
+                threads.create_thread([&](){
+                    for (int p=0; p<phases; p++) {
+                        ++arrived;
+                        if (b->wait()) ++last_count;
+                        // Everybody of this phase has arrived
+                        if (arrived.load()<(p+1)*n) ok=false;
+                    }
+                });
+            }
+            threads.join_all();
+            BOOST_CHECK(ok);
+            BOOST_CHECK_EQUAL(completions, phases);
+            BOOST_CHECK_EQUAL(last_count, phases);
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_interrupt_latch_barrier) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        // The interrupted waiter stays until the release, then throws
+        latch l(1);
+        boost::atomic<bool> passed(false);
+        boost::atomic<bool> interrupted(false);
+        thread t([&](){
+            try {
+                l.wait();
+                passed=true;
+            } catch(const thread_interrupted &) {
+                interrupted=true;
+            }
+        });
+        this_thread::sleep_for(boost::chrono::milliseconds(20));
+        t.interrupt();
+        this_thread::sleep_for(boost::chrono::milliseconds(20));
+        BOOST_CHECK(!interrupted);
+        l.count_down();
+        t.join();
+        BOOST_CHECK(interrupted);
+        BOOST_CHECK(!passed);
+
+        // Same for a barrier, the phase still completes
+        barrier b(2);
+        interrupted=false;
+        thread u([&](){
+            try {
+                b.wait();
+            } catch(const thread_interrupted &) {
+                interrupted=true;
+            }
+        });
+        this_thread::sleep_for(boost::chrono::milliseconds(20));
+        u.interrupt();
+        this_thread::sleep_for(boost::chrono::milliseconds(20));
+        BOOST_CHECK(!interrupted);
+        BOOST_CHECK(b.wait());
+        u.join();
+        BOOST_CHECK(interrupted);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_atomic_wait) {
+    greenify_with_sched(scheduler(), [](){
+        get_scheduler().add_worker_thread(3);
+
+        // Green waiters, green notifier
+        boost::atomic<int> flag(0);
+        boost::atomic<int> woken(0);
+        {
+            thread_group threads;
+            for (int i=0; i<10; i++) {
+                threads.create_thread([&](){
+                    atomic_wait(flag, 0);
+                    ++woken;
+                });
+            }
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            BOOST_CHECK_EQUAL(woken, 0);
+            // Notifying without changing the value doesn't release anybody
+            atomic_notify_all(flag);
+            this_thread::sleep_for(boost::chrono::milliseconds(50));
+            BOOST_CHECK_EQUAL(woken, 0);
+            flag=1;
+            atomic_notify_all(flag);
+            threads.join_all();
+        }
+        BOOST_CHECK_EQUAL(woken, 10);
+
+        // Ping-pong with a foreign thread
+        boost::atomic<int> turn(0);
+        boost::thread foreign([&](){
+            for (int i=0; i<100; i++) {
+                atomic_wait(turn, 2*i);
+                turn=2*i+2;
+                atomic_notify_one(turn);
+            }
+        });
+        for (int i=0; i<100; i++) {
+            turn=2*i+1;
+            atomic_notify_one(turn);
+            atomic_wait(turn, 2*i+1);
+        }
+        foreign.join();
+        BOOST_CHECK_EQUAL(turn, 200);
+
+        // Timed wait
+        auto start=boost::chrono::steady_clock::now();
+        BOOST_CHECK(!atomic_wait_for(flag, 1, boost::chrono::milliseconds(10)));
+        BOOST_CHECK(boost::chrono::steady_clock::now()-start>=boost::chrono::milliseconds(10));
+        thread t([&](){
+            this_thread::sleep_for(boost::chrono::milliseconds(10));
+            flag=2;
+            atomic_notify_one(flag);
+        });
+        BOOST_CHECK(atomic_wait_for(flag, 1, boost::chrono::seconds(5)));
+        t.join();
+    });
+}